@@ -6,6 +6,7 @@ layout(rgba32f, binding = 0) uniform image2D resultImage;
 struct FlattenedNode {
     bool IsLeaf;
     int childIndices[8];
+    float coverage;
     vec4 color;
 };
 
@@ -13,19 +14,67 @@ layout(std430, binding = 1) buffer NodeBuffer {
     FlattenedNode nodes[];
 };
 
+// Compact layout: x = child mask (bits 0-7) | leaf mask (bits 8-15), y = first child.
+// Children are contiguous, colors live in their own buffer indexed like the nodes.
+layout(std430, binding = 2) buffer CompactNodeBuffer {
+    uvec2 compactNodes[];
+};
+
+// Color streams are packed words in the encoding given by attributeEncoding, see
+// decodeColor. Palette encodings index into palette.
+layout(std430, binding = 3) buffer AttributeBuffer {
+    uint nodeColors[];
+};
+
+// Leaf bricks of the compact layout: per brick brickSize^3 occupancy bits and then the
+// index of its first color in brickColors. A compact node with BRICK_FLAG set stores its
+// brick index in y instead of a first child.
+layout(std430, binding = 4) buffer BrickBuffer {
+    uint bricks[];
+};
+
+layout(std430, binding = 5) buffer BrickColorBuffer {
+    uint brickColors[];
+};
+
+layout(std430, binding = 6) buffer PaletteBuffer {
+    vec4 palette[];
+};
+
+// Chunked world: root node index of the chunk in each grid cell, -1 for an empty cell.
+// Cell (x, y, z) is at (x * chunkGridDims.y + y) * chunkGridDims.z + z, see ChunkGrid.
+layout(std430, binding = 7) buffer ChunkGridBuffer {
+    int chunkRoots[];
+};
+
 uniform vec2 iResolution;
 uniform mat4 viewMatrix;
 uniform vec3 cameraPos;
 uniform float fov;
 uniform vec3 minBound;
 uniform vec3 maxBound;
+uniform bool useCompactNodes;
+uniform int brickSize;          // 4 or 8, 0 when there are no bricks
+uniform int attributeEncoding;  // AttributeEncoding of the compact color streams
+uniform float lodScale;         // stop at nodes smaller than lodScale * distance, 0 for full detail
+uniform bool useChunkGrid;      // trace the chunk grid instead of one octree in [minBound, maxBound]
+uniform ivec3 chunkGridDims;
+uniform float chunkSize;        // the grid spans minBound to minBound + chunkGridDims * chunkSize
 
 const float MAX_DIST = 1000.0;
 #define MAX_STACK_SIZE 64
+const uint BRICK_FLAG = 1u << 16;
+const int ENCODING_FLOAT = 0;
+const int ENCODING_RGBA8 = 1;
+const int ENCODING_RGB565 = 2;
+const int ENCODING_PALETTE8 = 3;
+const int ENCODING_PALETTE16 = 4;
 
 // Stack entry structure for iterative traversal.
+// isLeaf is only used by the compact layout, where the parent's leaf mask says it.
 struct StackEntry {
     int nodeIndex;
+    bool isLeaf;
     vec3 nodeMin;
     vec3 nodeMax;
     float tEnter;
@@ -43,11 +92,86 @@ bool intersectAABB(vec3 ro, vec3 rd, vec3 boxMin, vec3 boxMax, out float tEnter,
 }
 
 
+// Index of a child node or -1, for whichever layout is bound.
+int childNodeIndex(int nodeIndex, int child, out bool childIsLeaf) {
+    if (useCompactNodes) {
+        uvec2 node = compactNodes[nodeIndex];
+        uint childMask = node.x & 0xffu;
+        childIsLeaf = ((node.x >> (8 + child)) & 1u) != 0u;
+        if ((childMask & (1u << child)) == 0u)
+            return -1;
+        return int(node.y) + bitCount(childMask & ((1u << child) - 1u));
+    }
+    childIsLeaf = false;
+    return nodes[nodeIndex].childIndices[child];
+}
+
+uint colorWord(bool fromBricks, int word) {
+    return fromBricks ? brickColors[word] : nodeColors[word];
+}
+
+// Color at index of the node or brick color stream.
+vec4 decodeColor(bool fromBricks, int index) {
+    if (attributeEncoding == ENCODING_RGBA8)
+        return unpackUnorm4x8(colorWord(fromBricks, index));
+    if (attributeEncoding == ENCODING_RGB565) {
+        uint v = (colorWord(fromBricks, index / 2) >> (16 * (index % 2))) & 0xffffu;
+        return vec4(float((v >> 11) & 31u) / 31.0, float((v >> 5) & 63u) / 63.0, float(v & 31u) / 31.0, 1.0);
+    }
+    if (attributeEncoding == ENCODING_PALETTE16)
+        return palette[(colorWord(fromBricks, index / 2) >> (16 * (index % 2))) & 0xffffu];
+    if (attributeEncoding == ENCODING_PALETTE8)
+        return palette[(colorWord(fromBricks, index / 4) >> (8 * (index % 4))) & 0xffu];
+    int word = index * 4;
+    return uintBitsToFloat(uvec4(colorWord(fromBricks, word), colorWord(fromBricks, word + 1),
+                                 colorWord(fromBricks, word + 2), colorWord(fromBricks, word + 3)));
+}
+
+// Index into brickColors of an occupied voxel: set bits before it plus the first color.
+int brickColorIndex(int base, int voxel) {
+    int words = brickSize * brickSize * brickSize / 32;
+    int index = int(bricks[base + words]);
+    for (int word = 0; word < voxel / 32; word++)
+        index += bitCount(bricks[base + word]);
+    return index + bitCount(bricks[base + voxel / 32] & ((1u << uint(voxel % 32)) - 1u));
+}
+
+// March through a brick spanning [brickMin, brickMax] with a 3D DDA from where the ray
+// enters it. Returns true with the voxel color on a hit.
+bool traceBrick(uint brickIndex, vec3 ro, vec3 rd, vec3 brickMin, vec3 brickMax, float tEnter, out vec4 color) {
+    color = vec4(0.0);
+    int base = int(brickIndex) * (brickSize * brickSize * brickSize / 32 + 1);
+    vec3 cellSize = (brickMax - brickMin) / float(brickSize);
+    vec3 entryPoint = ro + rd * max(tEnter, 0.0);
+    ivec3 cell = clamp(ivec3(floor((entryPoint - brickMin) / cellSize)), ivec3(0), ivec3(brickSize - 1));
+
+    bvec3 positive = greaterThan(rd, vec3(0.0));
+    bvec3 axisParallel = equal(rd, vec3(0.0));
+    ivec3 stepDir = ivec3(positive) * 2 - 1;
+    vec3 boundary = brickMin + (vec3(cell) + vec3(positive)) * cellSize;
+    vec3 tMax = mix((boundary - ro) / rd, vec3(1e30), axisParallel);
+    vec3 tDelta = mix(cellSize / abs(rd), vec3(1e30), axisParallel);
+
+    for (int i = 0; i < 3 * brickSize; i++) {
+        int voxel = (cell.x * brickSize + cell.y) * brickSize + cell.z;
+        if ((bricks[base + voxel / 32] & (1u << uint(voxel % 32))) != 0u) {
+            color = decodeColor(true, brickColorIndex(base, voxel));
+            return true;
+        }
+        int axis = (tMax.x < tMax.y) ? ((tMax.x < tMax.z) ? 0 : 2) : ((tMax.y < tMax.z) ? 1 : 2);
+        cell[axis] += stepDir[axis];
+        if (cell[axis] < 0 || cell[axis] >= brickSize)
+            return false;
+        tMax[axis] += tDelta[axis];
+    }
+    return false;
+}
 
-// Traverse the octree with backtracking.
-vec4 traverseOctree(vec3 ro, vec3 rd) {
+// Traverse the octree rooted at rootIndex, spanning [boundsMin, boundsMax], with
+// backtracking. Returns vec4(0) on a miss.
+vec4 traverseOctree(vec3 ro, vec3 rd, int rootIndex, vec3 boundsMin, vec3 boundsMax) {
     float tEnterRoot, tExitRoot;
-    if (!intersectAABB(ro, rd, minBound, maxBound, tEnterRoot, tExitRoot)) {
+    if (!intersectAABB(ro, rd, boundsMin, boundsMax, tEnterRoot, tExitRoot)) {
         return vec4(0.0);
     }
     
@@ -56,7 +180,7 @@ vec4 traverseOctree(vec3 ro, vec3 rd) {
     int stackSize = 0;
     
     // Push the root node.
-    stack[stackSize++] = StackEntry(0, minBound, maxBound, tEnterRoot);
+    stack[stackSize++] = StackEntry(rootIndex, false, boundsMin, boundsMax, tEnterRoot);
     
     float bestT = MAX_DIST;
     vec4 hitColor = vec4(0.0);
@@ -85,15 +209,33 @@ vec4 traverseOctree(vec3 ro, vec3 rd) {
             continue;
         }
         
-        FlattenedNode node = nodes[entry.nodeIndex];
+        bool isLeaf = useCompactNodes ? entry.isLeaf : nodes[entry.nodeIndex].IsLeaf;
         
         // If we hit a leaf, record its color and update bestT.
-        if (node.IsLeaf) {
-            hitColor = node.color;
+        if (isLeaf) {
+            hitColor = useCompactNodes ? decodeColor(false, entry.nodeIndex) : nodes[entry.nodeIndex].color;
             bestT = entry.tEnter;
             // Optionally, break here if you only need the first hit.
             break;
         }
+
+        // Level of detail: a node that covers less than the pixel footprint at this distance
+        // is drawn with its filtered color instead of being descended into.
+        if (lodScale > 0.0 && entry.nodeMax.x - entry.nodeMin.x < lodScale * entry.tEnter) {
+            hitColor = useCompactNodes ? decodeColor(false, entry.nodeIndex) : nodes[entry.nodeIndex].color;
+            break;
+        }
+
+        // Bricks are marched instead of subdivided. Boxes along a ray do not overlap, so a
+        // hit inside the closest brick is final.
+        if (useCompactNodes) {
+            uvec2 compactNode = compactNodes[entry.nodeIndex];
+            if ((compactNode.x & BRICK_FLAG) != 0u) {
+                if (traceBrick(compactNode.y, ro, rd, entry.nodeMin, entry.nodeMax, entry.tEnter, hitColor))
+                    break;
+                continue;
+            }
+        }
         
         // Not a leaf: subdivide the current node's bounds.
         vec3 nodeMin = entry.nodeMin;
@@ -102,8 +244,9 @@ vec4 traverseOctree(vec3 ro, vec3 rd) {
         
         // For each potential child...
         for (int child = 0; child < 8; child++) {
-            int childNodeIndex = node.childIndices[child];
-            if (childNodeIndex == -1)
+            bool childIsLeaf;
+            int childIndex = childNodeIndex(entry.nodeIndex, child, childIsLeaf);
+            if (childIndex == -1)
                 continue;
             
             // Compute the child's AABB based on the child's bit pattern.
@@ -124,7 +267,7 @@ vec4 traverseOctree(vec3 ro, vec3 rd) {
             float tChildEnter, tChildExit;
             if (intersectAABB(ro, rd, childMin, childMax, tChildEnter, tChildExit)) {
                 if (tChildEnter < bestT && stackSize < MAX_STACK_SIZE) {
-                    stack[stackSize++] = StackEntry(childNodeIndex, childMin, childMax, tChildEnter);
+                    stack[stackSize++] = StackEntry(childIndex, childIsLeaf, childMin, childMax, tChildEnter);
                 }
             }
         }
@@ -133,6 +276,41 @@ vec4 traverseOctree(vec3 ro, vec3 rd) {
     return hitColor;
 }
 
+// Walk the chunk grid cells along the ray with a 3D DDA and trace each occupied one. Cells
+// do not overlap, so the first hit is the closest.
+vec4 traverseChunks(vec3 ro, vec3 rd) {
+    vec3 gridMax = minBound + vec3(chunkGridDims) * chunkSize;
+    float tEnter, tExit;
+    if (!intersectAABB(ro, rd, minBound, gridMax, tEnter, tExit))
+        return vec4(0.0);
+
+    vec3 entryPoint = ro + rd * max(tEnter, 0.0);
+    ivec3 cell = clamp(ivec3(floor((entryPoint - minBound) / chunkSize)), ivec3(0), chunkGridDims - 1);
+    bvec3 positive = greaterThan(rd, vec3(0.0));
+    bvec3 axisParallel = equal(rd, vec3(0.0));
+    ivec3 stepDir = ivec3(positive) * 2 - 1;
+    vec3 boundary = minBound + (vec3(cell) + vec3(positive)) * chunkSize;
+    vec3 tMax = mix((boundary - ro) / rd, vec3(1e30), axisParallel);
+    vec3 tDelta = mix(vec3(chunkSize) / abs(rd), vec3(1e30), axisParallel);
+
+    int maxSteps = chunkGridDims.x + chunkGridDims.y + chunkGridDims.z;
+    for (int i = 0; i < maxSteps; i++) {
+        int root = chunkRoots[(cell.x * chunkGridDims.y + cell.y) * chunkGridDims.z + cell.z];
+        if (root != -1) {
+            vec3 cellMin = minBound + vec3(cell) * chunkSize;
+            vec4 color = traverseOctree(ro, rd, root, cellMin, cellMin + vec3(chunkSize));
+            if (color != vec4(0.0))
+                return color;
+        }
+        int axis = (tMax.x < tMax.y) ? ((tMax.x < tMax.z) ? 0 : 2) : ((tMax.y < tMax.z) ? 1 : 2);
+        cell[axis] += stepDir[axis];
+        if (cell[axis] < 0 || cell[axis] >= chunkGridDims[axis])
+            break;
+        tMax[axis] += tDelta[axis];
+    }
+    return vec4(0.0);
+}
+
 void main() {
     ivec2 pixelCoords = ivec2(gl_GlobalInvocationID.xy);
     if (pixelCoords.x >= int(iResolution.x) || pixelCoords.y >= int(iResolution.y))
@@ -145,6 +323,7 @@ void main() {
     vec3 rayDirWorldSpace = normalize(invViewMatrix * rayDirCameraSpace);
     vec3 rayOrigin = cameraPos;
     
-    vec4 color = traverseOctree(rayOrigin, rayDirWorldSpace);
+    vec4 color = useChunkGrid ? traverseChunks(rayOrigin, rayDirWorldSpace)
+                              : traverseOctree(rayOrigin, rayDirWorldSpace, 0, minBound, maxBound);
     imageStore(resultImage, pixelCoords, color);
 }
\ No newline at end of file
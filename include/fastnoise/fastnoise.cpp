@@ -32,26 +32,19 @@
 #include <assert.h>
 
 #include <algorithm>
+#include <atomic>
 #include <random>
-
-const FN_DECIMAL GRAD_X[] =
-{
-	1, -1, 1, -1,
-	1, -1, 1, -1,
-	0, 0, 0, 0
-};
-const FN_DECIMAL GRAD_Y[] =
-{
-	1, 1, -1, -1,
-	0, 0, 0, 0,
-	1, -1, 1, -1
-};
-const FN_DECIMAL GRAD_Z[] =
-{
-	0, 0, 0, 0,
-	1, 1, -1, -1,
-	1, 1, -1, -1
-};
+#include <thread>
+#include <vector>
+
+// FillNoiseSet(...) has SSE4.1 and AVX2 paths for floats on x86, selected at runtime
+#if !defined(FN_USE_DOUBLES) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+#define FN_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
 
 const FN_DECIMAL GRAD_4D[] =
 {
@@ -181,13 +174,9 @@ const FN_DECIMAL CELL_3D_Z[] =
 	FN_DECIMAL(0.615630723), FN_DECIMAL(0.3430367014), FN_DECIMAL(0.8193658136), FN_DECIMAL(-0.5829600957), FN_DECIMAL(0.07911697781), FN_DECIMAL(0.7854296063), FN_DECIMAL(-0.4107442306), FN_DECIMAL(0.4766964066), FN_DECIMAL(-0.9045999527), FN_DECIMAL(-0.1673856787), FN_DECIMAL(0.2828077348), FN_DECIMAL(-0.5902737632), FN_DECIMAL(-0.321506229), FN_DECIMAL(-0.5224513133), FN_DECIMAL(-0.4090169985), FN_DECIMAL(-0.3599685311),
 };
 
-static int FastFloor(FN_DECIMAL f) { return (f >= 0 ? (int)f : (int)f - 1); }
 static int FastRound(FN_DECIMAL f) { return (f >= 0) ? (int)(f + FN_DECIMAL(0.5)) : (int)(f - FN_DECIMAL(0.5)); }
 static int FastAbs(int i) { return abs(i); }
 static FN_DECIMAL FastAbs(FN_DECIMAL f) { return fabs(f); }
-static FN_DECIMAL Lerp(FN_DECIMAL a, FN_DECIMAL b, FN_DECIMAL t) { return a + t * (b - a); }
-static FN_DECIMAL InterpHermiteFunc(FN_DECIMAL t) { return t * t*(3 - 2 * t); }
-static FN_DECIMAL InterpQuinticFunc(FN_DECIMAL t) { return t * t*t*(t*(t * 6 - 15) + 10); }
 static FN_DECIMAL CubicLerp(FN_DECIMAL a, FN_DECIMAL b, FN_DECIMAL c, FN_DECIMAL d, FN_DECIMAL t)
 {
 	FN_DECIMAL p = (d - c) - (a - b);
@@ -241,14 +230,6 @@ void FastNoise::GetCellularDistance2Indices(int& cellularDistanceIndex0, int& ce
 	cellularDistanceIndex1 = m_cellularDistanceIndex1;
 }
 
-unsigned char FastNoise::Index2D_12(unsigned char offset, int x, int y) const
-{
-	return m_perm12[(x & 0xff) + m_perm[(y & 0xff) + offset]];
-}
-unsigned char FastNoise::Index3D_12(unsigned char offset, int x, int y, int z) const
-{
-	return m_perm12[(x & 0xff) + m_perm[(y & 0xff) + m_perm[(z & 0xff) + offset]]];
-}
 unsigned char FastNoise::Index4D_32(unsigned char offset, int x, int y, int z, int w) const
 {
 	return m_perm[(x & 0xff) + m_perm[(y & 0xff) + m_perm[(z & 0xff) + m_perm[(w & 0xff) + offset]]]] & 31;
@@ -309,18 +290,6 @@ FN_DECIMAL FastNoise::ValCoord3DFast(unsigned char offset, int x, int y, int z)
 	return VAL_LUT[Index3D_256(offset, x, y, z)];
 }
 
-FN_DECIMAL FastNoise::GradCoord2D(unsigned char offset, int x, int y, FN_DECIMAL xd, FN_DECIMAL yd) const
-{
-	unsigned char lutPos = Index2D_12(offset, x, y);
-
-	return xd * GRAD_X[lutPos] + yd * GRAD_Y[lutPos];
-}
-FN_DECIMAL FastNoise::GradCoord3D(unsigned char offset, int x, int y, int z, FN_DECIMAL xd, FN_DECIMAL yd, FN_DECIMAL zd) const
-{
-	unsigned char lutPos = Index3D_12(offset, x, y, z);
-
-	return xd * GRAD_X[lutPos] + yd * GRAD_Y[lutPos] + zd * GRAD_Z[lutPos];
-}
 FN_DECIMAL FastNoise::GradCoord4D(unsigned char offset, int x, int y, int z, int w, FN_DECIMAL xd, FN_DECIMAL yd, FN_DECIMAL zd, FN_DECIMAL wd) const
 {
 	unsigned char lutPos = Index4D_32(offset, x, y, z, w) << 2;
@@ -407,6 +376,59 @@ FN_DECIMAL FastNoise::GetNoise(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z) const
 	}
 }
 
+bool FastNoise::GetOctaveNoise(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL* octaveValues) const
+{
+	bool fractal;
+	switch (m_noiseType)
+	{
+	case Value:
+	case Perlin:
+	case Simplex:
+		fractal = false;
+		break;
+	case ValueFractal:
+	case PerlinFractal:
+	case SimplexFractal:
+		fractal = true;
+		break;
+	default:
+		return false;
+	}
+
+	x *= m_frequency;
+	y *= m_frequency;
+	z *= m_frequency;
+
+	int octaves = fractal ? m_octaves : 1;
+	for (int i = 0; i < octaves; i++)
+	{
+		// The fractals scale the point the same way between octaves
+		if (i > 0)
+		{
+			x *= m_lacunarity;
+			y *= m_lacunarity;
+			z *= m_lacunarity;
+		}
+		unsigned char offset = fractal ? m_perm[i] : 0;
+
+		switch (m_noiseType)
+		{
+		case Value:
+		case ValueFractal:
+			octaveValues[i] = SingleValue(offset, x, y, z);
+			break;
+		case Perlin:
+		case PerlinFractal:
+			octaveValues[i] = SinglePerlin(offset, x, y, z);
+			break;
+		default:
+			octaveValues[i] = SingleSimplex(offset, x, y, z);
+			break;
+		}
+	}
+	return true;
+}
+
 FN_DECIMAL FastNoise::GetNoise(FN_DECIMAL x, FN_DECIMAL y) const
 {
 	x *= m_frequency;
@@ -600,6 +622,7 @@ FN_DECIMAL FastNoise::GetValue(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z) const
 	return SingleValue(0, x * m_frequency, y * m_frequency, z * m_frequency);
 }
 
+template<FastNoise::Interp interp>
 FN_DECIMAL FastNoise::SingleValue(unsigned char offset, FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z) const
 {
 	int x0 = FastFloor(x);
@@ -610,7 +633,7 @@ FN_DECIMAL FastNoise::SingleValue(unsigned char offset, FN_DECIMAL x, FN_DECIMAL
 	int z1 = z0 + 1;
 
 	FN_DECIMAL xs, ys, zs;
-	switch (m_interp)
+	switch (interp)
 	{
 	case Linear:
 		xs = x - (FN_DECIMAL)x0;
@@ -640,6 +663,19 @@ FN_DECIMAL FastNoise::SingleValue(unsigned char offset, FN_DECIMAL x, FN_DECIMAL
 	return Lerp(yf0, yf1, zs);
 }
 
+FN_DECIMAL FastNoise::SingleValue(unsigned char offset, FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z) const
+{
+	switch (m_interp)
+	{
+	case Linear:
+		return SingleValue<Linear>(offset, x, y, z);
+	case Hermite:
+		return SingleValue<Hermite>(offset, x, y, z);
+	default:
+		return SingleValue<Quintic>(offset, x, y, z);
+	}
+}
+
 FN_DECIMAL FastNoise::GetValueFractal(FN_DECIMAL x, FN_DECIMAL y) const
 {
 	x *= m_frequency;
@@ -716,6 +752,7 @@ FN_DECIMAL FastNoise::GetValue(FN_DECIMAL x, FN_DECIMAL y) const
 	return SingleValue(0, x * m_frequency, y * m_frequency);
 }
 
+template<FastNoise::Interp interp>
 FN_DECIMAL FastNoise::SingleValue(unsigned char offset, FN_DECIMAL x, FN_DECIMAL y) const
 {
 	int x0 = FastFloor(x);
@@ -724,7 +761,7 @@ FN_DECIMAL FastNoise::SingleValue(unsigned char offset, FN_DECIMAL x, FN_DECIMAL
 	int y1 = y0 + 1;
 
 	FN_DECIMAL xs, ys;
-	switch (m_interp)
+	switch (interp)
 	{
 	case Linear:
 		xs = x - (FN_DECIMAL)x0;
@@ -746,6 +783,19 @@ FN_DECIMAL FastNoise::SingleValue(unsigned char offset, FN_DECIMAL x, FN_DECIMAL
 	return Lerp(xf0, xf1, ys);
 }
 
+FN_DECIMAL FastNoise::SingleValue(unsigned char offset, FN_DECIMAL x, FN_DECIMAL y) const
+{
+	switch (m_interp)
+	{
+	case Linear:
+		return SingleValue<Linear>(offset, x, y);
+	case Hermite:
+		return SingleValue<Hermite>(offset, x, y);
+	default:
+		return SingleValue<Quintic>(offset, x, y);
+	}
+}
+
 // Perlin Noise
 FN_DECIMAL FastNoise::GetPerlinFractal(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z) const
 {
@@ -830,49 +880,15 @@ FN_DECIMAL FastNoise::GetPerlin(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z) const
 
 FN_DECIMAL FastNoise::SinglePerlin(unsigned char offset, FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z) const
 {
-	int x0 = FastFloor(x);
-	int y0 = FastFloor(y);
-	int z0 = FastFloor(z);
-	int x1 = x0 + 1;
-	int y1 = y0 + 1;
-	int z1 = z0 + 1;
-
-	FN_DECIMAL xs, ys, zs;
 	switch (m_interp)
 	{
 	case Linear:
-		xs = x - (FN_DECIMAL)x0;
-		ys = y - (FN_DECIMAL)y0;
-		zs = z - (FN_DECIMAL)z0;
-		break;
+		return SinglePerlin<Linear>(offset, x, y, z);
 	case Hermite:
-		xs = InterpHermiteFunc(x - (FN_DECIMAL)x0);
-		ys = InterpHermiteFunc(y - (FN_DECIMAL)y0);
-		zs = InterpHermiteFunc(z - (FN_DECIMAL)z0);
-		break;
-	case Quintic:
-		xs = InterpQuinticFunc(x - (FN_DECIMAL)x0);
-		ys = InterpQuinticFunc(y - (FN_DECIMAL)y0);
-		zs = InterpQuinticFunc(z - (FN_DECIMAL)z0);
-		break;
+		return SinglePerlin<Hermite>(offset, x, y, z);
+	default:
+		return SinglePerlin<Quintic>(offset, x, y, z);
 	}
-
-	FN_DECIMAL xd0 = x - (FN_DECIMAL)x0;
-	FN_DECIMAL yd0 = y - (FN_DECIMAL)y0;
-	FN_DECIMAL zd0 = z - (FN_DECIMAL)z0;
-	FN_DECIMAL xd1 = xd0 - 1;
-	FN_DECIMAL yd1 = yd0 - 1;
-	FN_DECIMAL zd1 = zd0 - 1;
-
-	FN_DECIMAL xf00 = Lerp(GradCoord3D(offset, x0, y0, z0, xd0, yd0, zd0), GradCoord3D(offset, x1, y0, z0, xd1, yd0, zd0), xs);
-	FN_DECIMAL xf10 = Lerp(GradCoord3D(offset, x0, y1, z0, xd0, yd1, zd0), GradCoord3D(offset, x1, y1, z0, xd1, yd1, zd0), xs);
-	FN_DECIMAL xf01 = Lerp(GradCoord3D(offset, x0, y0, z1, xd0, yd0, zd1), GradCoord3D(offset, x1, y0, z1, xd1, yd0, zd1), xs);
-	FN_DECIMAL xf11 = Lerp(GradCoord3D(offset, x0, y1, z1, xd0, yd1, zd1), GradCoord3D(offset, x1, y1, z1, xd1, yd1, zd1), xs);
-
-	FN_DECIMAL yf0 = Lerp(xf00, xf10, ys);
-	FN_DECIMAL yf1 = Lerp(xf01, xf11, ys);
-
-	return Lerp(yf0, yf1, zs);
 }
 
 FN_DECIMAL FastNoise::GetPerlinFractal(FN_DECIMAL x, FN_DECIMAL y) const
@@ -954,37 +970,15 @@ FN_DECIMAL FastNoise::GetPerlin(FN_DECIMAL x, FN_DECIMAL y) const
 
 FN_DECIMAL FastNoise::SinglePerlin(unsigned char offset, FN_DECIMAL x, FN_DECIMAL y) const
 {
-	int x0 = FastFloor(x);
-	int y0 = FastFloor(y);
-	int x1 = x0 + 1;
-	int y1 = y0 + 1;
-
-	FN_DECIMAL xs, ys;
 	switch (m_interp)
 	{
 	case Linear:
-		xs = x - (FN_DECIMAL)x0;
-		ys = y - (FN_DECIMAL)y0;
-		break;
+		return SinglePerlin<Linear>(offset, x, y);
 	case Hermite:
-		xs = InterpHermiteFunc(x - (FN_DECIMAL)x0);
-		ys = InterpHermiteFunc(y - (FN_DECIMAL)y0);
-		break;
-	case Quintic:
-		xs = InterpQuinticFunc(x - (FN_DECIMAL)x0);
-		ys = InterpQuinticFunc(y - (FN_DECIMAL)y0);
-		break;
+		return SinglePerlin<Hermite>(offset, x, y);
+	default:
+		return SinglePerlin<Quintic>(offset, x, y);
 	}
-
-	FN_DECIMAL xd0 = x - (FN_DECIMAL)x0;
-	FN_DECIMAL yd0 = y - (FN_DECIMAL)y0;
-	FN_DECIMAL xd1 = xd0 - 1;
-	FN_DECIMAL yd1 = yd0 - 1;
-
-	FN_DECIMAL xf0 = Lerp(GradCoord2D(offset, x0, y0, xd0, yd0), GradCoord2D(offset, x1, y0, xd1, yd0), xs);
-	FN_DECIMAL xf1 = Lerp(GradCoord2D(offset, x0, y1, xd0, yd1), GradCoord2D(offset, x1, y1, xd1, yd1), xs);
-
-	return Lerp(xf0, xf1, ys);
 }
 
 // Simplex Noise
@@ -1070,106 +1064,6 @@ FN_DECIMAL FastNoise::GetSimplex(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z) const
 	return SingleSimplex(0, x * m_frequency, y * m_frequency, z * m_frequency);
 }
 
-static const FN_DECIMAL F3 = 1 / FN_DECIMAL(3);
-static const FN_DECIMAL G3 = 1 / FN_DECIMAL(6);
-
-FN_DECIMAL FastNoise::SingleSimplex(unsigned char offset, FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z) const
-{
-	FN_DECIMAL t = (x + y + z) * F3;
-	int i = FastFloor(x + t);
-	int j = FastFloor(y + t);
-	int k = FastFloor(z + t);
-
-	t = (i + j + k) * G3;
-	FN_DECIMAL X0 = i - t;
-	FN_DECIMAL Y0 = j - t;
-	FN_DECIMAL Z0 = k - t;
-
-	FN_DECIMAL x0 = x - X0;
-	FN_DECIMAL y0 = y - Y0;
-	FN_DECIMAL z0 = z - Z0;
-
-	int i1, j1, k1;
-	int i2, j2, k2;
-
-	if (x0 >= y0)
-	{
-		if (y0 >= z0)
-		{
-			i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 1; k2 = 0;
-		}
-		else if (x0 >= z0)
-		{
-			i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 0; k2 = 1;
-		}
-		else // x0 < z0
-		{
-			i1 = 0; j1 = 0; k1 = 1; i2 = 1; j2 = 0; k2 = 1;
-		}
-	}
-	else // x0 < y0
-	{
-		if (y0 < z0)
-		{
-			i1 = 0; j1 = 0; k1 = 1; i2 = 0; j2 = 1; k2 = 1;
-		}
-		else if (x0 < z0)
-		{
-			i1 = 0; j1 = 1; k1 = 0; i2 = 0; j2 = 1; k2 = 1;
-		}
-		else // x0 >= z0
-		{
-			i1 = 0; j1 = 1; k1 = 0; i2 = 1; j2 = 1; k2 = 0;
-		}
-	}
-
-	FN_DECIMAL x1 = x0 - i1 + G3;
-	FN_DECIMAL y1 = y0 - j1 + G3;
-	FN_DECIMAL z1 = z0 - k1 + G3;
-	FN_DECIMAL x2 = x0 - i2 + 2 * G3;
-	FN_DECIMAL y2 = y0 - j2 + 2 * G3;
-	FN_DECIMAL z2 = z0 - k2 + 2 * G3;
-	FN_DECIMAL x3 = x0 - 1 + 3 * G3;
-	FN_DECIMAL y3 = y0 - 1 + 3 * G3;
-	FN_DECIMAL z3 = z0 - 1 + 3 * G3;
-
-	FN_DECIMAL n0, n1, n2, n3;
-
-	t = FN_DECIMAL(0.6) - x0 * x0 - y0 * y0 - z0 * z0;
-	if (t < 0) n0 = 0;
-	else
-	{
-		t *= t;
-		n0 = t * t*GradCoord3D(offset, i, j, k, x0, y0, z0);
-	}
-
-	t = FN_DECIMAL(0.6) - x1 * x1 - y1 * y1 - z1 * z1;
-	if (t < 0) n1 = 0;
-	else
-	{
-		t *= t;
-		n1 = t * t*GradCoord3D(offset, i + i1, j + j1, k + k1, x1, y1, z1);
-	}
-
-	t = FN_DECIMAL(0.6) - x2 * x2 - y2 * y2 - z2 * z2;
-	if (t < 0) n2 = 0;
-	else
-	{
-		t *= t;
-		n2 = t * t*GradCoord3D(offset, i + i2, j + j2, k + k2, x2, y2, z2);
-	}
-
-	t = FN_DECIMAL(0.6) - x3 * x3 - y3 * y3 - z3 * z3;
-	if (t < 0) n3 = 0;
-	else
-	{
-		t *= t;
-		n3 = t * t*GradCoord3D(offset, i + 1, j + 1, k + 1, x3, y3, z3);
-	}
-
-	return 32 * (n0 + n1 + n2 + n3);
-}
-
 FN_DECIMAL FastNoise::GetSimplexFractal(FN_DECIMAL x, FN_DECIMAL y) const
 {
 	x *= m_frequency;
@@ -1265,70 +1159,6 @@ FN_DECIMAL FastNoise::GetSimplex(FN_DECIMAL x, FN_DECIMAL y) const
 	return SingleSimplex(0, x * m_frequency, y * m_frequency);
 }
 
-//static const FN_DECIMAL F2 = 1 / FN_DECIMAL(2);
-//static const FN_DECIMAL G2 = 1 / FN_DECIMAL(4);
-
-static const FN_DECIMAL SQRT3 = FN_DECIMAL(1.7320508075688772935274463415059);
-static const FN_DECIMAL F2 = FN_DECIMAL(0.5) * (SQRT3 - FN_DECIMAL(1.0));
-static const FN_DECIMAL G2 = (FN_DECIMAL(3.0) - SQRT3) / FN_DECIMAL(6.0);
-
-FN_DECIMAL FastNoise::SingleSimplex(unsigned char offset, FN_DECIMAL x, FN_DECIMAL y) const
-{
-	FN_DECIMAL t = (x + y) * F2;
-	int i = FastFloor(x + t);
-	int j = FastFloor(y + t);
-
-	t = (i + j) * G2;
-	FN_DECIMAL X0 = i - t;
-	FN_DECIMAL Y0 = j - t;
-
-	FN_DECIMAL x0 = x - X0;
-	FN_DECIMAL y0 = y - Y0;
-
-	int i1, j1;
-	if (x0 > y0)
-	{
-		i1 = 1; j1 = 0;
-	}
-	else
-	{
-		i1 = 0; j1 = 1;
-	}
-
-	FN_DECIMAL x1 = x0 - (FN_DECIMAL)i1 + G2;
-	FN_DECIMAL y1 = y0 - (FN_DECIMAL)j1 + G2;
-	FN_DECIMAL x2 = x0 - 1 + 2 * G2;
-	FN_DECIMAL y2 = y0 - 1 + 2 * G2;
-
-	FN_DECIMAL n0, n1, n2;
-
-	t = FN_DECIMAL(0.5) - x0 * x0 - y0 * y0;
-	if (t < 0) n0 = 0;
-	else
-	{
-		t *= t;
-		n0 = t * t * GradCoord2D(offset, i, j, x0, y0);
-	}
-
-	t = FN_DECIMAL(0.5) - x1 * x1 - y1 * y1;
-	if (t < 0) n1 = 0;
-	else
-	{
-		t *= t;
-		n1 = t * t*GradCoord2D(offset, i + i1, j + j1, x1, y1);
-	}
-
-	t = FN_DECIMAL(0.5) - x2 * x2 - y2 * y2;
-	if (t < 0) n2 = 0;
-	else
-	{
-		t *= t;
-		n2 = t * t*GradCoord2D(offset, i + 1, j + 1, x2, y2);
-	}
-
-	return 70 * (n0 + n1 + n2);
-}
-
 FN_DECIMAL FastNoise::GetSimplex(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w) const
 {
 	return SingleSimplex(0, x * m_frequency, y * m_frequency, z * m_frequency, w * m_frequency);
@@ -2248,3 +2078,662 @@ void FastNoise::SingleGradientPerturb(unsigned char offset, FN_DECIMAL warpAmp,
 	x += Lerp(lx0x, lx1x, ys) * warpAmp;
 	y += Lerp(ly0x, ly1x, ys) * warpAmp;
 }
+
+// The feature points of the cells a tile of samples searches, looked up once by FillCellularSlab(...)
+// and shared by every sample. Cell (x, y, z) is entry ((x - xMin) * ySize + y - yMin) * zSize + z - zMin
+struct FastNoiseCellTable
+{
+	int xMin, yMin, zMin;
+	int ySize, zSize;
+	std::vector<FN_DECIMAL> jitterX, jitterY, jitterZ; // CELL_3D_* times the jitter
+	std::vector<FN_DECIMAL> values;                     // CellValue or NoiseLookup of a cell, once known
+	std::vector<unsigned char> known;
+
+	// The slab's rows and one tile's padded columns, scaled by the frequency and rounded
+	std::vector<FN_DECIMAL> ys, zs, out;
+	std::vector<int> yrs, zrs, nearest;
+};
+
+// The cellular settings of a FastNoise the search kernels read
+struct FastNoiseCellularSearch
+{
+	FastNoise::CellularDistanceFunction distanceFunction;
+	FastNoise::CellularReturnType returnType;
+	bool twoEdge;
+	int index0;
+	int index1;
+};
+
+typedef void(*FastNoiseCellularKernel)(const FastNoiseCellTable& t, const FastNoiseCellularSearch& s, FN_DECIMAL x, int xr,
+	FN_DECIMAL y, int yr, const FN_DECIMAL* zs, const int* zrs, FN_DECIMAL* out, int* nearest, int count);
+
+#ifdef FN_SIMD_X86
+// Everything the vector kernels read from a FastNoise, with the permutation tables widened to int for gathers
+struct FastNoiseSIMDParams
+{
+	FastNoise::NoiseType noiseType;
+	bool fractal;
+	FastNoise::FractalType fractalType;
+	FastNoise::Interp interp;
+	int octaves;
+	FN_DECIMAL lacunarity;
+	FN_DECIMAL gain;
+	FN_DECIMAL fractalBounding;
+	int perm[512];
+	int perm12[512];
+};
+
+typedef void(*FastNoiseSIMDKernel)(const FastNoiseSIMDParams& p, int dimensions, const float* xs, const float* ys,
+	const float* zs, float* out, int count);
+
+// The simplex skew factors, the same as the private ones FastNoise::SingleSimplex uses
+static const FN_DECIMAL SQRT3 = FN_DECIMAL(1.7320508075688772935274463415059);
+static const FN_DECIMAL F2 = FN_DECIMAL(0.5) * (SQRT3 - FN_DECIMAL(1.0));
+static const FN_DECIMAL G2 = (FN_DECIMAL(3.0) - SQRT3) / FN_DECIMAL(6.0);
+static const FN_DECIMAL F3 = 1 / FN_DECIMAL(3);
+static const FN_DECIMAL G3 = 1 / FN_DECIMAL(6);
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse4.1"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#endif
+#define FN_SIMD_NAMESPACE FastNoiseSSE41
+#include "fastnoise_simd.inl"
+#undef FN_SIMD_NAMESPACE
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+#define FN_SIMD_NAMESPACE FastNoiseAVX2
+#define FN_SIMD_AVX2
+#include "fastnoise_simd.inl"
+#undef FN_SIMD_AVX2
+#undef FN_SIMD_NAMESPACE
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+#endif
+
+#ifdef FN_SIMD_X86
+static FastNoiseSIMDKernel SelectSIMDKernel(FastNoise::NoiseType noiseType, FastNoise::SIMDLevel level)
+{
+	if (noiseType != FastNoise::Perlin && noiseType != FastNoise::PerlinFractal &&
+		noiseType != FastNoise::Simplex && noiseType != FastNoise::SimplexFractal)
+		return nullptr;
+
+	switch (level)
+	{
+	case FastNoise::SIMD_AVX2:
+		return FastNoiseAVX2::FillPoints;
+	case FastNoise::SIMD_SSE41:
+		return FastNoiseSSE41::FillPoints;
+	default:
+		return nullptr;
+	}
+}
+
+void FastNoise::FillSIMDParams(FastNoiseSIMDParams& params) const
+{
+	params.noiseType = m_noiseType;
+	params.fractal = m_noiseType == PerlinFractal || m_noiseType == SimplexFractal;
+	params.fractalType = m_fractalType;
+	params.interp = m_interp;
+	params.octaves = m_octaves;
+	params.lacunarity = m_lacunarity;
+	params.gain = m_gain;
+	params.fractalBounding = m_fractalBounding;
+	std::copy(m_perm, m_perm + 512, params.perm);
+	std::copy(m_perm12, m_perm12 + 512, params.perm12);
+}
+#endif
+
+// GetNoise(...) for a list of points through the vector kernels, false when there are none for this noise type or CPU
+bool FastNoise::FillNoisePointsSIMD(FN_DECIMAL* noiseSet, const FN_DECIMAL* xs, const FN_DECIMAL* ys, const FN_DECIMAL* zs, int count) const
+{
+#ifdef FN_SIMD_X86
+	FastNoiseSIMDKernel kernel = SelectSIMDKernel(m_noiseType, GetSIMDLevel());
+	if (!kernel)
+		return false;
+
+	FastNoiseSIMDParams params;
+	FillSIMDParams(params);
+
+	// Blocks padded to a multiple of 8 by repeating the last point, as in FillNoiseRows(...)
+	const int blockSize = 64;
+	FN_DECIMAL bx[blockSize], by[blockSize], bz[blockSize], out[blockSize];
+	int dimensions = zs ? 3 : 2;
+	for (int begin = 0; begin < count; begin += blockSize)
+	{
+		int length = std::min(blockSize, count - begin);
+		int paddedLength = (length + 7) & ~7;
+		for (int i = 0; i < paddedLength; i++)
+		{
+			int point = begin + std::min(i, length - 1);
+			bx[i] = xs[point] * m_frequency;
+			by[i] = ys[point] * m_frequency;
+			bz[i] = zs ? zs[point] * m_frequency : 0;
+		}
+		kernel(params, dimensions, bx, by, bz, out, paddedLength);
+		std::copy(out, out + length, noiseSet + begin);
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+FastNoise::SIMDLevel FastNoise::GetSupportedSIMDLevel()
+{
+	static const SIMDLevel supported = []()
+	{
+#if !defined(FN_SIMD_X86)
+		return SIMD_None;
+#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+		__cpuid(info, 1);
+		bool sse41 = (info[2] & (1 << 19)) != 0;
+		// AVX2 also needs the OS to save the ymm registers (OSXSAVE, AVX, XCR0 bits 1 and 2)
+		bool avx2 = false;
+		if ((info[2] & (1 << 27)) && (info[2] & (1 << 28)) && maxLeaf >= 7 && (_xgetbv(0) & 6) == 6)
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+		return avx2 ? SIMD_AVX2 : sse41 ? SIMD_SSE41 : SIMD_None;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") ? SIMD_AVX2 : __builtin_cpu_supports("sse4.1") ? SIMD_SSE41 : SIMD_None;
+#endif
+	}();
+	return supported;
+}
+
+FastNoise::SIMDLevel FastNoise::GetSIMDLevel() const
+{
+	return std::min(m_simdLevel, GetSupportedSIMDLevel());
+}
+
+void FastNoise::FillNoiseSet(FN_DECIMAL* noiseSet, FN_DECIMAL xStart, FN_DECIMAL yStart, FN_DECIMAL zStart,
+	int xSize, int ySize, int zSize, FN_DECIMAL step, int threadCount) const
+{
+	FillNoiseRows(noiseSet, 3, xStart, yStart, zStart, xSize, ySize, zSize, step, threadCount);
+}
+
+void FastNoise::FillNoiseSet2D(FN_DECIMAL* noiseSet, FN_DECIMAL xStart, FN_DECIMAL yStart,
+	int xSize, int ySize, FN_DECIMAL step, int threadCount) const
+{
+	FillNoiseRows(noiseSet, 2, xStart, yStart, 0, xSize, ySize, 1, step, threadCount);
+}
+
+void FastNoise::FillNoiseRows(FN_DECIMAL* noiseSet, int dimensions, FN_DECIMAL xStart, FN_DECIMAL yStart, FN_DECIMAL zStart,
+	int xSize, int ySize, int zSize, FN_DECIMAL step, int threadCount) const
+{
+	if (xSize <= 0 || ySize <= 0 || zSize <= 0)
+		return;
+
+	// Rows run along the last axis, z in 3D and y in 2D, and each x slab is one unit of work
+	int rowLength = dimensions == 3 ? zSize : ySize;
+	int rowCount = dimensions == 3 ? ySize : 1;
+	FN_DECIMAL rowStart = dimensions == 3 ? zStart : yStart;
+
+#ifdef FN_SIMD_X86
+	FastNoiseSIMDKernel kernel = SelectSIMDKernel(m_noiseType, GetSIMDLevel());
+	FastNoiseSIMDParams params;
+	if (kernel)
+		FillSIMDParams(params);
+#endif
+
+	// The type switch in GetNoise(...), done once for the whole set. GetWhiteNoise(...) skips the
+	// frequency that GetNoise(...) applies, so white noise keeps going through GetNoise(...)
+	FN_DECIMAL(FastNoise::*noise2D)(FN_DECIMAL, FN_DECIMAL) const = &FastNoise::GetNoise;
+	FN_DECIMAL(FastNoise::*noise3D)(FN_DECIMAL, FN_DECIMAL, FN_DECIMAL) const = &FastNoise::GetNoise;
+	switch (m_noiseType)
+	{
+	case Value:
+		noise2D = &FastNoise::GetValue;
+		noise3D = &FastNoise::GetValue;
+		break;
+	case ValueFractal:
+		noise2D = &FastNoise::GetValueFractal;
+		noise3D = &FastNoise::GetValueFractal;
+		break;
+	case Perlin:
+		noise2D = &FastNoise::GetPerlin;
+		noise3D = &FastNoise::GetPerlin;
+		break;
+	case PerlinFractal:
+		noise2D = &FastNoise::GetPerlinFractal;
+		noise3D = &FastNoise::GetPerlinFractal;
+		break;
+	case Simplex:
+		noise2D = &FastNoise::GetSimplex;
+		noise3D = &FastNoise::GetSimplex;
+		break;
+	case SimplexFractal:
+		noise2D = &FastNoise::GetSimplexFractal;
+		noise3D = &FastNoise::GetSimplexFractal;
+		break;
+	case Cellular:
+		noise2D = &FastNoise::GetCellular;
+		noise3D = &FastNoise::GetCellular;
+		break;
+	case Cubic:
+		noise2D = &FastNoise::GetCubic;
+		noise3D = &FastNoise::GetCubic;
+		break;
+	case CubicFractal:
+		noise2D = &FastNoise::GetCubicFractal;
+		noise3D = &FastNoise::GetCubicFractal;
+		break;
+	default:
+		break;
+	}
+
+	std::atomic<int> nextX(0);
+	auto fillSlabs = [&]()
+	{
+		// Rows are padded to a multiple of 8 by repeating the last point, so the kernels never need a tail loop
+		int paddedLength = (rowLength + 7) & ~7;
+		std::vector<FN_DECIMAL> xs(paddedLength), ys(paddedLength), zs(paddedLength), out(paddedLength);
+		FastNoiseCellTable cellTable;
+
+		for (int x = nextX++; x < xSize; x = nextX++)
+		{
+			FN_DECIMAL xf = xStart + x * step;
+			if (dimensions == 3 && m_noiseType == Cellular)
+			{
+				FillCellularSlab(noiseSet + (size_t)x * rowCount * rowLength, xf, yStart, zStart, ySize, zSize, step, cellTable);
+				continue;
+			}
+			for (int row = 0; row < rowCount; row++)
+			{
+				FN_DECIMAL yf = yStart + row * step;
+				FN_DECIMAL* rowSet = noiseSet + ((size_t)x * rowCount + row) * rowLength;
+#ifdef FN_SIMD_X86
+				if (kernel)
+				{
+					std::vector<FN_DECIMAL>& line = dimensions == 3 ? zs : ys;
+					for (int i = 0; i < paddedLength; i++)
+					{
+						xs[i] = xf * m_frequency;
+						if (dimensions == 3)
+							ys[i] = yf * m_frequency;
+						line[i] = (rowStart + std::min(i, rowLength - 1) * step) * m_frequency;
+					}
+					kernel(params, dimensions, xs.data(), ys.data(), zs.data(), out.data(), paddedLength);
+					std::copy(out.begin(), out.begin() + rowLength, rowSet);
+					continue;
+				}
+#endif
+				for (int i = 0; i < rowLength; i++)
+				{
+					FN_DECIMAL f = rowStart + i * step;
+					rowSet[i] = dimensions == 3 ? (this->*noise3D)(xf, yf, f) : (this->*noise2D)(xf, f);
+				}
+			}
+		}
+	};
+
+	threadCount = std::min(threadCount, xSize);
+	std::vector<std::thread> threads;
+	for (int t = 1; t < threadCount; t++)
+		threads.emplace_back(fillSlabs);
+	fillSlabs();
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+// The search of SingleCellular(...) or SingleCellular2Edge(...) over the cell table, one sample at a time
+template <int distanceFunction, bool twoEdge>
+static void CellularSearch(const FastNoiseCellTable& t, const FastNoiseCellularSearch& s, FN_DECIMAL x, int xr,
+	FN_DECIMAL y, int yr, const FN_DECIMAL* zs, const int* zrs, FN_DECIMAL* out, int* nearest, int count)
+{
+	const int index0 = s.index0;
+	const int index1 = s.index1;
+	for (int n = 0; n < count; n++)
+	{
+		FN_DECIMAL z = zs[n];
+		int zr = zrs[n];
+		FN_DECIMAL distance[FN_CELLULAR_INDEX_MAX + 1] = { 999999,999999,999999,999999 };
+		int best = 0;
+
+		for (int xi = xr - 1; xi <= xr + 1; xi++)
+		{
+			for (int yi = yr - 1; yi <= yr + 1; yi++)
+			{
+				int cell = ((xi - t.xMin) * t.ySize + yi - t.yMin) * t.zSize + zr - 1 - t.zMin;
+				for (int zi = zr - 1; zi <= zr + 1; zi++, cell++)
+				{
+					FN_DECIMAL vecX = xi - x + t.jitterX[cell];
+					FN_DECIMAL vecY = yi - y + t.jitterY[cell];
+					FN_DECIMAL vecZ = zi - z + t.jitterZ[cell];
+
+					FN_DECIMAL newDistance;
+					switch (distanceFunction)
+					{
+					case FastNoise::Manhattan:
+						newDistance = FastAbs(vecX) + FastAbs(vecY) + FastAbs(vecZ);
+						break;
+					case FastNoise::Natural:
+						newDistance = (FastAbs(vecX) + FastAbs(vecY) + FastAbs(vecZ)) + (vecX * vecX + vecY * vecY + vecZ * vecZ);
+						break;
+					default:
+						newDistance = vecX * vecX + vecY * vecY + vecZ * vecZ;
+						break;
+					}
+
+					if (twoEdge)
+					{
+						for (int i = index1; i > 0; i--)
+							distance[i] = fmax(fmin(distance[i], newDistance), distance[i - 1]);
+						distance[0] = fmin(distance[0], newDistance);
+					}
+					else if (newDistance < distance[0])
+					{
+						distance[0] = newDistance;
+						best = cell;
+					}
+				}
+			}
+		}
+
+		if (!twoEdge)
+		{
+			out[n] = distance[0];
+			nearest[n] = best;
+			continue;
+		}
+
+		switch (s.returnType)
+		{
+		case FastNoise::Distance2Add:
+			out[n] = distance[index1] + distance[index0];
+			break;
+		case FastNoise::Distance2Sub:
+			out[n] = distance[index1] - distance[index0];
+			break;
+		case FastNoise::Distance2Mul:
+			out[n] = distance[index1] * distance[index0];
+			break;
+		case FastNoise::Distance2Div:
+			out[n] = distance[index0] / distance[index1];
+			break;
+		default:
+			out[n] = distance[index1];
+			break;
+		}
+	}
+}
+
+static void CellularRow(const FastNoiseCellTable& t, const FastNoiseCellularSearch& s, FN_DECIMAL x, int xr,
+	FN_DECIMAL y, int yr, const FN_DECIMAL* zs, const int* zrs, FN_DECIMAL* out, int* nearest, int count)
+{
+	switch (s.distanceFunction)
+	{
+	case FastNoise::Manhattan:
+		if (s.twoEdge)
+			CellularSearch<FastNoise::Manhattan, true>(t, s, x, xr, y, yr, zs, zrs, out, nearest, count);
+		else
+			CellularSearch<FastNoise::Manhattan, false>(t, s, x, xr, y, yr, zs, zrs, out, nearest, count);
+		break;
+	case FastNoise::Natural:
+		if (s.twoEdge)
+			CellularSearch<FastNoise::Natural, true>(t, s, x, xr, y, yr, zs, zrs, out, nearest, count);
+		else
+			CellularSearch<FastNoise::Natural, false>(t, s, x, xr, y, yr, zs, zrs, out, nearest, count);
+		break;
+	default:
+		if (s.twoEdge)
+			CellularSearch<FastNoise::Euclidean, true>(t, s, x, xr, y, yr, zs, zrs, out, nearest, count);
+		else
+			CellularSearch<FastNoise::Euclidean, false>(t, s, x, xr, y, yr, zs, zrs, out, nearest, count);
+		break;
+	}
+}
+
+static FastNoiseCellularKernel SelectCellularKernel(FastNoise::SIMDLevel level)
+{
+#ifdef FN_SIMD_X86
+	switch (level)
+	{
+	case FastNoise::SIMD_AVX2:
+		return FastNoiseAVX2::CellularRow;
+	case FastNoise::SIMD_SSE41:
+		return FastNoiseSSE41::CellularRow;
+	default:
+		break;
+	}
+#endif
+	return CellularRow;
+}
+
+// FillNoiseRows(...) for one x slab of 3D Cellular noise. Neighbouring samples search mostly the same
+// 3 * 3 * 3 cells, so the slab goes in tiles of 32 * 32 samples: the feature points of every cell a tile
+// reaches are looked up once into the table, then each row of the tile searches the table, 8 or 4 samples
+// at a time with AVX2 or SSE4.1. Cells are visited in the same order with the same arithmetic as in
+// SingleCellular(...) and SingleCellular2Edge(...), so every sample equals GetNoise(...)
+void FastNoise::FillCellularSlab(FN_DECIMAL* slabSet, FN_DECIMAL xf, FN_DECIMAL yStart, FN_DECIMAL zStart,
+	int ySize, int zSize, FN_DECIMAL step, FastNoiseCellTable& table) const
+{
+	const int tileSize = 32;
+	FastNoiseCellularKernel kernel = SelectCellularKernel(GetSIMDLevel());
+	FastNoiseCellularSearch search;
+	search.distanceFunction = m_cellularDistanceFunction;
+	search.returnType = m_cellularReturnType;
+	search.twoEdge = m_cellularReturnType != CellValue && m_cellularReturnType != NoiseLookup && m_cellularReturnType != Distance;
+	search.index0 = m_cellularDistanceIndex0;
+	search.index1 = m_cellularDistanceIndex1;
+	bool cellValues = m_cellularReturnType == CellValue || m_cellularReturnType == NoiseLookup;
+
+	FN_DECIMAL x = xf * m_frequency;
+	int xr = FastRound(x);
+	table.ys.resize(ySize);
+	table.yrs.resize(ySize);
+	for (int i = 0; i < ySize; i++)
+	{
+		table.ys[i] = (yStart + i * step) * m_frequency;
+		table.yrs[i] = FastRound(table.ys[i]);
+	}
+	table.zs.resize(tileSize);
+	table.zrs.resize(tileSize);
+	table.out.resize(tileSize);
+	table.nearest.resize(tileSize);
+
+	for (int y0 = 0; y0 < ySize; y0 += tileSize)
+	{
+		int yEnd = std::min(ySize, y0 + tileSize);
+		for (int z0 = 0; z0 < zSize; z0 += tileSize)
+		{
+			// Columns padded to a multiple of 8 by repeating the last one, as in FillNoiseRows(...)
+			int length = std::min(zSize, z0 + tileSize) - z0;
+			int paddedLength = (length + 7) & ~7;
+			for (int i = 0; i < paddedLength; i++)
+			{
+				table.zs[i] = (zStart + (z0 + std::min(i, length - 1)) * step) * m_frequency;
+				table.zrs[i] = FastRound(table.zs[i]);
+			}
+
+			auto yRange = std::minmax_element(table.yrs.begin() + y0, table.yrs.begin() + yEnd);
+			auto zRange = std::minmax_element(table.zrs.begin(), table.zrs.begin() + length);
+			table.xMin = xr - 1;
+			table.yMin = *yRange.first - 1;
+			table.zMin = *zRange.first - 1;
+			table.ySize = *yRange.second - *yRange.first + 3;
+			table.zSize = *zRange.second - *zRange.first + 3;
+			size_t cells = 3 * (size_t)table.ySize * table.zSize;
+
+			// Steps of a cell or more leave few cells shared, so such tiles are searched sample by sample
+			if (cells > 27 * (size_t)(yEnd - y0) * length)
+			{
+				for (int row = y0; row < yEnd; row++)
+				{
+					FN_DECIMAL* rowSet = slabSet + (size_t)row * zSize + z0;
+					for (int i = 0; i < length; i++)
+						rowSet[i] = GetCellular(xf, yStart + row * step, zStart + (z0 + i) * step);
+				}
+				continue;
+			}
+
+			table.jitterX.resize(cells);
+			table.jitterY.resize(cells);
+			table.jitterZ.resize(cells);
+			size_t cell = 0;
+			for (int xi = table.xMin; xi < table.xMin + 3; xi++)
+			{
+				for (int yi = table.yMin; yi < table.yMin + table.ySize; yi++)
+				{
+					for (int zi = table.zMin; zi < table.zMin + table.zSize; zi++, cell++)
+					{
+						unsigned char lutPos = Index3D_256(0, xi, yi, zi);
+						table.jitterX[cell] = CELL_3D_X[lutPos] * m_cellularJitter;
+						table.jitterY[cell] = CELL_3D_Y[lutPos] * m_cellularJitter;
+						table.jitterZ[cell] = CELL_3D_Z[lutPos] * m_cellularJitter;
+					}
+				}
+			}
+			if (cellValues)
+			{
+				table.values.resize(cells);
+				table.known.assign(cells, 0);
+			}
+
+			for (int row = y0; row < yEnd; row++)
+			{
+				FN_DECIMAL* rowSet = slabSet + (size_t)row * zSize + z0;
+				kernel(table, search, x, xr, table.ys[row], table.yrs[row], table.zs.data(), table.zrs.data(),
+					table.out.data(), table.nearest.data(), paddedLength);
+				if (!cellValues)
+				{
+					std::copy(table.out.begin(), table.out.begin() + length, rowSet);
+					continue;
+				}
+
+				// The value of the nearest cell, worked out the first time any sample lands in it
+				for (int i = 0; i < length; i++)
+				{
+					int nearest = table.nearest[i];
+					if (!table.known[nearest])
+					{
+						int xc = nearest / (table.ySize * table.zSize) + table.xMin;
+						int yc = nearest / table.zSize % table.ySize + table.yMin;
+						int zc = nearest % table.zSize + table.zMin;
+						if (m_cellularReturnType == CellValue)
+						{
+							table.values[nearest] = ValCoord3D(m_seed, xc, yc, zc);
+						}
+						else
+						{
+							assert(m_cellularNoiseLookup);
+							table.values[nearest] = m_cellularNoiseLookup->GetNoise(xc + table.jitterX[nearest],
+								yc + table.jitterY[nearest], zc + table.jitterZ[nearest]);
+						}
+						table.known[nearest] = 1;
+					}
+					rowSet[i] = table.values[nearest];
+				}
+			}
+		}
+	}
+}
+
+// NoiseKernel
+
+// The kernel for noise types without a NoiseKernel, one for all of them
+class RuntimeNoiseKernel final : public FastNoiseKernel
+{
+public:
+	explicit RuntimeNoiseKernel(const FastNoise& noise) : m_noise(noise) {}
+
+	FN_DECIMAL GetNoise(FN_DECIMAL x, FN_DECIMAL y) const override { return m_noise.GetNoise(x, y); }
+	FN_DECIMAL GetNoise(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z) const override { return m_noise.GetNoise(x, y, z); }
+
+	void GetNoiseSet(FN_DECIMAL* noiseSet, const FN_DECIMAL* xs, const FN_DECIMAL* ys, const FN_DECIMAL* zs, int count) const override
+	{
+		if (zs)
+		{
+			for (int i = 0; i < count; i++)
+				noiseSet[i] = m_noise.GetNoise(xs[i], ys[i], zs[i]);
+		}
+		else
+		{
+			for (int i = 0; i < count; i++)
+				noiseSet[i] = m_noise.GetNoise(xs[i], ys[i]);
+		}
+	}
+
+private:
+	FastNoise m_noise;
+};
+
+template<FastNoise::NoiseType noiseType, FastNoise::FractalType fractalType>
+static FastNoiseKernel* CreateKernelWithInterp(const FastNoise& noise, FastNoise::Interp interp)
+{
+	switch (interp)
+	{
+	case FastNoise::Linear:
+		return new NoiseKernel<noiseType, fractalType, FastNoise::Linear>(noise);
+	case FastNoise::Hermite:
+		return new NoiseKernel<noiseType, fractalType, FastNoise::Hermite>(noise);
+	default:
+		return new NoiseKernel<noiseType, fractalType, FastNoise::Quintic>(noise);
+	}
+}
+
+template<FastNoise::NoiseType noiseType, FastNoise::Interp interp>
+static FastNoiseKernel* CreateKernelWithFractal(const FastNoise& noise, FastNoise::FractalType fractalType)
+{
+	switch (fractalType)
+	{
+	case FastNoise::Billow:
+		return new NoiseKernel<noiseType, FastNoise::Billow, interp>(noise);
+	case FastNoise::RigidMulti:
+		return new NoiseKernel<noiseType, FastNoise::RigidMulti, interp>(noise);
+	default:
+		return new NoiseKernel<noiseType, FastNoise::FBM, interp>(noise);
+	}
+}
+
+std::unique_ptr<FastNoiseKernel> FastNoise::CreateKernel() const
+{
+	// Only the settings a kernel specializes on pick an instantiation: the fractal type only matters
+	// to PerlinFractal and SimplexFractal and the interpolation only to Perlin, which leaves 16 of them
+	FastNoiseKernel* kernel;
+	switch (m_noiseType)
+	{
+	case Perlin:
+		kernel = CreateKernelWithInterp<Perlin, FBM>(*this, m_interp);
+		break;
+	case PerlinFractal:
+		if (m_interp == Linear)
+			kernel = CreateKernelWithFractal<PerlinFractal, Linear>(*this, m_fractalType);
+		else if (m_interp == Hermite)
+			kernel = CreateKernelWithFractal<PerlinFractal, Hermite>(*this, m_fractalType);
+		else
+			kernel = CreateKernelWithFractal<PerlinFractal, Quintic>(*this, m_fractalType);
+		break;
+	case Simplex:
+		kernel = new NoiseKernel<Simplex, FBM, Quintic>(*this);
+		break;
+	case SimplexFractal:
+		kernel = CreateKernelWithFractal<SimplexFractal, Quintic>(*this, m_fractalType);
+		break;
+	default:
+		kernel = new RuntimeNoiseKernel(*this);
+		break;
+	}
+	return std::unique_ptr<FastNoiseKernel>(kernel);
+}
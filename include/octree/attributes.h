@@ -0,0 +1,156 @@
+#ifndef ATTRIBUTES_H
+#define ATTRIBUTES_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// How voxel colors are stored in an attribute stream. Streams are arrays of 32-bit words
+// so they upload to the shader as they are; attributeEncoding in compute.glsl uses the
+// same numbering.
+enum class AttributeEncoding {
+    Float = 0,      // 4 words per color, the raw vec4
+    RGBA8 = 1,      // 1 word per color, red in the low byte
+    RGB565 = 2,     // 2 colors per word, alpha is always 1
+    Palette8 = 3,   // 4 indices per word into a shared palette of up to 256 colors
+    Palette16 = 4   // 2 indices per word into a shared palette of up to 65536 colors
+};
+
+inline int attributeBits(AttributeEncoding encoding) {
+    switch (encoding) {
+        case AttributeEncoding::Float: return 128;
+        case AttributeEncoding::RGBA8: return 32;
+        case AttributeEncoding::Palette8: return 8;
+        default: return 16;
+    }
+}
+
+inline bool isPaletteEncoding(AttributeEncoding encoding) {
+    return encoding == AttributeEncoding::Palette8 || encoding == AttributeEncoding::Palette16;
+}
+
+inline uint32_t packRGBA8(glm::vec4 color) {
+    glm::uvec4 c(glm::round(glm::clamp(color, 0.0f, 1.0f) * 255.0f));
+    return c.r | (c.g << 8) | (c.b << 16) | (c.a << 24);
+}
+
+inline glm::vec4 unpackRGBA8(uint32_t v) {
+    return glm::vec4(v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, v >> 24) / 255.0f;
+}
+
+inline uint32_t packRGB565(glm::vec4 color) {
+    glm::vec3 c = glm::clamp(glm::vec3(color), 0.0f, 1.0f);
+    uint32_t r = static_cast<uint32_t>(std::round(c.r * 31.0f));
+    uint32_t g = static_cast<uint32_t>(std::round(c.g * 63.0f));
+    uint32_t b = static_cast<uint32_t>(std::round(c.b * 31.0f));
+    return (r << 11) | (g << 5) | b;
+}
+
+inline glm::vec4 unpackRGB565(uint32_t v) {
+    return glm::vec4(((v >> 11) & 31) / 31.0f, ((v >> 5) & 63) / 63.0f, (v & 31) / 31.0f, 1.0f);
+}
+
+// Builds a palette of at most maxEntries colors for the given colors. Colors are keyed on
+// their RGBA8 value; when there are too many, channels are truncated one bit at a time
+// until the distinct values fit, and each entry becomes the mean of the colors it covers.
+inline std::vector<glm::vec4> buildPalette(const std::vector<glm::vec4>& colors, size_t maxEntries) {
+    for (int dropBits = 0; dropBits < 8; dropBits++) {
+        uint32_t mask = (0xffu << dropBits) & 0xffu;
+        uint32_t keyMask = mask | (mask << 8) | (mask << 16) | (mask << 24);
+        std::map<uint32_t, std::pair<glm::dvec4, int>> buckets;
+        bool fits = true;
+        for (const glm::vec4& color : colors) {
+            auto& bucket = buckets[packRGBA8(color) & keyMask];
+            bucket.first += glm::dvec4(color);
+            bucket.second++;
+            if (buckets.size() > maxEntries) {
+                fits = false;
+                break;
+            }
+        }
+        if (!fits) {
+            continue;
+        }
+        std::vector<glm::vec4> palette;
+        for (const auto& bucket : buckets) {
+            palette.push_back(glm::vec4(bucket.second.first / static_cast<double>(bucket.second.second)));
+        }
+        return palette;
+    }
+    return std::vector<glm::vec4>(1, glm::vec4(1.0f));
+}
+
+// Index of the palette entry closest to color.
+inline int nearestPaletteIndex(const std::vector<glm::vec4>& palette, glm::vec4 color) {
+    int best = 0;
+    float bestDistance = INFINITY;
+    for (size_t i = 0; i < palette.size(); i++) {
+        glm::vec4 d = palette[i] - color;
+        float distance = glm::dot(d, d);
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = static_cast<int>(i);
+        }
+    }
+    return best;
+}
+
+// Encodes colors into a word stream. Palette encodings need the palette built beforehand
+// from (at least) these colors.
+inline std::vector<uint32_t> encodeAttributes(const std::vector<glm::vec4>& colors, AttributeEncoding encoding,
+                                       const std::vector<glm::vec4>& palette) {
+    int bits = attributeBits(encoding);
+    std::vector<uint32_t> words((colors.size() * bits + 31) / 32, 0);
+    std::map<uint32_t, int> paletteLookup; // RGBA8 key -> index, so repeated colors skip the search
+    for (size_t i = 0; i < colors.size(); i++) {
+        glm::vec4 color = colors[i];
+        switch (encoding) {
+            case AttributeEncoding::Float:
+                std::memcpy(&words[i * 4], &color, sizeof(glm::vec4));
+                break;
+            case AttributeEncoding::RGBA8:
+                words[i] = packRGBA8(color);
+                break;
+            case AttributeEncoding::RGB565:
+                words[i / 2] |= packRGB565(color) << (16 * (i % 2));
+                break;
+            default: {
+                uint32_t key = packRGBA8(color);
+                auto found = paletteLookup.find(key);
+                if (found == paletteLookup.end()) {
+                    found = paletteLookup.insert({key, nearestPaletteIndex(palette, color)}).first;
+                }
+                size_t perWord = 32 / bits;
+                words[i / perWord] |= static_cast<uint32_t>(found->second) << (bits * (i % perWord));
+                break;
+            }
+        }
+    }
+    return words;
+}
+
+inline glm::vec4 decodeAttribute(const std::vector<uint32_t>& words, size_t index, AttributeEncoding encoding,
+                          const std::vector<glm::vec4>& palette) {
+    switch (encoding) {
+        case AttributeEncoding::Float: {
+            glm::vec4 color;
+            std::memcpy(&color, &words[index * 4], sizeof(glm::vec4));
+            return color;
+        }
+        case AttributeEncoding::RGBA8:
+            return unpackRGBA8(words[index]);
+        case AttributeEncoding::RGB565:
+            return unpackRGB565((words[index / 2] >> (16 * (index % 2))) & 0xffff);
+        case AttributeEncoding::Palette16:
+            return palette[(words[index / 2] >> (16 * (index % 2))) & 0xffff];
+        case AttributeEncoding::Palette8:
+            return palette[(words[index / 4] >> (8 * (index % 4))) & 0xff];
+    }
+    return glm::vec4(0.0f);
+}
+
+#endif
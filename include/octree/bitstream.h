@@ -0,0 +1,460 @@
+#ifndef BITSTREAM_H
+#define BITSTREAM_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <map>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// Binary range coder with adaptive bit probabilities, the LZMA scheme. Probabilities are
+// 11-bit and move 1/32 of the way towards each coded bit.
+class RangeEncoder {
+public:
+    static const int PROB_BITS = 11;
+    static const uint16_t PROB_INIT = 1 << (PROB_BITS - 1);
+
+    explicit RangeEncoder(std::vector<uint8_t>& out) : m_out(out) {}
+    void EncodeBit(uint16_t& prob, int bit);
+    void EncodeDirect(uint32_t value, int bits);
+    void EncodeTree(uint16_t* probs, uint32_t value, int bits);
+    void Flush();
+private:
+    void ShiftLow();
+
+    std::vector<uint8_t>& m_out;
+    uint64_t m_low = 0;
+    uint32_t m_range = 0xffffffffu;
+    uint8_t m_cache = 0;
+    uint64_t m_cacheSize = 1;
+};
+
+class RangeDecoder {
+public:
+    RangeDecoder(const uint8_t* data, size_t size);
+    int DecodeBit(uint16_t& prob);
+    uint32_t DecodeDirect(int bits);
+    uint32_t DecodeTree(uint16_t* probs, int bits);
+private:
+    uint8_t Next() { return (m_pos < m_size) ? m_data[m_pos++] : 0; }
+
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_pos = 0;
+    uint32_t m_code = 0;
+    uint32_t m_range = 0xffffffffu;
+};
+
+inline void RangeEncoder::EncodeBit(uint16_t& prob, int bit) {
+    uint32_t bound = (m_range >> PROB_BITS) * prob;
+    if (bit == 0) {
+        m_range = bound;
+        prob += ((1 << PROB_BITS) - prob) >> 5;
+    } else {
+        m_low += bound;
+        m_range -= bound;
+        prob -= prob >> 5;
+    }
+    while (m_range < (1u << 24)) {
+        m_range <<= 8;
+        ShiftLow();
+    }
+}
+
+// The low bits of value, highest first, each with probability 1/2.
+inline void RangeEncoder::EncodeDirect(uint32_t value, int bits) {
+    for (int bit = bits - 1; bit >= 0; bit--) {
+        m_range >>= 1;
+        if ((value >> bit) & 1) {
+            m_low += m_range;
+        }
+        while (m_range < (1u << 24)) {
+            m_range <<= 8;
+            ShiftLow();
+        }
+    }
+}
+
+// The low bits of value, highest first, each bit modeled on the bits above it. probs
+// holds 1 << bits probabilities.
+inline void RangeEncoder::EncodeTree(uint16_t* probs, uint32_t value, int bits) {
+    uint32_t node = 1;
+    for (int bit = bits - 1; bit >= 0; bit--) {
+        int b = (value >> bit) & 1;
+        EncodeBit(probs[node], b);
+        node = (node << 1) | b;
+    }
+}
+
+inline void RangeEncoder::Flush() {
+    for (int i = 0; i < 5; i++) {
+        ShiftLow();
+    }
+}
+
+// Writes the top byte of low once a carry can no longer reach it. A run of 0xff bytes is
+// held back in cacheSize, since a carry would turn all of them into 0x00.
+inline void RangeEncoder::ShiftLow() {
+    if (static_cast<uint32_t>(m_low) < 0xff000000u || (m_low >> 32) != 0) {
+        uint8_t carry = static_cast<uint8_t>(m_low >> 32);
+        uint8_t byte = m_cache;
+        do {
+            m_out.push_back(static_cast<uint8_t>(byte + carry));
+            byte = 0xff;
+        } while (--m_cacheSize != 0);
+        m_cache = static_cast<uint8_t>(m_low >> 24);
+    }
+    m_cacheSize++;
+    m_low = (m_low & 0x00ffffffu) << 8;
+}
+
+inline RangeDecoder::RangeDecoder(const uint8_t* data, size_t size) : m_data(data), m_size(size) {
+    for (int i = 0; i < 5; i++) {
+        m_code = (m_code << 8) | Next();
+    }
+}
+
+inline int RangeDecoder::DecodeBit(uint16_t& prob) {
+    uint32_t bound = (m_range >> RangeEncoder::PROB_BITS) * prob;
+    int bit;
+    if (m_code < bound) {
+        m_range = bound;
+        prob += ((1 << RangeEncoder::PROB_BITS) - prob) >> 5;
+        bit = 0;
+    } else {
+        m_code -= bound;
+        m_range -= bound;
+        prob -= prob >> 5;
+        bit = 1;
+    }
+    while (m_range < (1u << 24)) {
+        m_range <<= 8;
+        m_code = (m_code << 8) | Next();
+    }
+    return bit;
+}
+
+inline uint32_t RangeDecoder::DecodeDirect(int bits) {
+    uint32_t value = 0;
+    for (int i = 0; i < bits; i++) {
+        m_range >>= 1;
+        uint32_t bit = (m_code >= m_range) ? 1 : 0;
+        m_code -= m_range & (0u - bit);
+        value = (value << 1) | bit;
+        while (m_range < (1u << 24)) {
+            m_range <<= 8;
+            m_code = (m_code << 8) | Next();
+        }
+    }
+    return value;
+}
+
+inline uint32_t RangeDecoder::DecodeTree(uint16_t* probs, int bits) {
+    uint32_t node = 1;
+    for (int i = 0; i < bits; i++) {
+        node = (node << 1) | static_cast<uint32_t>(DecodeBit(probs[node]));
+    }
+    return node - (1u << bits);
+}
+
+// Adaptive model for a stream of palette indices. Each index is either a repeat of the
+// one before (one bit, modeled on whether the previous index was a repeat too) or coded
+// in full: its top TREE_BITS bits through a bit tree, any bits below that directly.
+struct ColorIndexModel {
+    static const int TREE_BITS = 12;
+
+    int indexBits;
+    int treeBits;
+    uint16_t repeat[2] = {RangeEncoder::PROB_INIT, RangeEncoder::PROB_INIT};
+    std::vector<uint16_t> tree;
+    uint32_t previous = 0;
+    int previousRepeat = 0;
+
+    explicit ColorIndexModel(size_t paletteSize) {
+        indexBits = 0;
+        while ((size_t(1) << indexBits) < paletteSize) {
+            indexBits++;
+        }
+        treeBits = std::min(indexBits, TREE_BITS);
+        tree.assign(size_t(1) << treeBits, uint16_t(RangeEncoder::PROB_INIT));
+    }
+};
+
+// Pointerless, breadth-first form of an octree for storage and transfer. Nodes are in
+// breadth-first order with children in slot order, so the tree is fully described by one
+// child mask byte per node above maxDepth: nodes at maxDepth are always leaves and need
+// none, and a mask of 0 above maxDepth marks a coarse leaf. An empty tree has nodeCount 0.
+//
+// Colors are a separate stream: the distinct colors go raw into palette and the palette
+// index of every node (or every leaf, see filtered) is range coded in node order. With
+// filtered set the tree was kept filtered (see FilterColors), interior colors are left
+// out and recomputed on decode.
+//
+// Write and Read convert to and from the byte form for archives and the network: a fixed
+// little-endian header (OctreeBitstreamHeader) followed by the masks, the palette as
+// little-endian floats and the range coded colors, so a stream reads back the same on any
+// machine. Read checks the header and every count against the bytes given.
+struct OctreeBitstream {
+    int size = 0;
+    int maxDepth = 0;
+    uint64_t nodeCount = 0;
+    bool filtered = false;
+    bool coverageAlpha = false;
+    std::vector<uint8_t> masks;
+    std::vector<glm::vec4> palette;
+    uint64_t colorCount = 0;
+    std::vector<uint8_t> colors;
+
+    size_t Bytes() const { return masks.size() + palette.size() * sizeof(glm::vec4) + colors.size(); }
+    bool Validate() const;
+    std::vector<uint8_t> Write() const;
+    bool Read(const uint8_t* data, size_t bytes);
+    bool Save(const std::string& path) const;
+    bool Load(const std::string& path);
+};
+
+// Fields of the byte form, in order, each little-endian.
+struct OctreeBitstreamHeader {
+    char magic[8];          // OCTREE_BITSTREAM_MAGIC
+    uint32_t version;       // OCTREE_BITSTREAM_VERSION
+    int32_t size;
+    int32_t maxDepth;
+    uint32_t flags;         // OCTREE_BITSTREAM_FILTERED, OCTREE_BITSTREAM_COVERAGE_ALPHA
+    uint64_t nodeCount;
+    uint64_t maskBytes;
+    uint64_t paletteColors;
+    uint64_t colorCount;
+    uint64_t colorBytes;
+};
+
+const char OCTREE_BITSTREAM_MAGIC[8] = {'V', 'O', 'X', 'B', 'I', 'T', 'S', 'T'};
+const uint32_t OCTREE_BITSTREAM_VERSION = 1;
+const uint32_t OCTREE_BITSTREAM_FILTERED = 1;
+const uint32_t OCTREE_BITSTREAM_COVERAGE_ALPHA = 2;
+const size_t OCTREE_BITSTREAM_HEADER_BYTES = 8 + 4 * 4 + 5 * 8;
+const int OCTREE_BITSTREAM_MAX_DEPTH = 21; // SparseVoxelOctree::MAX_DEPTH
+
+// Whether the masks describe exactly nodeCount nodes and there is one color for each node,
+// or each leaf when filtered, with a palette to index. Decoding relies on all of it.
+inline bool OctreeBitstream::Validate() const {
+    if (size <= 0 || maxDepth < 0 || maxDepth > OCTREE_BITSTREAM_MAX_DEPTH) {
+        return false;
+    }
+    if (nodeCount == 0) {
+        return masks.empty() && colorCount == 0;
+    }
+    // Walk the levels: every node above maxDepth has a mask, a mask of 0 is a leaf, and
+    // nodes at maxDepth are leaves.
+    uint64_t nodes = 1, leaves = 0, levelNodes = 1;
+    size_t mask = 0;
+    for (int depth = 0; depth < maxDepth && levelNodes > 0; depth++) {
+        uint64_t next = 0;
+        for (uint64_t i = 0; i < levelNodes; i++) {
+            if (mask >= masks.size()) {
+                return false;
+            }
+            int children = 0;
+            for (int bit = 0; bit < 8; bit++) {
+                children += (masks[mask] >> bit) & 1;
+            }
+            leaves += (children == 0) ? 1 : 0;
+            next += static_cast<uint64_t>(children);
+            mask++;
+        }
+        nodes += next;
+        levelNodes = next;
+    }
+    leaves += levelNodes;
+    if (mask != masks.size() || nodes != nodeCount || nodeCount > static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+        return false;
+    }
+    return colorCount == (filtered ? leaves : nodeCount) && !palette.empty() &&
+           palette.size() <= std::numeric_limits<uint32_t>::max();
+}
+
+// Little-endian field helpers for the byte form.
+inline void putBitstreamWord(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+inline uint64_t getBitstreamWord(const uint8_t* data, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(data[i]) << (8 * i);
+    }
+    return value;
+}
+
+inline std::vector<uint8_t> OctreeBitstream::Write() const {
+    std::vector<uint8_t> out;
+    out.reserve(OCTREE_BITSTREAM_HEADER_BYTES + Bytes());
+    for (char c : OCTREE_BITSTREAM_MAGIC) {
+        out.push_back(static_cast<uint8_t>(c));
+    }
+    putBitstreamWord(out, OCTREE_BITSTREAM_VERSION, 4);
+    putBitstreamWord(out, static_cast<uint32_t>(size), 4);
+    putBitstreamWord(out, static_cast<uint32_t>(maxDepth), 4);
+    putBitstreamWord(out, (filtered ? OCTREE_BITSTREAM_FILTERED : 0) | (coverageAlpha ? OCTREE_BITSTREAM_COVERAGE_ALPHA : 0), 4);
+    putBitstreamWord(out, nodeCount, 8);
+    putBitstreamWord(out, masks.size(), 8);
+    putBitstreamWord(out, palette.size(), 8);
+    putBitstreamWord(out, colorCount, 8);
+    putBitstreamWord(out, colors.size(), 8);
+    out.insert(out.end(), masks.begin(), masks.end());
+    for (const glm::vec4& color : palette) {
+        for (int channel = 0; channel < 4; channel++) {
+            uint32_t bits;
+            std::memcpy(&bits, &color[channel], sizeof(bits));
+            putBitstreamWord(out, bits, 4);
+        }
+    }
+    out.insert(out.end(), colors.begin(), colors.end());
+    return out;
+}
+
+// Replaces this stream with the one in bytes. Returns false, leaving the stream empty, when
+// the bytes are not a bitstream of this version, are cut short or run on, or describe an
+// inconsistent tree.
+inline bool OctreeBitstream::Read(const uint8_t* data, size_t bytes) {
+    *this = OctreeBitstream();
+    if (bytes < OCTREE_BITSTREAM_HEADER_BYTES || std::memcmp(data, OCTREE_BITSTREAM_MAGIC, 8) != 0) {
+        std::cout << "Not an octree bitstream" << std::endl;
+        return false;
+    }
+    uint32_t version = static_cast<uint32_t>(getBitstreamWord(data + 8, 4));
+    if (version != OCTREE_BITSTREAM_VERSION) {
+        std::cout << "Octree bitstream version " << version << ", expected " << OCTREE_BITSTREAM_VERSION << std::endl;
+        return false;
+    }
+    uint32_t flags = static_cast<uint32_t>(getBitstreamWord(data + 20, 4));
+    uint64_t maskBytes = getBitstreamWord(data + 32, 8);
+    uint64_t paletteColors = getBitstreamWord(data + 40, 8);
+    uint64_t colorBytes = getBitstreamWord(data + 56, 8);
+    // Each count is checked against what is left before it is used, so sums cannot overflow.
+    uint64_t left = bytes - OCTREE_BITSTREAM_HEADER_BYTES;
+    bool fits = maskBytes <= left && paletteColors <= (left - maskBytes) / sizeof(glm::vec4) &&
+                colorBytes == left - maskBytes - paletteColors * sizeof(glm::vec4);
+    if (!fits) {
+        std::cout << "Octree bitstream sizes do not match its " << bytes << " bytes" << std::endl;
+        return false;
+    }
+
+    OctreeBitstream stream;
+    stream.size = static_cast<int32_t>(getBitstreamWord(data + 12, 4));
+    stream.maxDepth = static_cast<int32_t>(getBitstreamWord(data + 16, 4));
+    stream.filtered = (flags & OCTREE_BITSTREAM_FILTERED) != 0;
+    stream.coverageAlpha = (flags & OCTREE_BITSTREAM_COVERAGE_ALPHA) != 0;
+    stream.nodeCount = getBitstreamWord(data + 24, 8);
+    stream.colorCount = getBitstreamWord(data + 48, 8);
+    const uint8_t* cursor = data + OCTREE_BITSTREAM_HEADER_BYTES;
+    stream.masks.assign(cursor, cursor + maskBytes);
+    cursor += maskBytes;
+    stream.palette.resize(static_cast<size_t>(paletteColors));
+    for (glm::vec4& color : stream.palette) {
+        for (int channel = 0; channel < 4; channel++) {
+            uint32_t bits = static_cast<uint32_t>(getBitstreamWord(cursor, 4));
+            std::memcpy(&color[channel], &bits, sizeof(bits));
+            cursor += 4;
+        }
+    }
+    stream.colors.assign(cursor, cursor + colorBytes);
+    if (!stream.Validate()) {
+        std::cout << "Octree bitstream describes an inconsistent tree" << std::endl;
+        return false;
+    }
+    *this = std::move(stream);
+    return true;
+}
+
+inline bool OctreeBitstream::Save(const std::string& path) const {
+    std::vector<uint8_t> bytes = Write();
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    if (!file) {
+        std::cout << "Failed to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline bool OctreeBitstream::Load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        *this = OctreeBitstream();
+        return false;
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return Read(bytes.data(), bytes.size());
+}
+
+// Range codes colors into stream.colors and fills stream.palette with their distinct values
+// in order of first use. Colors are compared bit for bit, so decoding is exact.
+inline void encodeColorStream(const std::vector<glm::vec4>& colors, OctreeBitstream& stream) {
+    struct ColorLess {
+        bool operator()(const glm::vec4& a, const glm::vec4& b) const { return std::memcmp(&a, &b, sizeof(glm::vec4)) < 0; }
+    };
+    std::map<glm::vec4, uint32_t, ColorLess> lookup;
+    std::vector<uint32_t> indices(colors.size());
+    stream.palette.clear();
+    for (size_t i = 0; i < colors.size(); i++) {
+        auto found = lookup.find(colors[i]);
+        if (found == lookup.end()) {
+            found = lookup.insert({colors[i], static_cast<uint32_t>(stream.palette.size())}).first;
+            stream.palette.push_back(colors[i]);
+        }
+        indices[i] = found->second;
+    }
+
+    stream.colorCount = colors.size();
+    stream.colors.clear();
+    ColorIndexModel model(stream.palette.size());
+    RangeEncoder encoder(stream.colors);
+    for (uint32_t index : indices) {
+        int repeat = (index == model.previous) ? 1 : 0;
+        encoder.EncodeBit(model.repeat[model.previousRepeat], repeat);
+        if (!repeat) {
+            int lowBits = model.indexBits - model.treeBits;
+            encoder.EncodeTree(model.tree.data(), index >> lowBits, model.treeBits);
+            encoder.EncodeDirect(index, lowBits);
+        }
+        model.previous = index;
+        model.previousRepeat = repeat;
+    }
+    encoder.Flush();
+}
+
+// Calls write(i, index) with the palette index of each color of stream in order.
+template <typename Write>
+void decodeColorIndices(const OctreeBitstream& stream, Write write) {
+    ColorIndexModel model(stream.palette.size());
+    RangeDecoder decoder(stream.colors.data(), stream.colors.size());
+    int lowBits = model.indexBits - model.treeBits;
+    uint32_t last = static_cast<uint32_t>(stream.palette.size()) - 1;
+    for (uint64_t i = 0; i < stream.colorCount; i++) {
+        uint32_t index = model.previous;
+        int repeat = decoder.DecodeBit(model.repeat[model.previousRepeat]);
+        if (!repeat) {
+            index = decoder.DecodeTree(model.tree.data(), model.treeBits) << lowBits;
+            index |= decoder.DecodeDirect(lowBits);
+        }
+        model.previous = index;
+        model.previousRepeat = repeat;
+        write(i, std::min(index, last));
+    }
+}
+
+// Calls write(i, color) for each color of stream in order.
+template <typename Write>
+void decodeColorStream(const OctreeBitstream& stream, Write write) {
+    decodeColorIndices(stream, [&](uint64_t i, uint32_t index) { write(i, stream.palette[index]); });
+}
+
+#endif
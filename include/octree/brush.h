@@ -0,0 +1,92 @@
+#ifndef BRUSH_H
+#define BRUSH_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+
+enum class BrushShape {
+    Sphere,
+    Box,
+    Capsule
+};
+
+enum class BrushOp {
+    Union,      // fill every voxel inside with color
+    Subtract,   // empty every voxel inside
+    Paint       // recolor the filled voxels inside, leave empty ones alone
+};
+
+// A region edit in world units. Sphere: center a and radius. Box: corners a and b.
+// Capsule: the segment from a to b grown by radius.
+struct Brush {
+    BrushShape shape;
+    BrushOp op;
+    glm::vec3 a;
+    glm::vec3 b;
+    float radius;
+    glm::vec4 color;
+};
+
+// How a box relates to a brush, see classifyBrush.
+enum class BrushCoverage {
+    Outside,
+    Inside,
+    Intersecting
+};
+
+inline float segmentDistance(glm::vec3 p, glm::vec3 a, glm::vec3 b) {
+    glm::vec3 ab = b - a;
+    float lengthSquared = glm::dot(ab, ab);
+    float t = (lengthSquared > 0.0f) ? glm::clamp(glm::dot(p - a, ab) / lengthSquared, 0.0f, 1.0f) : 0.0f;
+    return glm::length(p - (a + t * ab));
+}
+
+inline bool brushContains(const Brush& brush, glm::vec3 p) {
+    switch (brush.shape) {
+        case BrushShape::Sphere:
+            return glm::length(p - brush.a) <= brush.radius;
+        case BrushShape::Box:
+            return glm::all(glm::greaterThanEqual(p, glm::min(brush.a, brush.b))) &&
+                   glm::all(glm::lessThanEqual(p, glm::max(brush.a, brush.b)));
+        case BrushShape::Capsule:
+            return segmentDistance(p, brush.a, brush.b) <= brush.radius;
+    }
+    return false;
+}
+
+// Conservative overlap test: false only when no point of [boxMin, boxMax] is inside.
+inline bool brushTouchesBox(const Brush& brush, glm::vec3 boxMin, glm::vec3 boxMax) {
+    switch (brush.shape) {
+        case BrushShape::Sphere:
+            return glm::length(glm::clamp(brush.a, boxMin, boxMax) - brush.a) <= brush.radius;
+        case BrushShape::Box:
+            return glm::all(glm::lessThanEqual(glm::min(brush.a, brush.b), boxMax)) &&
+                   glm::all(glm::greaterThanEqual(glm::max(brush.a, brush.b), boxMin));
+        case BrushShape::Capsule: {
+            glm::vec3 center = (boxMin + boxMax) * 0.5f;
+            return segmentDistance(center, brush.a, brush.b) <= brush.radius + glm::length(boxMax - center);
+        }
+    }
+    return false;
+}
+
+// Whether the voxels of a node spanning [boxMin, boxMax] are all inside the brush, all
+// outside it, or mixed. A node that is a single voxel is never mixed: it counts as inside
+// when its center is. All shapes are convex, so a box is inside when its corners are.
+inline BrushCoverage classifyBrush(const Brush& brush, glm::vec3 boxMin, glm::vec3 boxMax, bool singleVoxel) {
+    if (singleVoxel) {
+        return brushContains(brush, (boxMin + boxMax) * 0.5f) ? BrushCoverage::Inside : BrushCoverage::Outside;
+    }
+    if (!brushTouchesBox(brush, boxMin, boxMax)) {
+        return BrushCoverage::Outside;
+    }
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 p((corner & 4) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y, (corner & 1) ? boxMax.z : boxMin.z);
+        if (!brushContains(brush, p)) {
+            return BrushCoverage::Intersecting;
+        }
+    }
+    return BrushCoverage::Inside;
+}
+
+#endif
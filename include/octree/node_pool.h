@@ -0,0 +1,107 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <algorithm>
+
+// Node storage in fixed size chunks. Growing never moves existing nodes, so indices and
+// references stay valid for the life of the node, and freed slots are reused before new
+// ones are taken. Indices run from 0 to Size() - 1 with no gaps, so the pool can be
+// uploaded as one array, either chunk by chunk or through Export().
+template <typename Node>
+class NodePool {
+public:
+    static const int CHUNK_BITS = 14;
+    static const size_t CHUNK_NODES = size_t(1) << CHUNK_BITS;
+
+    int Allocate();
+    void Free(int index);
+    void Resize(size_t count);
+    void Clear();
+    void Assign(const Node* nodes, size_t count);
+    void Assign(const std::vector<Node>& nodes) { Assign(nodes.data(), nodes.size()); }
+    std::vector<Node> Export() const;
+
+    Node& operator[](size_t index) { return m_chunks[index >> CHUNK_BITS][index & (CHUNK_NODES - 1)]; }
+    const Node& operator[](size_t index) const { return m_chunks[index >> CHUNK_BITS][index & (CHUNK_NODES - 1)]; }
+    size_t Size() const { return m_size; }
+    size_t FreeCount() const { return m_free.size(); }
+    size_t ChunkCount() const { return (m_size + CHUNK_NODES - 1) / CHUNK_NODES; }
+    const Node* Chunk(size_t chunk) const { return m_chunks[chunk].get(); }
+    size_t ChunkNodes(size_t chunk) const { return std::min(CHUNK_NODES, m_size - chunk * CHUNK_NODES); }
+private:
+    std::vector<std::unique_ptr<Node[]>> m_chunks;
+    std::vector<int> m_free;
+    size_t m_size = 0;
+};
+
+// Index of a default-constructed node, from the free list when it has any.
+template <typename Node>
+int NodePool<Node>::Allocate() {
+    if (!m_free.empty()) {
+        int index = m_free.back();
+        m_free.pop_back();
+        (*this)[index] = Node();
+        return index;
+    }
+    Resize(m_size + 1);
+    return static_cast<int>(m_size - 1);
+}
+
+// Hands a slot back for reuse. Its node is reset but stays part of Size(), so nothing
+// after it moves; whatever pointed at it must be unlinked by the caller.
+template <typename Node>
+void NodePool<Node>::Free(int index) {
+    (*this)[index] = Node();
+    m_free.push_back(index);
+}
+
+// Grows or shrinks to count nodes. Slots past Size() are always default nodes, so growing
+// only has to add chunks. Shrinking forgets freed slots, since they may now be out of range.
+template <typename Node>
+void NodePool<Node>::Resize(size_t count) {
+    size_t chunks = (count + CHUNK_NODES - 1) / CHUNK_NODES;
+    if (count < m_size) {
+        for (size_t i = count; i < std::min(m_size, chunks * CHUNK_NODES); i++) {
+            (*this)[i] = Node();
+        }
+        m_chunks.resize(chunks);
+        m_free.clear();
+    }
+    while (m_chunks.size() < chunks) {
+        m_chunks.emplace_back(new Node[CHUNK_NODES]);
+    }
+    m_size = count;
+}
+
+template <typename Node>
+void NodePool<Node>::Clear() {
+    m_chunks.clear();
+    m_free.clear();
+    m_size = 0;
+}
+
+// Replaces the pool contents with nodes, keeping their indices.
+template <typename Node>
+void NodePool<Node>::Assign(const Node* nodes, size_t count) {
+    Clear();
+    Resize(count);
+    for (size_t chunk = 0; chunk < ChunkCount(); chunk++) {
+        std::copy(nodes + chunk * CHUNK_NODES, nodes + chunk * CHUNK_NODES + ChunkNodes(chunk), m_chunks[chunk].get());
+    }
+}
+
+// Contiguous copy of every node, freed slots included so indices stay valid.
+template <typename Node>
+std::vector<Node> NodePool<Node>::Export() const {
+    std::vector<Node> nodes;
+    nodes.reserve(m_size);
+    for (size_t chunk = 0; chunk < ChunkCount(); chunk++) {
+        nodes.insert(nodes.end(), Chunk(chunk), Chunk(chunk) + ChunkNodes(chunk));
+    }
+    return nodes;
+}
+
+#endif
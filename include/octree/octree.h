@@ -0,0 +1,1952 @@
+#ifndef OCTREE_H
+#define OCTREE_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <unordered_map>
+#include <functional>
+#include <parallel.h>
+#include <octree/attributes.h>
+#include <octree/node_pool.h>
+#include <octree/brush.h>
+#include <octree/bitstream.h>
+
+struct FlattenedNode {
+    bool IsLeaf = false;
+    char padding1[3] = {};  // Pad bool to 4 bytes
+    int childIndices[8] = {-1, -1, -1, -1, -1, -1, -1, -1};
+    float coverage = 0.0f;  // Filled fraction of the node's volume, set by FilterColors
+    char padding2[8] = {};  // Pad to align vec4 to 16 bytes after the array
+    glm::vec4 color = glm::vec4(1.0f); // default white
+};
+
+// ESVO-style 8 byte node. The children of a node are stored next to each other in slot
+// order starting at firstChild, so childMask alone says where each one lives. A child
+// whose bit is set in leafMask is a leaf. Colors live in a separate stream indexed like
+// the nodes. A node flagged BRICK has no child nodes; firstChild is then a brick index.
+struct CompactNode {
+    static const uint16_t BRICK = 1;
+
+    uint8_t childMask = 0;
+    uint8_t leafMask = 0;
+    uint16_t flags = 0;
+    uint32_t firstChild = 0;
+};
+
+// Compact tree plus optional leaf bricks. With brickSize B (4 or 8) every subtree rooted
+// log2(B) levels above the leaves is a dense B^3 brick: B^3 occupancy bits followed by
+// the offset of its first color, brickStride() words per brick. Voxel (x, y, z) of a brick
+// is bit (x * B + y) * B + z, and its color is brickColors[offset + set bits below it].
+// Both color streams are stored in the chosen AttributeEncoding; palette encodings share
+// one palette between them.
+struct CompactOctree {
+    std::vector<CompactNode> nodes;
+    AttributeEncoding encoding = AttributeEncoding::Float;
+    std::vector<uint32_t> colors;
+    std::vector<glm::vec4> palette;
+    int brickSize = 0;
+    std::vector<uint32_t> bricks;
+    std::vector<uint32_t> brickColors;
+
+    int brickStride() const { return brickSize * brickSize * brickSize / 32 + 1; }
+    glm::vec4 nodeColor(size_t index) const { return decodeAttribute(colors, index, encoding, palette); }
+    glm::vec4 brickColor(size_t index) const { return decodeAttribute(brickColors, index, encoding, palette); }
+};
+
+// Byte-wise hash and equality over whole nodes, for hash-consing subtrees. Both paddings
+// are zero-initialized, so equal nodes have equal bytes.
+struct FlattenedNodeHash {
+    size_t operator()(const FlattenedNode& node) const {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&node);
+        uint64_t hash = 1469598103934665603ULL; // FNV-1a
+        for (size_t i = 0; i < sizeof(FlattenedNode); i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+struct FlattenedNodeEqual {
+    bool operator()(const FlattenedNode& a, const FlattenedNode& b) const {
+        return std::memcmp(&a, &b, sizeof(FlattenedNode)) == 0;
+    }
+};
+
+enum class NodeLayout {
+    Flattened,
+    Compact
+};
+
+// One voxel handed to the bulk builder, in the same world units Insert takes.
+struct VoxelSample {
+    glm::ivec3 position;
+    glm::vec4 color;
+};
+
+// Columns of voxels standing on y = 0, for BuildFromHeightfield. Column (x, z) sits at
+// world (x * cellSize, z * cellSize) and is filled with heights[x * columns + z] voxels
+// cellSize apart going up, each colored by its column, or by its layer when layerColors is
+// set. This is what generateTerrainVoxels produces, without listing every voxel.
+struct Heightfield {
+    int columns = 0;                    // along x and along z
+    int cellSize = 1;                   // world units between columns and between layers
+    std::vector<int> heights;
+    std::vector<glm::vec4> colors;      // per column, same indexing as heights
+    std::vector<glm::vec4> layerColors; // per layer from y = 0; the last one repeats above
+};
+
+// A signed density over a grid of cells, for BuildFromDensity. Cell (x, y, z) sits at world
+// (x, y, z) * cellSize and is filled where its density is above zero, colored by its layer
+// like Heightfield::layerColors (white when there are none). sample writes the densities of
+// the size cells from lo to densities[(x * size.y + y) * size.z + z]. bounds gives an
+// interval holding the density of every cell in [lo, hi); it may be as loose as it likes
+// but never wrong, since cells in a box it proves empty or solid are never sampled.
+struct DensityField {
+    int cellSize = 1;
+    std::vector<glm::vec4> layerColors;
+    std::function<void(glm::ivec3 lo, glm::ivec3 size, float* densities)> sample;
+    std::function<void(glm::ivec3 lo, glm::ivec3 hi, float& minDensity, float& maxDensity)> bounds;
+};
+
+// Half-open range of node indices, used to report which nodes an edit touched.
+struct NodeRange {
+    size_t begin;
+    size_t end;
+};
+
+// Sorts ranges and merges the ones that overlap or touch.
+inline std::vector<NodeRange> mergeNodeRanges(std::vector<NodeRange> ranges) {
+    std::sort(ranges.begin(), ranges.end(), [](const NodeRange& a, const NodeRange& b) {
+        return a.begin < b.begin;
+    });
+    std::vector<NodeRange> merged;
+    for (const NodeRange& range : ranges) {
+        if (!merged.empty() && range.begin <= merged.back().end) {
+            merged.back().end = std::max(merged.back().end, range.end);
+        } else {
+            merged.push_back(range);
+        }
+    }
+    return merged;
+}
+
+// A sample index tagged with its leaf key, the unit the bulk builder sorts.
+struct MortonVoxel {
+    uint64_t key;
+    int sample;
+};
+
+class SparseVoxelOctree {
+public:
+    static const int MAX_DEPTH = 21; // 3 bits per level must fit in a 64-bit key
+
+    SparseVoxelOctree(int size, int maxDepth);
+    void Insert(glm::vec3 point, glm::vec4 color);
+    void Set(glm::ivec3 point, glm::vec4 color);
+    bool Remove(glm::ivec3 point);
+    bool Get(glm::ivec3 point, glm::vec4& color) const;
+    void ApplyBrush(const Brush& brush);
+    size_t CollapseUniform(float tolerance = 0.0f);
+    void SetBuildCollapse(bool collapse, float tolerance = 0.0f);
+    size_t CollapseInterior();
+    void SetBuildShell(bool shell) { m_buildShell = shell; }
+    std::vector<NodeRange> TakeDirtyRanges();
+    void BuildFromVoxels(const std::vector<VoxelSample>& samples);
+    void BuildFromVoxelsParallel(const std::vector<VoxelSample>& samples, int threadCount, int splitDepth = 1);
+    void BuildFromHeightfield(const Heightfield& field);
+    void BuildFromDensity(const DensityField& field);
+    uint64_t MortonKey(glm::ivec3 point) const;
+    CompactOctree ToCompact(int brickSize = 0, AttributeEncoding encoding = AttributeEncoding::Float) const;
+    void FromCompact(const CompactOctree& compact);
+    void LoadNodes(const FlattenedNode* nodes, size_t count);
+    OctreeBitstream ToBitstream() const;
+    void FromBitstream(const OctreeBitstream& stream);
+    void CompressToDAG();
+    void FilterColors(bool coverageAlpha = false);
+    const NodePool<FlattenedNode>& Nodes() const { return m_nodes; }
+    std::vector<FlattenedNode> ExportNodes() const { return m_nodes.Export(); }
+    int Size() const { return m_size; }
+    int MaxDepth() const { return m_maxDepth; }
+private:
+    void FilterNode(int nodeIndex);
+    void SplitLeaf(int nodeIndex);
+    bool BrushNode(int nodeIndex, glm::ivec3 minCorner, glm::ivec3 maxCorner, int depth, const Brush& brush);
+    void FreeChildren(int nodeIndex);
+    void PaintSubtree(int nodeIndex, glm::vec4 color);
+    template <typename NodeArray>
+    bool TryCollapse(NodeArray& nodes, int nodeIndex, float tolerance) const;
+    size_t CollapseSubtree(int nodeIndex, int depth, int stopDepth, float tolerance);
+    void Repack();
+    bool ChildrenFollowParents() const;
+    bool HasSharedChildren() const;
+    bool RefuseSharedEdit(const char* edit) const;
+    struct NodeBox {
+        int index;
+        glm::ivec3 lo;
+        glm::ivec3 hi;
+    };
+    void CollapseInteriorNodes();
+    bool CollapseInteriorSubtree(NodeBox* path, int depth, size_t& freed);
+    bool BoxSolid(const NodeBox& box, int depth, glm::ivec3 queryLo, glm::ivec3 queryHi) const;
+    int ChildSlot(glm::ivec3 point, glm::ivec3& position, int depth) const;
+    void MarkDirty(size_t index);
+    void MarkAllDirty();
+    void GatherBrick(int nodeIndex, glm::ivec3 cell, int cellSize, int brickSize, glm::vec4* voxels, uint8_t* filled) const;
+    int SharedLevels(uint64_t a, uint64_t b) const;
+    template <typename NodeArray>
+    int EmitSubtree(const MortonVoxel* keys, size_t count, int baseDepth,
+                    const std::vector<VoxelSample>& samples, NodeArray& out) const;
+    void InsertImpl(int nodeIndex, glm::ivec3 point, glm::vec4 color, glm::ivec3 position, int depth);
+    struct CellSpan {
+        int begin;
+        int end;
+        bool complete;
+        int topLeafBegin;
+    };
+    std::vector<std::vector<CellSpan>> CellSpans(int cellSize, int cellCount) const;
+    struct HeightfieldLevels;
+    int EmitHeightfield(const Heightfield& field, const HeightfieldLevels& levels, int depth, int ix, int iy, int iz,
+                        int64_t& lastSample, glm::vec4& lastColor);
+    enum class DensityKnown { Nothing, Solid, Sampled };
+    struct DensityLevels;
+    int EmitDensity(const DensityField& field, DensityLevels& levels, int depth, int ix, int iy, int iz,
+                    DensityKnown known, int64_t& lastSample, glm::vec4& lastColor);
+    uint32_t AxisBits(int coord) const;
+    NodePool<FlattenedNode> m_nodes;    // root at index 0
+    int m_size;
+    int m_maxDepth;
+    std::vector<int> m_halfSizes;       // integer half extent of a node at each depth
+    std::vector<uint32_t> m_axisBits;   // AxisBits for every coordinate in [0, size)
+    bool m_filterColors = false;        // keep interior colors filtered, see FilterColors
+    bool m_coverageAlpha = false;
+    bool m_buildCollapse = false;       // bulk builds collapse uniform subtrees as they go
+    float m_collapseTolerance = 0.0f;
+    bool m_buildShell = false;          // bulk builds finish with CollapseInterior
+    bool m_shared = false;              // subtrees have several parents, see CompressToDAG
+    std::vector<NodeRange> m_dirty;     // nodes changed since the last TakeDirtyRanges
+};
+
+// Spreads the low 21 bits of v so there are two zero bits between each of them.
+inline uint64_t spreadBits3(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | (v << 32)) & 0x1f00000000ffffULL;
+    v = (v | (v << 16)) & 0x1f0000ff0000ffULL;
+    v = (v | (v << 8))  & 0x100f00f00f00f00fULL;
+    v = (v | (v << 4))  & 0x10c30c30c30c30c3ULL;
+    v = (v | (v << 2))  & 0x1249249249249249ULL;
+    return v;
+}
+
+// Stable LSD radix sort of keys[0..count) on the low keyBits bits of the key, 11 bits
+// per pass.
+inline void radixSortKeys(MortonVoxel* keys, size_t count, int keyBits) {
+    const int RADIX_BITS = 11;
+    const int BUCKETS = 1 << RADIX_BITS;
+    std::vector<MortonVoxel> scratch(count);
+    std::vector<size_t> counts(BUCKETS + 1);
+    MortonVoxel* from = keys;
+    MortonVoxel* to = scratch.data();
+    for (int shift = 0; shift < keyBits; shift += RADIX_BITS) {
+        std::fill(counts.begin(), counts.end(), 0);
+        for (size_t i = 0; i < count; i++) {
+            counts[((from[i].key >> shift) & (BUCKETS - 1)) + 1]++;
+        }
+        for (int i = 0; i < BUCKETS; i++) {
+            counts[i + 1] += counts[i];
+        }
+        for (size_t i = 0; i < count; i++) {
+            to[counts[(from[i].key >> shift) & (BUCKETS - 1)]++] = from[i];
+        }
+        std::swap(from, to);
+    }
+    if (from != keys) {
+        std::copy(from, from + count, keys);
+    }
+}
+
+// Empties a node array and refills it with count default nodes, for code that builds
+// either a plain vector or the octree's pool.
+inline void resetNodes(std::vector<FlattenedNode>& nodes, size_t count) {
+    nodes.clear();
+    nodes.resize(count);
+}
+
+inline void resetNodes(NodePool<FlattenedNode>& nodes, size_t count) {
+    nodes.Clear();
+    nodes.Resize(count);
+}
+
+inline void truncateNodes(std::vector<FlattenedNode>& nodes, size_t count) {
+    nodes.resize(count);
+}
+
+inline void truncateNodes(NodePool<FlattenedNode>& nodes, size_t count) {
+    nodes.Resize(count);
+}
+
+// Number of set bits in v.
+inline int popCount(uint64_t v) {
+    v = v - ((v >> 1) & 0x5555555555555555ULL);
+    v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+    v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return static_cast<int>((v * 0x0101010101010101ULL) >> 56);
+}
+
+// Color index of a voxel in a brick laid out as described on CompactOctree.
+inline int brickColorIndex(const uint32_t* brick, int brickSize, int voxel) {
+    int index = static_cast<int>(brick[brickSize * brickSize * brickSize / 32]);
+    for (int word = 0; word < voxel / 32; word++) {
+        index += popCount(brick[word]);
+    }
+    return index + popCount(brick[voxel / 32] & ((1u << (voxel % 32)) - 1u));
+}
+
+// Index of the highest set bit of a non-zero value.
+inline int highestBit(uint64_t v) {
+    int bit = 0;
+    for (int step = 32; step > 0; step >>= 1) {
+        if (v >> step) {
+            v >>= step;
+            bit += step;
+        }
+    }
+    return bit;
+}
+
+inline SparseVoxelOctree::SparseVoxelOctree(int size, int maxDepth)
+    : m_size(size), m_maxDepth(maxDepth) {
+    // Same truncation InsertImpl always used: size / 2^depth as float, then halved to int.
+    for (int depth = 0; depth < m_maxDepth; depth++) {
+        m_halfSizes.push_back(static_cast<int>(m_size / std::exp2(depth) / 2.0f));
+    }
+    m_axisBits.resize(m_size);
+    for (int coord = 0; coord < m_size; coord++) {
+        m_axisBits[coord] = AxisBits(coord);
+    }
+    m_nodes.Allocate(); // root node
+    MarkAllDirty();
+}
+
+inline void SparseVoxelOctree::Insert(glm::vec3 point, glm::vec4 color) {
+    if (RefuseSharedEdit("Insert")) {
+        return;
+    }
+    InsertImpl(0, glm::ivec3(point), color, glm::ivec3(0), 0);
+}
+
+inline void SparseVoxelOctree::InsertImpl(int nodeIndex, glm::ivec3 point, glm::vec4 color, glm::ivec3 position, int depth) {
+    if (nodeIndex >= static_cast<int>(m_nodes.Size())) {
+        std::cout << "Index out of bounds" << std::endl;
+        return;
+    }
+    FlattenedNode &node = m_nodes[nodeIndex];
+    if (node.IsLeaf && depth < m_maxDepth) {
+        SplitLeaf(nodeIndex); // a coarse leaf, keep the rest of its cube filled in its old color
+    }
+    node.color = color;
+    MarkDirty(nodeIndex);
+    if (depth == m_maxDepth) {
+        node.IsLeaf = true;
+        if (m_filterColors) {
+            FilterNode(nodeIndex);
+        }
+        return;
+    }
+    int half = m_halfSizes[depth];
+    glm::ivec3 center = position + glm::ivec3(half);
+    glm::ivec3 childPos = {
+        (point.x >= center.x) ? 1 : 0,
+        (point.y >= center.y) ? 1 : 0,
+        (point.z >= center.z) ? 1 : 0
+    };
+    int childIndex = (childPos.x << 2) | (childPos.y << 1) | (childPos.z);
+    int nextIndex = node.childIndices[childIndex];
+    if (nextIndex == -1) {
+        nextIndex = m_nodes.Allocate(); // pool nodes never move, node stays valid
+        node.childIndices[childIndex] = nextIndex;
+    }
+    glm::ivec3 newPosition = position + childPos * glm::ivec3(half);
+    InsertImpl(nextIndex, point, color, newPosition, depth + 1);
+    if (m_filterColors) {
+        FilterNode(nodeIndex);
+    }
+}
+
+// Same as Insert, for integer voxel coordinates.
+inline void SparseVoxelOctree::Set(glm::ivec3 point, glm::vec4 color) {
+    if (RefuseSharedEdit("Set")) {
+        return;
+    }
+    InsertImpl(0, point, color, glm::ivec3(0), 0);
+}
+
+// Color of the leaf holding point. Returns false when the voxel is empty. Like Insert,
+// points outside the octree land in the nearest edge cell.
+inline bool SparseVoxelOctree::Get(glm::ivec3 point, glm::vec4& color) const {
+    int nodeIndex = 0;
+    glm::ivec3 position(0);
+    for (int depth = 0; !m_nodes[nodeIndex].IsLeaf; depth++) {
+        if (depth == m_maxDepth) {
+            return false;
+        }
+        nodeIndex = m_nodes[nodeIndex].childIndices[ChildSlot(point, position, depth)];
+        if (nodeIndex == -1) {
+            return false;
+        }
+    }
+    color = m_nodes[nodeIndex].color;
+    return true;
+}
+
+// Empties the voxel at point. Parents left without children are removed as well, all the
+// way up to (but not including) the root, and their slots go back to the pool for reuse.
+// A coarse leaf is split first so the rest of its cube stays filled. Returns false when
+// the voxel was already empty.
+inline bool SparseVoxelOctree::Remove(glm::ivec3 point) {
+    if (RefuseSharedEdit("Remove")) {
+        return false;
+    }
+    int path[MAX_DEPTH + 1];
+    int slots[MAX_DEPTH + 1];
+    path[0] = 0;
+    glm::ivec3 position(0);
+    int depth = 0;
+    for (; depth < m_maxDepth; depth++) {
+        if (m_nodes[path[depth]].IsLeaf) {
+            SplitLeaf(path[depth]);
+        }
+        slots[depth] = ChildSlot(point, position, depth);
+        path[depth + 1] = m_nodes[path[depth]].childIndices[slots[depth]];
+        if (path[depth + 1] == -1) {
+            return false;
+        }
+    }
+    if (!m_nodes[path[depth]].IsLeaf) {
+        return false;
+    }
+
+    while (depth > 0) {
+        m_nodes.Free(path[depth]);
+        MarkDirty(path[depth]);
+        depth--;
+        FlattenedNode& parent = m_nodes[path[depth]];
+        parent.childIndices[slots[depth]] = -1;
+        MarkDirty(path[depth]);
+        bool empty = true;
+        for (int child : parent.childIndices) {
+            empty = empty && child == -1;
+        }
+        if (!empty) {
+            break;
+        }
+    }
+    if (m_filterColors) {
+        for (int d = depth; d >= 0; d--) {
+            FilterNode(path[d]);
+        }
+    }
+    return true;
+}
+
+// Turns a coarse leaf into an interior node with 8 leaf children of its color.
+inline void SparseVoxelOctree::SplitLeaf(int nodeIndex) {
+    m_nodes[nodeIndex].IsLeaf = false;
+    MarkDirty(nodeIndex);
+    for (int child = 0; child < 8; child++) {
+        int childIndex = m_nodes.Allocate();
+        FlattenedNode& leaf = m_nodes[childIndex];
+        leaf.IsLeaf = true;
+        leaf.color = m_nodes[nodeIndex].color;
+        leaf.coverage = 1.0f;
+        m_nodes[nodeIndex].childIndices[child] = childIndex;
+        MarkDirty(childIndex);
+    }
+}
+
+// Applies a region edit. Nodes are classified against the brush from the root down: nodes
+// outside it are skipped, nodes fully inside are filled, emptied or recolored in one step,
+// and only nodes on its boundary are descended into. A union fills covered nodes with a
+// single coarse leaf instead of their voxels. New nodes take freed slots like Set does, so
+// children may end up ahead of their parents; CompressToDAG and FilterColors repack then.
+inline void SparseVoxelOctree::ApplyBrush(const Brush& brush) {
+    if (RefuseSharedEdit("ApplyBrush")) {
+        return;
+    }
+    if (!BrushNode(0, glm::ivec3(0), glm::ivec3(m_size), 0, brush)) {
+        FreeChildren(0); // the root stays, as an empty interior node
+        m_nodes[0].IsLeaf = false;
+        m_nodes[0].coverage = 0.0f;
+        MarkDirty(0);
+    }
+}
+
+// Applies brush to the node spanning [minCorner, maxCorner). Nodes on the brush boundary
+// above the leaf level are split into their octants, creating missing ones for a union.
+// Returns whether the node still holds any voxel; an empty node is for the caller to free.
+inline bool SparseVoxelOctree::BrushNode(int nodeIndex, glm::ivec3 minCorner, glm::ivec3 maxCorner, int depth,
+                                  const Brush& brush) {
+    FlattenedNode& node = m_nodes[nodeIndex];
+    bool filled = node.IsLeaf;
+    for (int child : node.childIndices) {
+        filled = filled || child != -1;
+    }
+    BrushCoverage coverage = classifyBrush(brush, glm::vec3(minCorner), glm::vec3(maxCorner), depth == m_maxDepth);
+    if (coverage == BrushCoverage::Outside) {
+        return filled;
+    }
+    if (coverage == BrushCoverage::Inside) {
+        if (brush.op == BrushOp::Subtract) {
+            return false;
+        }
+        if (brush.op == BrushOp::Paint) {
+            if (filled) {
+                PaintSubtree(nodeIndex, brush.color);
+            }
+            return filled;
+        }
+        FreeChildren(nodeIndex);
+        node.IsLeaf = true;
+        node.color = brush.color;
+        node.coverage = 1.0f;
+        MarkDirty(nodeIndex);
+        return true;
+    }
+
+    if (node.IsLeaf) {
+        if (brush.op != BrushOp::Subtract && node.color == brush.color) {
+            return true; // already solid in the brush color
+        }
+        SplitLeaf(nodeIndex);
+    } else if (!filled && brush.op != BrushOp::Union) {
+        return false;
+    }
+    int half = m_halfSizes[depth];
+    bool anyFilled = false;
+    for (int child = 0; child < 8; child++) {
+        glm::ivec3 bit((child >> 2) & 1, (child >> 1) & 1, child & 1);
+        glm::ivec3 childMin = minCorner + bit * half;
+        glm::ivec3 childMax = glm::mix(minCorner + glm::ivec3(half), maxCorner, glm::bvec3(bit));
+        if (glm::any(glm::lessThanEqual(childMax, childMin))) {
+            continue; // truncated split planes can leave an octant with no cells
+        }
+        int childIndex = node.childIndices[child];
+        if (childIndex == -1) {
+            if (brush.op != BrushOp::Union ||
+                classifyBrush(brush, glm::vec3(childMin), glm::vec3(childMax), depth + 1 == m_maxDepth) == BrushCoverage::Outside) {
+                continue;
+            }
+            childIndex = m_nodes.Allocate();
+            node.childIndices[child] = childIndex;
+            MarkDirty(childIndex);
+        }
+        if (BrushNode(childIndex, childMin, childMax, depth + 1, brush)) {
+            anyFilled = true;
+        } else {
+            FreeChildren(childIndex);
+            m_nodes.Free(childIndex);
+            MarkDirty(childIndex);
+            node.childIndices[child] = -1;
+        }
+    }
+    if (brush.op != BrushOp::Subtract) {
+        node.color = brush.color; // newest edit wins, as with Insert
+    }
+    if (m_filterColors) {
+        FilterNode(nodeIndex);
+    }
+    MarkDirty(nodeIndex);
+    return anyFilled;
+}
+
+// Frees every node below nodeIndex and leaves it without children.
+inline void SparseVoxelOctree::FreeChildren(int nodeIndex) {
+    for (int& child : m_nodes[nodeIndex].childIndices) {
+        if (child != -1) {
+            FreeChildren(child);
+            m_nodes.Free(child);
+            MarkDirty(child);
+            child = -1;
+        }
+    }
+    MarkDirty(nodeIndex);
+}
+
+inline void SparseVoxelOctree::PaintSubtree(int nodeIndex, glm::vec4 color) {
+    FlattenedNode& node = m_nodes[nodeIndex];
+    node.color = color;
+    if (m_filterColors && m_coverageAlpha) {
+        node.color.a = node.coverage;
+    }
+    MarkDirty(nodeIndex);
+    for (int child : node.childIndices) {
+        if (child != -1) {
+            PaintSubtree(child, color);
+        }
+    }
+}
+
+// Turns every node whose 8 children are leaves with the same color (within tolerance per
+// channel) into a single leaf, bottom-up, so whole solid regions end up as one coarse leaf.
+// The nodes are then repacked in depth-first order. Returns how many nodes were removed.
+inline size_t SparseVoxelOctree::CollapseUniform(float tolerance) {
+    if (RefuseSharedEdit("CollapseUniform")) {
+        return 0;
+    }
+    size_t before = m_nodes.Size();
+    CollapseSubtree(0, 0, m_maxDepth, tolerance);
+    Repack();
+    if (m_filterColors) {
+        FilterColors(m_coverageAlpha);
+    }
+    MarkAllDirty();
+    return before - m_nodes.Size();
+}
+
+// Makes BuildFromVoxels and BuildFromVoxelsParallel collapse uniform subtrees while they
+// emit nodes, with the same result as calling CollapseUniform afterwards.
+inline void SparseVoxelOctree::SetBuildCollapse(bool collapse, float tolerance) {
+    m_buildCollapse = collapse;
+    m_collapseTolerance = tolerance;
+}
+
+// Merges the solid regions no ray from outside can reach into coarse leaves. A leaf is
+// buried when none of the 26 cells around it is empty or outside the octree, so only the
+// voxels next to air, edges and corners included, keep their own leaves; every node whose
+// 8 children are buried leaves becomes one buried leaf, bottom-up, and the nodes are then
+// repacked. The surface and so the rendered image are unchanged. A coarse leaf takes the
+// mean color of what it replaces, which is the color FilterColors gave that node, so level
+// of detail cutoffs see the same colors; carving into it later shows that color rather
+// than the original voxels. Returns how many nodes were removed.
+inline size_t SparseVoxelOctree::CollapseInterior() {
+    if (RefuseSharedEdit("CollapseInterior")) {
+        return 0;
+    }
+    size_t before = m_nodes.Size();
+    CollapseInteriorNodes();
+    if (m_filterColors) {
+        FilterColors(m_coverageAlpha);
+    }
+    MarkAllDirty();
+    return before - m_nodes.Size();
+}
+
+inline void SparseVoxelOctree::CollapseInteriorNodes() {
+    NodeBox path[MAX_DEPTH + 1];
+    path[0] = {0, glm::ivec3(0), glm::ivec3(m_size)};
+    size_t freed = 0;
+    CollapseInteriorSubtree(path, 0, freed);
+    if (freed > 0) {
+        Repack();
+    }
+}
+
+// Collapses the buried parts of the subtree at path[depth], the last entry of the path
+// from the root, and returns whether that node ended up a buried leaf. Merging buried
+// leaves leaves every cell as solid as it was, so later queries can read the tree as it
+// is being collapsed.
+inline bool SparseVoxelOctree::CollapseInteriorSubtree(NodeBox* path, int depth, size_t& freed) {
+    NodeBox box = path[depth];
+    FlattenedNode& node = m_nodes[box.index];
+    if (node.IsLeaf) {
+        // The leaf and the cells around it, in world units.
+        glm::ivec3 queryLo = box.lo - glm::ivec3(1);
+        glm::ivec3 queryHi = box.hi + glm::ivec3(1);
+        if (glm::any(glm::lessThan(queryLo, glm::ivec3(0))) || glm::any(glm::greaterThan(queryHi, glm::ivec3(m_size)))) {
+            return false;
+        }
+        int from = depth;
+        while (from > 0 && (glm::any(glm::lessThan(queryLo, path[from].lo)) || glm::any(glm::greaterThan(queryHi, path[from].hi)))) {
+            from--;
+        }
+        return BoxSolid(path[from], from, queryLo, queryHi);
+    }
+    if (depth == m_maxDepth) {
+        return false;
+    }
+    bool buried = true;
+    int half = m_halfSizes[depth];
+    for (int slot = 0; slot < 8; slot++) {
+        int child = node.childIndices[slot];
+        if (child == -1) {
+            buried = false;
+            continue;
+        }
+        glm::ivec3 bit((slot >> 2) & 1, (slot >> 1) & 1, slot & 1);
+        path[depth + 1] = {child, box.lo + bit * half, glm::mix(box.lo + glm::ivec3(half), box.hi, glm::bvec3(bit))};
+        buried = CollapseInteriorSubtree(path, depth + 1, freed) && buried;
+    }
+    if (!buried) {
+        return false;
+    }
+    int children[8];
+    std::copy(node.childIndices, node.childIndices + 8, children);
+    TryCollapse(m_nodes, box.index, std::numeric_limits<float>::infinity());
+    for (int child : children) {
+        m_nodes.Free(child);
+    }
+    freed += 8;
+    return true;
+}
+
+// Whether every cell of the node at depth that lies in [queryLo, queryHi) is filled.
+inline bool SparseVoxelOctree::BoxSolid(const NodeBox& box, int depth, glm::ivec3 queryLo, glm::ivec3 queryHi) const {
+    const FlattenedNode& node = m_nodes[box.index];
+    if (node.IsLeaf) {
+        return true;
+    }
+    if (depth == m_maxDepth) {
+        return false;
+    }
+    int half = m_halfSizes[depth];
+    for (int slot = 0; slot < 8; slot++) {
+        glm::ivec3 bit((slot >> 2) & 1, (slot >> 1) & 1, slot & 1);
+        NodeBox child = {node.childIndices[slot], box.lo + bit * half, glm::mix(box.lo + glm::ivec3(half), box.hi, glm::bvec3(bit))};
+        if (glm::any(glm::lessThanEqual(child.hi, child.lo))) {
+            continue; // truncated split planes can leave an octant with no cells
+        }
+        if (glm::any(glm::greaterThanEqual(child.lo, queryHi)) || glm::any(glm::lessThanEqual(child.hi, queryLo))) {
+            continue;
+        }
+        if (child.index == -1 || !BoxSolid(child, depth + 1, queryLo, queryHi)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Collapses below nodeIndex at depth, without descending to nodes at stopDepth or deeper.
+// Returns the number of nodes freed.
+inline size_t SparseVoxelOctree::CollapseSubtree(int nodeIndex, int depth, int stopDepth, float tolerance) {
+    FlattenedNode& node = m_nodes[nodeIndex];
+    if (node.IsLeaf) {
+        return 0;
+    }
+    size_t freed = 0;
+    if (depth + 1 < stopDepth) {
+        for (int child : node.childIndices) {
+            if (child != -1) {
+                freed += CollapseSubtree(child, depth + 1, stopDepth, tolerance);
+            }
+        }
+    }
+    int children[8];
+    std::copy(node.childIndices, node.childIndices + 8, children);
+    if (TryCollapse(m_nodes, nodeIndex, tolerance)) {
+        for (int child : children) {
+            m_nodes.Free(child);
+        }
+        freed += 8;
+    }
+    return freed;
+}
+
+// Makes the node a leaf when all 8 children are leaves and no channel differs by more than
+// tolerance from the first child. A node missing any child is never collapsed: the leaf
+// would cover the whole cube, empty octants included. The leaf takes the mean color. The
+// children are unlinked but left where they are.
+template <typename NodeArray>
+bool SparseVoxelOctree::TryCollapse(NodeArray& nodes, int nodeIndex, float tolerance) const {
+    FlattenedNode& node = nodes[nodeIndex];
+    glm::vec4 first = (node.childIndices[0] != -1) ? nodes[node.childIndices[0]].color : glm::vec4(0.0f);
+    glm::dvec4 sum(0.0);
+    for (int child : node.childIndices) {
+        if (child == -1 || !nodes[child].IsLeaf) {
+            return false;
+        }
+        glm::vec4 color = nodes[child].color;
+        if (glm::any(glm::greaterThan(glm::abs(color - first), glm::vec4(tolerance)))) {
+            return false;
+        }
+        sum += glm::dvec4(color);
+    }
+    node.IsLeaf = true;
+    node.color = glm::vec4(sum / 8.0);
+    std::fill(node.childIndices, node.childIndices + 8, -1);
+    return true;
+}
+
+// Rewrites the pool with only the nodes reachable from the root, in depth-first slot order
+// (the order the bulk builder emits), dropping freed slots.
+inline void SparseVoxelOctree::Repack() {
+    struct Pending {
+        int node;
+        int parent;
+        int slot;
+    };
+    std::vector<FlattenedNode> packed;
+    packed.reserve(m_nodes.Size() - m_nodes.FreeCount());
+    std::vector<Pending> stack(1, {0, -1, 0});
+    while (!stack.empty()) {
+        Pending pending = stack.back();
+        stack.pop_back();
+        int index = static_cast<int>(packed.size());
+        packed.push_back(m_nodes[pending.node]);
+        if (pending.parent != -1) {
+            packed[pending.parent].childIndices[pending.slot] = index;
+        }
+        for (int child = 7; child >= 0; child--) {
+            if (packed[index].childIndices[child] != -1) {
+                stack.push_back({packed[index].childIndices[child], index, child});
+            }
+        }
+    }
+    m_nodes.Assign(packed);
+    m_shared = false; // a shared subtree is copied once per parent
+    MarkAllDirty();
+}
+
+// Whether every child index is above its parent's, the order the passes from the back in
+// CompressToDAG and FilterColors rely on. Builders and Repack leave trees this way, while
+// edits that take freed slots can break it.
+inline bool SparseVoxelOctree::ChildrenFollowParents() const {
+    for (size_t i = 0; i < m_nodes.Size(); i++) {
+        for (int child : m_nodes[i].childIndices) {
+            if (child != -1 && static_cast<size_t>(child) <= i) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Whether some node is the child of more than one parent, as in a DAG.
+inline bool SparseVoxelOctree::HasSharedChildren() const {
+    std::vector<uint8_t> seen(m_nodes.Size(), 0);
+    for (size_t i = 0; i < m_nodes.Size(); i++) {
+        for (int child : m_nodes[i].childIndices) {
+            if (child == -1) {
+                continue;
+            }
+            if (seen[child]) {
+                return true;
+            }
+            seen[child] = 1;
+        }
+    }
+    return false;
+}
+
+// Edits write nodes in place, which on a DAG would change every parent sharing them.
+inline bool SparseVoxelOctree::RefuseSharedEdit(const char* edit) const {
+    if (m_shared) {
+        std::cout << edit << " refused: the octree is a DAG with shared subtrees, rebuild it before editing" << std::endl;
+    }
+    return m_shared;
+}
+
+// Child slot of the node at depth and position that holds point, moving position to that
+// child's corner. Uses the same split planes as InsertImpl.
+inline int SparseVoxelOctree::ChildSlot(glm::ivec3 point, glm::ivec3& position, int depth) const {
+    int half = m_halfSizes[depth];
+    glm::ivec3 center = position + glm::ivec3(half);
+    glm::ivec3 childPos = {
+        (point.x >= center.x) ? 1 : 0,
+        (point.y >= center.y) ? 1 : 0,
+        (point.z >= center.z) ? 1 : 0
+    };
+    position += childPos * glm::ivec3(half);
+    return (childPos.x << 2) | (childPos.y << 1) | childPos.z;
+}
+
+// Records that a node changed. Edits touch nodes in runs, so the index usually extends the
+// last range.
+inline void SparseVoxelOctree::MarkDirty(size_t index) {
+    if (!m_dirty.empty()) {
+        NodeRange& last = m_dirty.back();
+        if (index + 1 >= last.begin && index <= last.end) {
+            last.begin = std::min(last.begin, index);
+            last.end = std::max(last.end, index + 1);
+            return;
+        }
+    }
+    m_dirty.push_back({index, index + 1});
+}
+
+inline void SparseVoxelOctree::MarkAllDirty() {
+    m_dirty.assign(1, {0, m_nodes.Size()});
+}
+
+// Sorted, non-overlapping ranges of nodes changed since the last call, for uploading only
+// those parts of the node buffer. Nodes past the previous Size() always appear here.
+inline std::vector<NodeRange> SparseVoxelOctree::TakeDirtyRanges() {
+    std::vector<NodeRange> ranges = mergeNodeRanges(std::move(m_dirty));
+    m_dirty.clear();
+    return ranges;
+}
+
+// Split decisions along one axis from the root down, most significant bit first. The
+// axes never interact, so a cell's key is just the three axis codes interleaved.
+inline uint32_t SparseVoxelOctree::AxisBits(int coord) const {
+    uint32_t bits = 0;
+    int position = 0;
+    for (int depth = 0; depth < m_maxDepth; depth++) {
+        int half = m_halfSizes[depth];
+        int bit = (coord >= position + half) ? 1 : 0;
+        bits = (bits << 1) | bit;
+        position += bit * half;
+    }
+    return bits;
+}
+
+// Concatenated 3-bit child indices from the root down to the leaf cell holding point.
+// For power-of-two sizes this is the usual interleaved Morton code; for other sizes it
+// follows the same truncated split planes as InsertImpl so both paths agree on cells.
+inline uint64_t SparseVoxelOctree::MortonKey(glm::ivec3 point) const {
+    auto axis = [this](int coord) {
+        return (coord >= 0 && coord < m_size) ? m_axisBits[coord] : AxisBits(coord);
+    };
+    return (spreadBits3(axis(point.x)) << 2) | (spreadBits3(axis(point.y)) << 1) | spreadBits3(axis(point.z));
+}
+
+// Number of levels below the root two leaf keys have in common.
+inline int SparseVoxelOctree::SharedLevels(uint64_t a, uint64_t b) const {
+    uint64_t diff = a ^ b;
+    if (diff == 0) {
+        return m_maxDepth;
+    }
+    return m_maxDepth - 1 - highestBit(diff) / 3;
+}
+
+// Replaces the tree with one built from samples in a single pass over the Morton-sorted
+// input. Nodes are laid out in Morton (depth-first) order with the root at index 0.
+// Colors are resolved bottom-up as each subtree closes and match what calling Insert on
+// the samples in order would produce: every node keeps the color of the last sample
+// that landed inside it.
+inline void SparseVoxelOctree::BuildFromVoxels(const std::vector<VoxelSample>& samples) {
+    if (m_maxDepth > MAX_DEPTH) {
+        std::cout << "maxDepth too large for bulk build" << std::endl;
+        return;
+    }
+
+    std::vector<MortonVoxel> keys;
+    keys.reserve(samples.size());
+    for (int i = 0; i < static_cast<int>(samples.size()); i++) {
+        keys.push_back({MortonKey(samples[i].position), i});
+    }
+    // Stable so duplicate cells keep insertion order and the last sample wins.
+    radixSortKeys(keys.data(), keys.size(), 3 * m_maxDepth);
+    EmitSubtree(keys.data(), keys.size(), 0, samples, m_nodes);
+    m_shared = false;
+    if (m_buildShell) {
+        CollapseInteriorNodes();
+    }
+    MarkAllDirty();
+    if (m_filterColors) {
+        FilterColors(m_coverageAlpha);
+    }
+}
+
+// Builds the subtree at baseDepth holding the sorted keys[0..count) into out, with the
+// subtree root at out[0] and the rest in Morton order. Every key must share the same
+// first baseDepth levels. Returns the newest sample inside the subtree (-1 when empty).
+template <typename NodeArray>
+int SparseVoxelOctree::EmitSubtree(const MortonVoxel* keys, size_t count, int baseDepth,
+                                   const std::vector<VoxelSample>& samples, NodeArray& out) const {
+    if (count == 0) {
+        resetNodes(out, 1);
+        return -1;
+    }
+
+    // Every new key opens one node per level below the prefix it shares with the previous
+    // key, so the exact node count is known before anything is written.
+    size_t nodeCount = 1 + m_maxDepth - baseDepth;
+    for (size_t k = 1; k < count; k++) {
+        nodeCount += m_maxDepth - SharedLevels(keys[k - 1].key, keys[k].key);
+    }
+    resetNodes(out, nodeCount);
+    int nextIndex = 1;
+
+    // path[d] is the open node at depth d, lastSample[d] the newest sample inside it and
+    // levelColor[d] that sample's color, handed up to the parent as each level closes.
+    // Leaf colors are kept in levelColor[maxDepth] as samples arrive. When collapsing, a
+    // closed node whose children are uniform leaves becomes a leaf itself; its children
+    // are the last nodes written, so dropping them is just moving nextIndex back.
+    int path[MAX_DEPTH + 1];
+    int lastSample[MAX_DEPTH + 1];
+    glm::vec4 levelColor[MAX_DEPTH + 1];
+    path[baseDepth] = 0;
+    lastSample[baseDepth] = -1;
+    bool collapse = m_buildCollapse;
+
+    auto closeLevels = [&](int fromDepth) {
+        for (int d = m_maxDepth; d > fromDepth; d--) {
+            out[path[d]].color = levelColor[d];
+            if (collapse && d < m_maxDepth && TryCollapse(out, path[d], m_collapseTolerance)) {
+                nextIndex = path[d] + 1;
+            }
+            if (lastSample[d] > lastSample[d - 1]) {
+                lastSample[d - 1] = lastSample[d];
+                levelColor[d - 1] = levelColor[d];
+            }
+        }
+    };
+
+    for (size_t k = 0; k < count; k++) {
+        uint64_t key = keys[k].key;
+        int sample = keys[k].sample;
+
+        int shared = baseDepth;
+        if (k > 0) {
+            shared = SharedLevels(keys[k - 1].key, key);
+            if (shared == m_maxDepth) {
+                lastSample[m_maxDepth] = sample; // same cell, later sample wins
+                levelColor[m_maxDepth] = samples[sample].color;
+                continue;
+            }
+            closeLevels(shared);
+        }
+
+        for (int d = shared; d < m_maxDepth; d++) {
+            int child = static_cast<int>((key >> (3 * (m_maxDepth - 1 - d))) & 7);
+            int index = nextIndex++;
+            out[path[d]].childIndices[child] = index;
+            path[d + 1] = index;
+            lastSample[d + 1] = -1;
+            if (collapse) {
+                out[index] = FlattenedNode(); // may be a slot freed by a collapse
+            }
+        }
+        out[path[m_maxDepth]].IsLeaf = true;
+        lastSample[m_maxDepth] = sample;
+        levelColor[m_maxDepth] = samples[sample].color;
+    }
+    closeLevels(baseDepth);
+    out[0].color = levelColor[baseDepth];
+    if (collapse) {
+        if (baseDepth < m_maxDepth && TryCollapse(out, 0, m_collapseTolerance)) {
+            nextIndex = 1;
+        }
+        truncateNodes(out, nextIndex);
+    }
+    return lastSample[baseDepth];
+}
+
+// Same result as BuildFromVoxels, byte for byte, but the subtrees at splitDepth (8 of them
+// at depth 1, 64 at depth 2) are sorted and built on threadCount workers into their own
+// node arrays. The few nodes above splitDepth are then laid out in the order the serial
+// build would have produced them and every subtree is copied in behind its root with its
+// child indices shifted by where it landed.
+inline void SparseVoxelOctree::BuildFromVoxelsParallel(const std::vector<VoxelSample>& samples, int threadCount, int splitDepth) {
+    if (m_maxDepth > MAX_DEPTH) {
+        std::cout << "maxDepth too large for bulk build" << std::endl;
+        return;
+    }
+    splitDepth = std::min(splitDepth, m_maxDepth - 1);
+    if (threadCount <= 1 || splitDepth < 1 || samples.empty()) {
+        BuildFromVoxels(samples);
+        return;
+    }
+
+    // Keys are computed and partitioned by subtree over contiguous slices of the input.
+    // Each slice scatters into its own window of every bucket, which keeps the partition
+    // stable so duplicate cells still resolve to the last sample.
+    size_t sampleCount = samples.size();
+    int sliceCount = threadCount;
+    int bucketCount = 1 << (3 * splitDepth);
+    int bucketShift = 3 * (m_maxDepth - splitDepth);
+    std::vector<MortonVoxel> unsorted(sampleCount);
+    std::vector<size_t> offsets(static_cast<size_t>(sliceCount) * bucketCount, 0);
+    parallelFor(sliceCount, threadCount, [&](int slice) {
+        size_t begin = sampleCount * slice / sliceCount;
+        size_t end = sampleCount * (slice + 1) / sliceCount;
+        size_t* histogram = &offsets[static_cast<size_t>(slice) * bucketCount];
+        for (size_t i = begin; i < end; i++) {
+            unsorted[i] = {MortonKey(samples[i].position), static_cast<int>(i)};
+            histogram[unsorted[i].key >> bucketShift]++;
+        }
+    });
+
+    std::vector<size_t> bucketStart(bucketCount + 1, 0);
+    size_t running = 0;
+    for (int bucket = 0; bucket < bucketCount; bucket++) {
+        bucketStart[bucket] = running;
+        for (int slice = 0; slice < sliceCount; slice++) {
+            size_t& offset = offsets[static_cast<size_t>(slice) * bucketCount + bucket];
+            size_t sliceTotal = offset;
+            offset = running;
+            running += sliceTotal;
+        }
+    }
+    bucketStart[bucketCount] = running;
+
+    std::vector<MortonVoxel> keys(sampleCount);
+    parallelFor(sliceCount, threadCount, [&](int slice) {
+        size_t begin = sampleCount * slice / sliceCount;
+        size_t end = sampleCount * (slice + 1) / sliceCount;
+        size_t* offset = &offsets[static_cast<size_t>(slice) * bucketCount];
+        for (size_t i = begin; i < end; i++) {
+            keys[offset[unsorted[i].key >> bucketShift]++] = unsorted[i];
+        }
+    });
+    std::vector<MortonVoxel>().swap(unsorted);
+
+    std::vector<std::vector<FlattenedNode>> blocks(bucketCount);
+    std::vector<int> blockSample(bucketCount, -1);
+    parallelFor(bucketCount, threadCount, [&](int bucket) {
+        size_t count = bucketStart[bucket + 1] - bucketStart[bucket];
+        if (count == 0) {
+            return;
+        }
+        MortonVoxel* bucketKeys = keys.data() + bucketStart[bucket];
+        radixSortKeys(bucketKeys, count, bucketShift);
+        blockSample[bucket] = EmitSubtree(bucketKeys, count, splitDepth, samples, blocks[bucket]);
+    });
+
+    // Lay out the nodes above splitDepth exactly as EmitSubtree would, treating each
+    // non-empty bucket as a leaf whose subtree follows it. top holds those nodes and
+    // topIndex their final position; blockBase is where each subtree starts.
+    std::vector<FlattenedNode> top(1);
+    std::vector<int> topIndex(1, 0);
+    std::vector<int> blockBase(bucketCount, -1);
+    int nextIndex = 1;
+
+    int path[MAX_DEPTH + 1];
+    int lastSample[MAX_DEPTH + 1];
+    glm::vec4 levelColor[MAX_DEPTH + 1];
+    path[0] = 0;
+    lastSample[0] = -1;
+
+    auto closeLevels = [&](int fromDepth) {
+        for (int d = splitDepth; d > fromDepth; d--) {
+            if (d < splitDepth) {
+                top[path[d]].color = levelColor[d];
+            }
+            if (lastSample[d] > lastSample[d - 1]) {
+                lastSample[d - 1] = lastSample[d];
+                levelColor[d - 1] = levelColor[d];
+            }
+        }
+    };
+
+    int prevBucket = -1;
+    for (int bucket = 0; bucket < bucketCount; bucket++) {
+        if (blocks[bucket].empty()) {
+            continue;
+        }
+        int shared = 0;
+        if (prevBucket >= 0) {
+            shared = splitDepth - 1 - highestBit(static_cast<uint64_t>(prevBucket ^ bucket)) / 3;
+            closeLevels(shared);
+        }
+        for (int d = shared; d < splitDepth; d++) {
+            int child = (bucket >> (3 * (splitDepth - 1 - d))) & 7;
+            top[path[d]].childIndices[child] = nextIndex;
+            if (d + 1 < splitDepth) {
+                path[d + 1] = static_cast<int>(top.size());
+                top.emplace_back();
+                topIndex.push_back(nextIndex++);
+            } else {
+                blockBase[bucket] = nextIndex;
+                nextIndex += static_cast<int>(blocks[bucket].size());
+            }
+            lastSample[d + 1] = -1;
+        }
+        lastSample[splitDepth] = blockSample[bucket];
+        levelColor[splitDepth] = blocks[bucket][0].color;
+        prevBucket = bucket;
+    }
+    closeLevels(0);
+    top[0].color = levelColor[0];
+
+    m_nodes.Clear();
+    m_shared = false;
+    m_nodes.Resize(nextIndex);
+    for (size_t i = 0; i < top.size(); i++) {
+        m_nodes[topIndex[i]] = top[i];
+    }
+    parallelFor(bucketCount, threadCount, [&](int bucket) {
+        int base = blockBase[bucket];
+        if (base < 0) {
+            return;
+        }
+        for (size_t i = 0; i < blocks[bucket].size(); i++) {
+            FlattenedNode& dst = m_nodes[base + i];
+            dst = blocks[bucket][i];
+            for (int& child : dst.childIndices) {
+                if (child != -1) {
+                    child += base;
+                }
+            }
+        }
+        std::vector<FlattenedNode>().swap(blocks[bucket]);
+    });
+    // The subtrees collapsed themselves; the nodes above them still may, and repacking
+    // then gives the layout the serial build would have produced.
+    if (m_buildCollapse && CollapseSubtree(0, 0, splitDepth, m_collapseTolerance) > 0) {
+        Repack();
+    }
+    if (m_buildShell) {
+        CollapseInteriorNodes();
+    }
+    MarkAllDirty();
+    if (m_filterColors) {
+        FilterColors(m_coverageAlpha);
+    }
+}
+
+// The cells of size cellSize along one axis that each node holds, per depth, following the
+// octree's split planes. A node at depth d is addressed by its path along the axis, an
+// index in [0, 2^d), and spans the cells [begin, end) starting inside it, clipped to
+// cellCount. It is complete when every leaf below it holds at least one cell, and
+// topLeafBegin is the first cell of its highest leaf. Spans are worked out top-down, then
+// completeness bottom-up.
+inline std::vector<std::vector<SparseVoxelOctree::CellSpan>> SparseVoxelOctree::CellSpans(int cellSize, int cellCount) const {
+    std::vector<std::vector<CellSpan>> spans(m_maxDepth + 1);
+    std::vector<int> starts(1, 0), ends(1, m_size);
+    for (int depth = 0; depth <= m_maxDepth; depth++) {
+        std::vector<CellSpan>& level = spans[depth];
+        level.resize(starts.size());
+        for (size_t i = 0; i < starts.size(); i++) {
+            level[i].begin = std::min(cellCount, (starts[i] + cellSize - 1) / cellSize);
+            level[i].end = std::min(cellCount, (ends[i] + cellSize - 1) / cellSize);
+        }
+        if (depth == m_maxDepth) {
+            break;
+        }
+        std::vector<int> childStarts, childEnds;
+        for (size_t i = 0; i < starts.size(); i++) {
+            int split = starts[i] + m_halfSizes[depth];
+            childStarts.push_back(starts[i]);
+            childEnds.push_back(split);
+            childStarts.push_back(split);
+            childEnds.push_back(ends[i]);
+        }
+        starts.swap(childStarts);
+        ends.swap(childEnds);
+    }
+    for (int depth = m_maxDepth; depth >= 0; depth--) {
+        for (size_t i = 0; i < spans[depth].size(); i++) {
+            CellSpan& span = spans[depth][i];
+            if (depth == m_maxDepth) {
+                span.complete = span.begin < span.end;
+                span.topLeafBegin = span.begin;
+                continue;
+            }
+            const CellSpan& high = spans[depth + 1][2 * i + 1];
+            span.complete = spans[depth + 1][2 * i].complete && high.complete;
+            span.topLeafBegin = high.topLeafBegin;
+        }
+    }
+    return spans;
+}
+
+// Footprints of the nodes of one octree over a heightfield, per depth, with their
+// CellSpans: columns along x and z, layers along y. Nodes at the same depth and x, z
+// path share a footprint, kept in a 2^d x 2^d grid with the highest column height and the
+// lowest leaf height (a leaf holding several columns is as high as the highest of them),
+// so a node is empty, full or mixed in constant time. uniformColumn is a column whose
+// color every column of the footprint has, -1 when they differ; layerRunEnd[l] is the
+// last layer with the color of layer l.
+struct SparseVoxelOctree::HeightfieldLevels {
+    struct Footprint {
+        int leafHeight;
+        int maxHeight;
+        int uniformColumn;
+    };
+    int layerCount;
+    std::vector<int> layerRunEnd;
+    std::vector<std::vector<CellSpan>> columnSpans;     // [depth][path] along x or z
+    std::vector<std::vector<CellSpan>> layerSpans;      // [depth][path] along y
+    std::vector<std::vector<Footprint>> footprints; // [depth][xPath * 2^depth + zPath]
+};
+
+// Replaces the tree with the voxels of field. The tree is built top-down: a node is
+// dropped when no column in its footprint reaches its lowest layer, made a coarse leaf
+// when every leaf below it would be filled with one color, and split otherwise, so
+// nothing below the surface is visited voxel by voxel. Leaves and interior colors are
+// those BuildFromVoxels gives for generateTerrainVoxels-style column input (x, then z,
+// then y), and the layout is the one CollapseUniform repacks to. When every leaf holds at
+// most one column and one layer (a power of two size) the result matches BuildFromVoxels
+// followed by CollapseUniform() byte for byte; otherwise a few uniform nodes whose leaves
+// share cells of different colors may stay split, with the same voxels. Layers above the
+// octree are clipped rather than pushed into the top cells.
+inline void SparseVoxelOctree::BuildFromHeightfield(const Heightfield& field) {
+    const int cellSize = std::max(1, field.cellSize);
+    HeightfieldLevels levels;
+    levels.layerCount = (m_size + cellSize - 1) / cellSize;
+    bool byLayer = !field.layerColors.empty();
+    auto layerColor = [&](int layer) {
+        return field.layerColors[std::min(layer, static_cast<int>(field.layerColors.size()) - 1)];
+    };
+
+    levels.columnSpans = CellSpans(cellSize, field.columns);
+    levels.layerSpans = CellSpans(cellSize, levels.layerCount);
+    levels.layerRunEnd.resize(levels.layerCount);
+    for (int layer = levels.layerCount - 1; layer >= 0; layer--) {
+        bool sameAsNext = byLayer && layer + 1 < levels.layerCount && layerColor(layer) == layerColor(layer + 1);
+        levels.layerRunEnd[layer] = sameAsNext ? levels.layerRunEnd[layer + 1] : layer;
+    }
+
+    // Column heights per footprint, from the leaves up.
+    levels.footprints.assign(m_maxDepth + 1, {});
+    const std::vector<CellSpan>& leafSpans = levels.columnSpans[m_maxDepth];
+    int leafCount = 1 << m_maxDepth;
+    std::vector<HeightfieldLevels::Footprint>& leaves = levels.footprints[m_maxDepth];
+    leaves.resize(static_cast<size_t>(leafCount) * leafCount);
+    for (int ix = 0; ix < leafCount; ix++) {
+        for (int iz = 0; iz < leafCount; iz++) {
+            const CellSpan& xs = leafSpans[ix];
+            const CellSpan& zs = leafSpans[iz];
+            HeightfieldLevels::Footprint footprint = {0, 0, -1};
+            bool uniform = !byLayer && xs.complete && zs.complete;
+            for (int x = xs.begin; x < xs.end; x++) {
+                for (int z = zs.begin; z < zs.end; z++) {
+                    int column = x * field.columns + z;
+                    footprint.maxHeight = std::max(footprint.maxHeight, field.heights[column]);
+                    uniform = uniform && field.colors[column] == field.colors[xs.begin * field.columns + zs.begin];
+                }
+            }
+            footprint.leafHeight = footprint.maxHeight;
+            footprint.uniformColumn = uniform ? xs.begin * field.columns + zs.begin : -1;
+            leaves[static_cast<size_t>(ix) * leafCount + iz] = footprint;
+        }
+    }
+    for (int depth = m_maxDepth - 1; depth >= 0; depth--) {
+        int count = 1 << depth;
+        std::vector<HeightfieldLevels::Footprint>& level = levels.footprints[depth];
+        const std::vector<HeightfieldLevels::Footprint>& below = levels.footprints[depth + 1];
+        level.resize(static_cast<size_t>(count) * count);
+        for (int ix = 0; ix < count; ix++) {
+            for (int iz = 0; iz < count; iz++) {
+                HeightfieldLevels::Footprint footprint = {std::numeric_limits<int>::max(), 0, -1};
+                bool uniform = !byLayer;
+                int column = -1;
+                for (int child = 0; child < 4; child++) {
+                    const HeightfieldLevels::Footprint& part =
+                        below[static_cast<size_t>(2 * ix + (child >> 1)) * (2 * count) + 2 * iz + (child & 1)];
+                    footprint.leafHeight = std::min(footprint.leafHeight, part.leafHeight);
+                    footprint.maxHeight = std::max(footprint.maxHeight, part.maxHeight);
+                    uniform = uniform && part.uniformColumn >= 0 &&
+                              (column == -1 || field.colors[part.uniformColumn] == field.colors[column]);
+                    column = part.uniformColumn;
+                }
+                footprint.uniformColumn = uniform ? column : -1;
+                level[static_cast<size_t>(ix) * count + iz] = footprint;
+            }
+        }
+    }
+
+    m_nodes.Clear();
+    m_shared = false;
+    int64_t lastSample;
+    glm::vec4 lastColor;
+    if (EmitHeightfield(field, levels, 0, 0, 0, 0, lastSample, lastColor) == -1) {
+        m_nodes.Allocate(); // empty root
+    }
+    if (m_buildShell) {
+        CollapseInteriorNodes();
+    }
+    MarkAllDirty();
+    if (m_filterColors) {
+        FilterColors(m_coverageAlpha);
+    }
+}
+
+// Emits the node at depth with the given path along each axis and everything below it,
+// depth first in slot order, and returns its index, or -1 when it holds no voxel. The
+// node's color is that of the last voxel inserted into it, which is handed back with its
+// insertion rank so the parent can pick the last of its children.
+inline int SparseVoxelOctree::EmitHeightfield(const Heightfield& field, const HeightfieldLevels& levels, int depth, int ix,
+                                       int iy, int iz, int64_t& lastSample, glm::vec4& lastColor) {
+    const CellSpan& xs = levels.columnSpans[depth][ix];
+    const CellSpan& ys = levels.layerSpans[depth][iy];
+    const CellSpan& zs = levels.columnSpans[depth][iz];
+    const HeightfieldLevels::Footprint& footprint = levels.footprints[depth][static_cast<size_t>(ix) * (1 << depth) + iz];
+    if (ys.begin >= ys.end || footprint.maxHeight <= ys.begin) {
+        return -1;
+    }
+    bool byLayer = !field.layerColors.empty();
+    auto voxelColor = [&](int column, int layer) {
+        return byLayer ? field.layerColors[std::min(layer, static_cast<int>(field.layerColors.size()) - 1)]
+                       : field.colors[column];
+    };
+    auto rank = [&](int x, int z, int layer) {
+        return (static_cast<int64_t>(x) * field.columns + z) * levels.layerCount + layer;
+    };
+
+    // Full when every leaf has a column reaching at least its lowest layer. Every voxel
+    // then comes from the layers below the highest column, so one run of layer colors (or
+    // one column color) covering them makes the node uniform.
+    bool full = xs.complete && zs.complete && ys.complete && footprint.leafHeight > ys.topLeafBegin;
+    bool uniform = full && (byLayer ? levels.layerRunEnd[ys.begin] >= std::min(ys.end, footprint.maxHeight) - 1
+                                    : footprint.uniformColumn >= 0);
+    if (uniform || depth == m_maxDepth) {
+        // Last voxel in: the last column reaching the node's lowest layer, at its highest
+        // layer inside the node.
+        int lastX = -1, lastZ = -1;
+        for (int x = xs.end - 1; x >= xs.begin && lastX == -1; x--) {
+            for (int z = zs.end - 1; z >= zs.begin; z--) {
+                if (field.heights[static_cast<size_t>(x) * field.columns + z] > ys.begin) {
+                    lastX = x;
+                    lastZ = z;
+                    break;
+                }
+            }
+        }
+        int top = std::min(ys.end, field.heights[static_cast<size_t>(lastX) * field.columns + lastZ]) - 1;
+        int index = m_nodes.Allocate();
+        m_nodes[index].IsLeaf = true;
+        // Every leaf below a uniform node shows this color too, so it is also the mean
+        // TryCollapse would give the coarse leaf.
+        lastSample = rank(lastX, lastZ, top);
+        lastColor = voxelColor(lastX * field.columns + lastZ, top);
+        m_nodes[index].color = lastColor;
+        return index;
+    }
+
+    int index = m_nodes.Allocate();
+    lastSample = -1;
+    for (int slot = 0; slot < 8; slot++) {
+        int64_t childSample;
+        glm::vec4 childColor;
+        int child = EmitHeightfield(field, levels, depth + 1, 2 * ix + ((slot >> 2) & 1), 2 * iy + ((slot >> 1) & 1),
+                                    2 * iz + (slot & 1), childSample, childColor);
+        m_nodes[index].childIndices[slot] = child;
+        if (child != -1 && childSample > lastSample) {
+            lastSample = childSample;
+            lastColor = childColor;
+        }
+    }
+    m_nodes[index].color = lastColor;
+    return index;
+}
+
+// Cell spans of the nodes at each depth, the same along every axis, and the last run of
+// layer colors from each layer. grid holds the densities of the last box sampled, which
+// the nodes below the one that sampled it read instead of sampling again.
+struct SparseVoxelOctree::DensityLevels {
+    static const int SAMPLE_CELLS = 8;     // nodes at most this many cells across are sampled whole
+    int cellCount;
+    std::vector<std::vector<CellSpan>> spans;   // [depth][path]
+    std::vector<int> layerRunEnd;
+    std::vector<glm::vec4> layerColors;
+    glm::ivec3 gridLo;
+    glm::ivec3 gridSize;
+    std::vector<float> grid;
+};
+
+// Replaces the tree with the cells of field. The tree is built top-down like
+// BuildFromHeightfield: a node is dropped when its bounds prove every cell empty, made a
+// coarse leaf when they prove every cell solid and its layers share one color, and split
+// otherwise. A node whose bounds settle nothing is sampled whole once it is at most
+// SAMPLE_CELLS cells across, and the nodes below it read those samples, so only the cells
+// near the surface are ever sampled and the cost follows the surface area rather than the
+// volume. The result matches BuildFromVoxels over the filled cells in x, then y, then z
+// order followed by CollapseUniform() byte for byte.
+inline void SparseVoxelOctree::BuildFromDensity(const DensityField& field) {
+    const int cellSize = std::max(1, field.cellSize);
+    DensityLevels levels;
+    levels.cellCount = (m_size + cellSize - 1) / cellSize;
+    levels.spans = CellSpans(cellSize, levels.cellCount);
+    levels.layerColors.resize(levels.cellCount, glm::vec4(1.0f));
+    for (int layer = 0; layer < levels.cellCount && !field.layerColors.empty(); layer++) {
+        levels.layerColors[layer] = field.layerColors[std::min(layer, static_cast<int>(field.layerColors.size()) - 1)];
+    }
+    levels.layerRunEnd.resize(levels.cellCount);
+    for (int layer = levels.cellCount - 1; layer >= 0; layer--) {
+        bool sameAsNext = layer + 1 < levels.cellCount && levels.layerColors[layer] == levels.layerColors[layer + 1];
+        levels.layerRunEnd[layer] = sameAsNext ? levels.layerRunEnd[layer + 1] : layer;
+    }
+
+    m_nodes.Clear();
+    m_shared = false;
+    int64_t lastSample;
+    glm::vec4 lastColor;
+    if (EmitDensity(field, levels, 0, 0, 0, 0, DensityKnown::Nothing, lastSample, lastColor) == -1) {
+        m_nodes.Allocate(); // empty root
+    }
+    if (m_buildShell) {
+        CollapseInteriorNodes();
+    }
+    MarkAllDirty();
+    if (m_filterColors) {
+        FilterColors(m_coverageAlpha);
+    }
+}
+
+// Emits the node at depth with the given path along each axis and everything below it,
+// depth first in slot order, and returns its index, or -1 when it holds no filled cell.
+// known says what an ancestor already found out about the node's cells: all solid, or
+// sampled into levels.grid. Colors and ranks follow EmitHeightfield, with cells ranked
+// x, then y, then z.
+inline int SparseVoxelOctree::EmitDensity(const DensityField& field, DensityLevels& levels, int depth, int ix, int iy,
+                                   int iz, DensityKnown known, int64_t& lastSample, glm::vec4& lastColor) {
+    const CellSpan& xs = levels.spans[depth][ix];
+    const CellSpan& ys = levels.spans[depth][iy];
+    const CellSpan& zs = levels.spans[depth][iz];
+    if (xs.begin >= xs.end || ys.begin >= ys.end || zs.begin >= zs.end) {
+        return -1;
+    }
+    glm::ivec3 lo(xs.begin, ys.begin, zs.begin);
+    glm::ivec3 hi(xs.end, ys.end, zs.end);
+    glm::ivec3 size = hi - lo;
+    if (known == DensityKnown::Nothing) {
+        float minDensity, maxDensity;
+        field.bounds(lo, hi, minDensity, maxDensity);
+        if (maxDensity <= 0.0f) {
+            return -1;
+        }
+        if (minDensity > 0.0f) {
+            known = DensityKnown::Solid;
+        } else if (depth == m_maxDepth || std::max(size.x, std::max(size.y, size.z)) <= DensityLevels::SAMPLE_CELLS) {
+            levels.gridLo = lo;
+            levels.gridSize = size;
+            levels.grid.resize(static_cast<size_t>(size.x) * size.y * size.z);
+            field.sample(lo, size, levels.grid.data());
+            known = DensityKnown::Sampled;
+        }
+    }
+
+    if (known != DensityKnown::Nothing) {
+        int64_t volume = static_cast<int64_t>(size.x) * size.y * size.z;
+        int64_t filled = volume;
+        glm::ivec3 last = hi - glm::ivec3(1);
+        if (known == DensityKnown::Sampled) {
+            filled = 0;
+            glm::ivec3 gridSize = levels.gridSize;
+            for (int x = lo.x; x < hi.x; x++) {
+                for (int y = lo.y; y < hi.y; y++) {
+                    const float* row = levels.grid.data() +
+                        (static_cast<size_t>(x - levels.gridLo.x) * gridSize.y + (y - levels.gridLo.y)) * gridSize.z -
+                        levels.gridLo.z;
+                    for (int z = lo.z; z < hi.z; z++) {
+                        if (row[z] > 0.0f) {
+                            filled++;
+                            last = glm::ivec3(x, y, z);
+                        }
+                    }
+                }
+            }
+            if (filled == 0) {
+                return -1;
+            }
+        }
+        bool full = filled == volume && xs.complete && ys.complete && zs.complete;
+        bool uniform = full && levels.layerRunEnd[ys.begin] >= ys.end - 1;
+        if (uniform || depth == m_maxDepth) {
+            int index = m_nodes.Allocate();
+            m_nodes[index].IsLeaf = true;
+            lastSample = (static_cast<int64_t>(last.x) * levels.cellCount + last.y) * levels.cellCount + last.z;
+            lastColor = levels.layerColors[last.y];
+            m_nodes[index].color = lastColor;
+            return index;
+        }
+    }
+
+    int index = m_nodes.Allocate();
+    lastSample = -1;
+    for (int slot = 0; slot < 8; slot++) {
+        int64_t childSample;
+        glm::vec4 childColor;
+        int child = EmitDensity(field, levels, depth + 1, 2 * ix + ((slot >> 2) & 1), 2 * iy + ((slot >> 1) & 1),
+                                2 * iz + (slot & 1), known, childSample, childColor);
+        m_nodes[index].childIndices[slot] = child;
+        if (child != -1 && childSample > lastSample) {
+            lastSample = childSample;
+            lastColor = childColor;
+        }
+    }
+    if (lastSample == -1) {
+        m_nodes.Resize(index); // bounds too loose to drop it, but nothing below was filled
+        return -1;
+    }
+    m_nodes[index].color = lastColor;
+    // Loose bounds, or leaves holding cells of several colors, can leave 8 leaves of one
+    // color below a node that was not found uniform. They are the last 8 nodes allocated.
+    if (TryCollapse(m_nodes, index, 0.0f)) {
+        m_nodes.Resize(index + 1);
+    }
+    return index;
+}
+
+// Converts the flattened nodes to the compact layout. Nodes are numbered breadth first so
+// the children of every node end up contiguous, and each node's color moves to the
+// attribute stream at the same index. A brickSize of 4 or 8 stores the bottom 2 or 3
+// levels as dense bricks instead of nodes. Colors are collected as floats and encoded
+// once the tree is laid out, so a palette sees every color in both streams.
+inline CompactOctree SparseVoxelOctree::ToCompact(int brickSize, AttributeEncoding encoding) const {
+    CompactOctree compact;
+    std::vector<glm::vec4> nodeColors;
+    std::vector<glm::vec4> brickColors;
+    int brickLevels = 0;
+    if (brickSize == 4 || brickSize == 8) {
+        brickLevels = (brickSize == 4) ? 2 : 3;
+        if (brickLevels > m_maxDepth) {
+            brickLevels = 0;
+        }
+    }
+    compact.brickSize = brickLevels ? brickSize : 0;
+    int brickDepth = m_maxDepth - brickLevels;
+    int brickVoxels = brickSize * brickSize * brickSize;
+
+    compact.nodes.reserve(m_nodes.Size());
+    nodeColors.reserve(m_nodes.Size());
+    compact.nodes.emplace_back();
+    nodeColors.push_back(m_nodes[0].color);
+
+    std::vector<int> source(1, 0); // flattened index of every compact node so far
+    std::vector<int> depth(1, 0);
+    std::vector<glm::vec4> brickVoxelColors(brickLevels ? brickVoxels : 0);
+    std::vector<uint8_t> brickFilled(brickLevels ? brickVoxels : 0);
+    for (size_t i = 0; i < source.size(); i++) {
+        const FlattenedNode& node = m_nodes[source[i]];
+        CompactNode packed;
+
+        if (brickLevels && depth[i] == brickDepth && !node.IsLeaf) {
+            std::fill(brickFilled.begin(), brickFilled.end(), 0);
+            GatherBrick(source[i], glm::ivec3(0), brickSize, brickSize, brickVoxelColors.data(), brickFilled.data());
+            packed.flags = CompactNode::BRICK;
+            packed.firstChild = static_cast<uint32_t>(compact.bricks.size() / compact.brickStride());
+            size_t base = compact.bricks.size();
+            compact.bricks.resize(base + compact.brickStride(), 0);
+            compact.bricks[base + brickVoxels / 32] = static_cast<uint32_t>(brickColors.size());
+            for (int voxel = 0; voxel < brickVoxels; voxel++) {
+                if (brickFilled[voxel]) {
+                    compact.bricks[base + voxel / 32] |= 1u << (voxel % 32);
+                    brickColors.push_back(brickVoxelColors[voxel]);
+                }
+            }
+            compact.nodes[i] = packed;
+            continue;
+        }
+
+        packed.firstChild = static_cast<uint32_t>(compact.nodes.size());
+        for (int child = 0; child < 8; child++) {
+            int childIndex = node.childIndices[child];
+            if (childIndex == -1) {
+                continue;
+            }
+            packed.childMask |= 1 << child;
+            if (m_nodes[childIndex].IsLeaf) {
+                packed.leafMask |= 1 << child;
+            }
+            compact.nodes.emplace_back();
+            nodeColors.push_back(m_nodes[childIndex].color);
+            source.push_back(childIndex);
+            depth.push_back(depth[i] + 1);
+        }
+        if (packed.childMask == 0) {
+            packed.firstChild = 0;
+        }
+        compact.nodes[i] = packed;
+    }
+
+    compact.encoding = encoding;
+    if (isPaletteEncoding(encoding)) {
+        std::vector<glm::vec4> allColors(nodeColors);
+        allColors.insert(allColors.end(), brickColors.begin(), brickColors.end());
+        compact.palette = buildPalette(allColors, (encoding == AttributeEncoding::Palette8) ? 256 : 65536);
+    }
+    compact.colors = encodeAttributes(nodeColors, encoding, compact.palette);
+    compact.brickColors = encodeAttributes(brickColors, encoding, compact.palette);
+    return compact;
+}
+
+// Writes the leaves below nodeIndex into a dense brickSize^3 grid. cell is the node's
+// corner and cellSize its edge, both in brick voxels. A leaf above the bottom level
+// fills its whole cube.
+inline void SparseVoxelOctree::GatherBrick(int nodeIndex, glm::ivec3 cell, int cellSize, int brickSize,
+                                    glm::vec4* voxels, uint8_t* filled) const {
+    const FlattenedNode& node = m_nodes[nodeIndex];
+    if (node.IsLeaf) {
+        for (int x = cell.x; x < cell.x + cellSize; x++) {
+            for (int y = cell.y; y < cell.y + cellSize; y++) {
+                for (int z = cell.z; z < cell.z + cellSize; z++) {
+                    int voxel = (x * brickSize + y) * brickSize + z;
+                    voxels[voxel] = node.color;
+                    filled[voxel] = 1;
+                }
+            }
+        }
+        return;
+    }
+    int half = cellSize / 2;
+    for (int child = 0; child < 8; child++) {
+        if (node.childIndices[child] != -1) {
+            glm::ivec3 offset((child >> 2) & 1, (child >> 1) & 1, child & 1);
+            GatherBrick(node.childIndices[child], cell + offset * half, half, brickSize, voxels, filled);
+        }
+    }
+}
+
+// Replaces the flattened nodes with the tree stored in compact, keeping its node order.
+// Bricks are expanded back into nodes appended after the compact ones. Bricks keep no
+// interior colors, so nodes inside them take the color of the last voxel below them.
+inline void SparseVoxelOctree::FromCompact(const CompactOctree& compact) {
+    m_nodes.Clear();
+    m_shared = false;
+    m_nodes.Resize(compact.nodes.size());
+    for (size_t i = 0; i < compact.nodes.size(); i++) {
+        const CompactNode& packed = compact.nodes[i];
+        m_nodes[i].color = compact.nodeColor(i);
+        if (packed.flags & CompactNode::BRICK) {
+            int brickSize = compact.brickSize;
+            const uint32_t* brick = &compact.bricks[static_cast<size_t>(packed.firstChild) * compact.brickStride()];
+            int colorIndex = static_cast<int>(brick[brickSize * brickSize * brickSize / 32]);
+            for (int voxel = 0; voxel < brickSize * brickSize * brickSize; voxel++) {
+                if (!(brick[voxel / 32] & (1u << (voxel % 32)))) {
+                    continue;
+                }
+                glm::ivec3 local(voxel / (brickSize * brickSize), (voxel / brickSize) % brickSize, voxel % brickSize);
+                // Walk down from the brick root, creating nodes on the way.
+                int nodeIndex = static_cast<int>(i);
+                for (int half = brickSize / 2; half >= 1; half /= 2) {
+                    int child = (((local.x / half) & 1) << 2) | (((local.y / half) & 1) << 1) | ((local.z / half) & 1);
+                    int next = m_nodes[nodeIndex].childIndices[child];
+                    if (next == -1) {
+                        next = m_nodes.Allocate();
+                        m_nodes[nodeIndex].childIndices[child] = next;
+                    }
+                    nodeIndex = next;
+                    m_nodes[nodeIndex].color = compact.brickColor(colorIndex);
+                }
+                m_nodes[nodeIndex].IsLeaf = true;
+                colorIndex++;
+            }
+            continue;
+        }
+        int rank = 0;
+        for (int child = 0; child < 8; child++) {
+            if (!(packed.childMask & (1 << child))) {
+                continue;
+            }
+            int childIndex = static_cast<int>(packed.firstChild) + rank++;
+            m_nodes[i].childIndices[child] = childIndex;
+            if (packed.leafMask & (1 << child)) {
+                m_nodes[childIndex].IsLeaf = true;
+            }
+        }
+    }
+    MarkAllDirty();
+    if (m_filterColors) {
+        FilterColors(m_coverageAlpha);
+    }
+}
+
+// Replaces the nodes with count flattened nodes as they are, for example the node section
+// of a mapped octree file. The nodes are copied a chunk at a time; the only look at them
+// is whether they share subtrees, which makes the tree a DAG that refuses edits.
+inline void SparseVoxelOctree::LoadNodes(const FlattenedNode* nodes, size_t count) {
+    m_nodes.Assign(nodes, count);
+    m_shared = HasSharedChildren();
+    MarkAllDirty();
+}
+
+// Breadth-first bitstream of the tree, see OctreeBitstream. Shared subtrees of a DAG are
+// written out once per parent.
+inline OctreeBitstream SparseVoxelOctree::ToBitstream() const {
+    OctreeBitstream stream;
+    stream.size = m_size;
+    stream.maxDepth = m_maxDepth;
+    stream.filtered = m_filterColors;
+    stream.coverageAlpha = m_coverageAlpha;
+
+    const FlattenedNode& root = m_nodes[0];
+    bool empty = !root.IsLeaf && std::all_of(std::begin(root.childIndices), std::end(root.childIndices),
+                                             [](int child) { return child == -1; });
+    if (empty) {
+        return stream;
+    }
+    std::vector<int> order(1, 0); // flattened index of every node so far, breadth first
+    std::vector<glm::vec4> colors;
+    size_t levelEnd = 1;
+    int depth = 0;
+    for (size_t i = 0; i < order.size(); i++) {
+        if (i == levelEnd) {
+            levelEnd = order.size();
+            depth++;
+        }
+        const FlattenedNode& node = m_nodes[order[i]];
+        if (!m_filterColors || node.IsLeaf) {
+            colors.push_back(node.color);
+        }
+        if (depth == m_maxDepth) {
+            continue;
+        }
+        uint8_t mask = 0;
+        if (!node.IsLeaf) {
+            for (int child = 0; child < 8; child++) {
+                if (node.childIndices[child] != -1) {
+                    mask |= 1 << child;
+                    order.push_back(node.childIndices[child]);
+                }
+            }
+        }
+        stream.masks.push_back(mask);
+    }
+    stream.nodeCount = order.size();
+    encodeColorStream(colors, stream);
+    return stream;
+}
+
+// Replaces the nodes with the tree in stream, in its breadth-first order. The stream must
+// come from an octree with the same size and maxDepth; one whose counts do not add up is
+// refused and the tree is left as it was.
+inline void SparseVoxelOctree::FromBitstream(const OctreeBitstream& stream) {
+    if (stream.size != m_size || stream.maxDepth != m_maxDepth) {
+        std::cout << "Bitstream is for a different octree size or depth" << std::endl;
+        return;
+    }
+    if (!stream.Validate()) {
+        std::cout << "Bitstream masks and colors do not describe one tree" << std::endl;
+        return;
+    }
+    resetNodes(m_nodes, std::max<uint64_t>(stream.nodeCount, 1));
+    m_shared = false;
+    if (stream.nodeCount == 0) {
+        MarkAllDirty();
+        return;
+    }
+
+    // Children are numbered in the order they are met, so each node's children follow the
+    // children of the node before it.
+    size_t nextIndex = 1;
+    size_t levelEnd = 1;
+    size_t mask = 0;
+    int depth = 0;
+    for (size_t i = 0; i < stream.nodeCount; i++) {
+        if (i == levelEnd) {
+            levelEnd = nextIndex;
+            depth++;
+        }
+        FlattenedNode& node = m_nodes[i];
+        uint8_t childMask = (depth < m_maxDepth && mask < stream.masks.size()) ? stream.masks[mask++] : 0;
+        if (childMask == 0) {
+            node.IsLeaf = true;
+            continue;
+        }
+        for (int child = 0; child < 8; child++) {
+            if ((childMask & (1 << child)) && nextIndex < stream.nodeCount) {
+                node.childIndices[child] = static_cast<int>(nextIndex++);
+            }
+        }
+    }
+
+    if (stream.filtered) {
+        size_t leaf = 0;
+        decodeColorStream(stream, [&](uint64_t, glm::vec4 color) {
+            while (leaf < m_nodes.Size() && !m_nodes[leaf].IsLeaf) {
+                leaf++;
+            }
+            if (leaf < m_nodes.Size()) {
+                m_nodes[leaf++].color = color;
+            }
+        });
+        FilterColors(stream.coverageAlpha);
+        return;
+    }
+    decodeColorStream(stream, [&](uint64_t i, glm::vec4 color) {
+        if (i < m_nodes.Size()) {
+            m_nodes[i].color = color;
+        }
+    });
+    MarkAllDirty();
+    if (m_filterColors) {
+        FilterColors(m_coverageAlpha);
+    }
+}
+
+// Merges identical subtrees so every distinct subtree is stored once and shared by all of
+// its parents. Two nodes are identical when leaf flag, color and (already merged) children
+// all match, so the result renders exactly like the tree did. One pass from the back sees
+// every child before its parent once children sit after their parent, as the builders leave
+// them; edits put new nodes in freed slots anywhere, so an edited tree is repacked first.
+// The root stays at index 0 and parents still precede children. Writing a shared node would
+// edit every parent sharing it, so afterwards Insert, Set, Remove, ApplyBrush and the
+// collapse passes refuse with a message until the tree is built or loaded again.
+inline void SparseVoxelOctree::CompressToDAG() {
+    if (m_nodes.FreeCount() > 0 || !ChildrenFollowParents()) {
+        Repack(); // freed slots would also be merged like real nodes
+    }
+    std::vector<int> canonical(m_nodes.Size());
+    std::unordered_map<FlattenedNode, int, FlattenedNodeHash, FlattenedNodeEqual> unique;
+    unique.reserve(m_nodes.Size());
+    for (int i = static_cast<int>(m_nodes.Size()) - 1; i >= 0; i--) {
+        FlattenedNode& node = m_nodes[i];
+        for (int& child : node.childIndices) {
+            if (child != -1) {
+                child = canonical[child];
+            }
+        }
+        canonical[i] = unique.insert({node, i}).first->second;
+    }
+
+    // Keep one node per class, in the original order, and renumber.
+    std::vector<int> newIndex(m_nodes.Size(), -1);
+    int kept = 0;
+    for (size_t i = 0; i < m_nodes.Size(); i++) {
+        if (canonical[i] == static_cast<int>(i)) {
+            newIndex[i] = kept++;
+        }
+    }
+    for (size_t i = 0; i < m_nodes.Size(); i++) {
+        if (newIndex[i] == -1) {
+            continue;
+        }
+        FlattenedNode node = m_nodes[i];
+        for (int& child : node.childIndices) {
+            if (child != -1) {
+                child = newIndex[child];
+            }
+        }
+        m_nodes[newIndex[i]] = node;
+    }
+    m_nodes.Resize(kept);
+    m_shared = true;
+    MarkAllDirty();
+}
+
+// Replaces every interior color with the average of its children weighted by how much of
+// each child is filled, so a traversal that stops above the leaves still sees the right
+// color. Coverage is 1 for leaves and the mean over the 8 octants otherwise. With
+// coverageAlpha the coverage also goes into color.a. Every builder places children after
+// their parent, so one pass from the back sees children first; a tree edited since it was
+// built is repacked first, as in CompressToDAG. Afterwards Insert and the bulk builders
+// keep colors filtered.
+inline void SparseVoxelOctree::FilterColors(bool coverageAlpha) {
+    m_filterColors = true;
+    m_coverageAlpha = coverageAlpha;
+    if (!ChildrenFollowParents()) {
+        Repack();
+    }
+    for (int i = static_cast<int>(m_nodes.Size()) - 1; i >= 0; i--) {
+        FilterNode(i);
+    }
+    MarkAllDirty();
+}
+
+// Recomputes coverage and color of one node from its children.
+inline void SparseVoxelOctree::FilterNode(int nodeIndex) {
+    FlattenedNode& node = m_nodes[nodeIndex];
+    if (node.IsLeaf) {
+        node.coverage = 1.0f;
+        if (m_coverageAlpha) {
+            node.color.a = 1.0f;
+        }
+        return;
+    }
+    float coverage = 0.0f;
+    glm::vec4 weighted(0.0f);
+    for (int child : node.childIndices) {
+        if (child != -1) {
+            const FlattenedNode& childNode = m_nodes[child];
+            coverage += childNode.coverage;
+            weighted += childNode.color * childNode.coverage;
+        }
+    }
+    node.coverage = coverage / 8.0f;
+    if (coverage > 0.0f) {
+        node.color = weighted / coverage;
+        if (m_coverageAlpha) {
+            node.color.a = node.coverage;
+        }
+    }
+}
+
+#endif
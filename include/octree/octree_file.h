@@ -0,0 +1,518 @@
+#ifndef OCTREE_FILE_H
+#define OCTREE_FILE_H
+
+#include <octree/octree.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <type_traits>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Binary octree file, laid out so it can be mapped and used in place. A fixed header is
+// followed by one section per stream the renderer uploads, each starting on a page
+// boundary. The Flattened layout only has the node section; the Compact layout stores
+// the streams of a CompactOctree in the order of OctreeSection. Sections hold the same
+// bytes the SSBOs take, child links are indices, so loading needs no fix-up beyond adding
+// the section offsets to the mapping's base address. Files are written in the byte order
+// of the machine that saved them and are rejected on a machine with another one. Child
+// links are checked once when a file is mapped, so a damaged file is rejected before its
+// nodes reach the GPU or SparseVoxelOctree::LoadNodes.
+enum class OctreeSection {
+    Nodes = 0,          // FlattenedNode or CompactNode, see nodeLayout
+    Colors = 1,         // CompactOctree::colors
+    Palette = 2,        // CompactOctree::palette
+    Bricks = 3,         // CompactOctree::bricks
+    BrickColors = 4,    // CompactOctree::brickColors
+    Count = 5
+};
+
+struct OctreeFileSection {
+    uint64_t offset;    // from the start of the file, a multiple of OCTREE_FILE_ALIGNMENT
+    uint64_t bytes;
+};
+
+struct OctreeFileHeader {
+    char magic[8];              // OCTREE_FILE_MAGIC
+    uint32_t version;           // OCTREE_FILE_VERSION
+    uint32_t byteOrder;         // OCTREE_FILE_BYTE_ORDER as written by the saving machine
+    uint32_t headerBytes;       // sizeof(OctreeFileHeader)
+    int32_t size;               // SparseVoxelOctree constructor arguments
+    int32_t maxDepth;
+    uint32_t nodeLayout;        // NodeLayout
+    uint32_t nodeBytes;         // sizeof one node of that layout
+    uint32_t encoding;          // AttributeEncoding of the compact color streams
+    int32_t brickSize;          // CompactOctree::brickSize, 0 without bricks
+    uint32_t pageNodes;         // nodes per page of a paged file (see savePagedOctreeFile), 0 otherwise
+    uint32_t residentNodes;     // nodes in front of the first page of a paged file
+    uint64_t nodeCount;
+    uint64_t fileBytes;
+    uint64_t generator;         // what produced the contents, e.g. TERRAIN_GENERATOR_VERSION; 0 when unknown
+    OctreeFileSection sections[static_cast<int>(OctreeSection::Count)];
+};
+
+const char OCTREE_FILE_MAGIC[8] = {'V', 'O', 'X', 'O', 'C', 'T', 'R', 'E'};
+const uint32_t OCTREE_FILE_VERSION = 2;
+const uint32_t OCTREE_FILE_BYTE_ORDER = 0x01020304;
+const uint64_t OCTREE_FILE_ALIGNMENT = 4096; // a page on every platform we map on
+
+static_assert(std::is_trivially_copyable<FlattenedNode>::value, "nodes are written and mapped as raw bytes");
+static_assert(std::is_trivially_copyable<CompactNode>::value, "nodes are written and mapped as raw bytes");
+
+// Checks everything the section accessors rely on, so a truncated file or one written
+// by another version is rejected instead of read out of bounds. fileBytes is the size of
+// the whole file.
+inline bool validateOctreeFileHeader(const OctreeFileHeader& header, uint64_t fileBytes, const std::string& path) {
+    if (std::memcmp(header.magic, OCTREE_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        std::cout << path << " is not an octree file" << std::endl;
+        return false;
+    }
+    if (header.version != OCTREE_FILE_VERSION || header.headerBytes != sizeof(OctreeFileHeader)) {
+        std::cout << path << " has octree file version " << header.version << ", expected " << OCTREE_FILE_VERSION << std::endl;
+        return false;
+    }
+    if (header.byteOrder != OCTREE_FILE_BYTE_ORDER) {
+        std::cout << path << " was written with a different byte order" << std::endl;
+        return false;
+    }
+    NodeLayout layout = static_cast<NodeLayout>(header.nodeLayout);
+    size_t nodeBytes = (layout == NodeLayout::Compact) ? sizeof(CompactNode) : sizeof(FlattenedNode);
+    if (header.nodeLayout > static_cast<uint32_t>(NodeLayout::Compact) || header.nodeBytes != nodeBytes ||
+        header.sections[0].bytes != header.nodeCount * nodeBytes || header.fileBytes != fileBytes) {
+        std::cout << path << " has an inconsistent header" << std::endl;
+        return false;
+    }
+    if (header.pageNodes != 0 && (layout != NodeLayout::Flattened || header.residentNodes == 0 ||
+                                  header.residentNodes > header.nodeCount ||
+                                  (header.nodeCount - header.residentNodes) % header.pageNodes != 0)) {
+        std::cout << path << " has an inconsistent page layout" << std::endl;
+        return false;
+    }
+    for (const OctreeFileSection& section : header.sections) {
+        if (section.offset % OCTREE_FILE_ALIGNMENT != 0 || section.offset > fileBytes || section.bytes > fileBytes - section.offset) {
+            std::cout << path << " has a section outside the file" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Read-only view of an octree file. Open() maps the whole file and checks the header;
+// the section pointers stay valid until Close() or destruction.
+class MappedOctreeFile {
+public:
+    MappedOctreeFile() = default;
+    MappedOctreeFile(const MappedOctreeFile&) = delete;
+    MappedOctreeFile& operator=(const MappedOctreeFile&) = delete;
+    ~MappedOctreeFile() { Close(); }
+
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return m_data != nullptr; }
+    const OctreeFileHeader& Header() const { return *reinterpret_cast<const OctreeFileHeader*>(m_data); }
+    NodeLayout Layout() const { return static_cast<NodeLayout>(Header().nodeLayout); }
+    AttributeEncoding Encoding() const { return static_cast<AttributeEncoding>(Header().encoding); }
+    size_t NodeCount() const { return static_cast<size_t>(Header().nodeCount); }
+    const void* Section(OctreeSection section) const;
+    size_t SectionBytes(OctreeSection section) const;
+    const FlattenedNode* FlattenedNodes() const { return static_cast<const FlattenedNode*>(Section(OctreeSection::Nodes)); }
+    const CompactNode* CompactNodes() const { return static_cast<const CompactNode*>(Section(OctreeSection::Nodes)); }
+    CompactOctree ToCompact() const;
+private:
+    bool Validate(const std::string& path) const;
+    bool ValidateLinks(const std::string& path) const;
+
+    const unsigned char* m_data = nullptr;
+    size_t m_bytes = 0;
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#endif
+};
+
+// A run of bytes written into a section. A section may be written from several runs, so
+// the pool can be saved chunk by chunk without first copying it into one array.
+struct OctreeFilePiece {
+    const void* data;
+    size_t bytes;
+};
+
+// Writes the header and the sections made of the given pieces, padding each section to
+// the next page boundary.
+inline bool writeOctreeFile(const std::string& path, OctreeFileHeader header, const std::vector<OctreeFilePiece>* pieces) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cout << "Failed to open " << path << " for writing" << std::endl;
+        return false;
+    }
+    uint64_t offset = (sizeof(OctreeFileHeader) + OCTREE_FILE_ALIGNMENT - 1) / OCTREE_FILE_ALIGNMENT * OCTREE_FILE_ALIGNMENT;
+    for (int i = 0; i < static_cast<int>(OctreeSection::Count); i++) {
+        OctreeFileSection& section = header.sections[i];
+        section.offset = offset;
+        section.bytes = 0;
+        for (const OctreeFilePiece& piece : pieces[i]) {
+            section.bytes += piece.bytes;
+        }
+        offset += (section.bytes + OCTREE_FILE_ALIGNMENT - 1) / OCTREE_FILE_ALIGNMENT * OCTREE_FILE_ALIGNMENT;
+    }
+    header.fileBytes = offset;
+
+    const std::vector<char> zeros(OCTREE_FILE_ALIGNMENT, 0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t written = sizeof(header);
+    for (int i = 0; i < static_cast<int>(OctreeSection::Count); i++) {
+        file.write(zeros.data(), static_cast<std::streamsize>(header.sections[i].offset - written));
+        for (const OctreeFilePiece& piece : pieces[i]) {
+            file.write(static_cast<const char*>(piece.data), static_cast<std::streamsize>(piece.bytes));
+        }
+        written = header.sections[i].offset + header.sections[i].bytes;
+    }
+    file.write(zeros.data(), static_cast<std::streamsize>(header.fileBytes - written));
+    if (!file) {
+        std::cout << "Failed to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline OctreeFileHeader octreeFileHeader(int size, int maxDepth, NodeLayout layout, size_t nodeCount) {
+    OctreeFileHeader header = {};
+    std::memcpy(header.magic, OCTREE_FILE_MAGIC, sizeof(header.magic));
+    header.version = OCTREE_FILE_VERSION;
+    header.byteOrder = OCTREE_FILE_BYTE_ORDER;
+    header.headerBytes = sizeof(OctreeFileHeader);
+    header.size = size;
+    header.maxDepth = maxDepth;
+    header.nodeLayout = static_cast<uint32_t>(layout);
+    header.nodeBytes = (layout == NodeLayout::Compact) ? sizeof(CompactNode) : sizeof(FlattenedNode);
+    header.encoding = static_cast<uint32_t>(AttributeEncoding::Float);
+    header.nodeCount = nodeCount;
+    return header;
+}
+
+// Saves the flattened nodes of octree. They are written chunk by chunk straight from the
+// pool, freed slots included, so the file is the SSBO image uploadNodes would build.
+inline bool saveOctreeFile(const std::string& path, const SparseVoxelOctree& octree, uint64_t generator = 0) {
+    const NodePool<FlattenedNode>& nodes = octree.Nodes();
+    std::vector<OctreeFilePiece> pieces[static_cast<int>(OctreeSection::Count)];
+    for (size_t chunk = 0; chunk < nodes.ChunkCount(); chunk++) {
+        pieces[0].push_back({nodes.Chunk(chunk), nodes.ChunkNodes(chunk) * sizeof(FlattenedNode)});
+    }
+    OctreeFileHeader header = octreeFileHeader(octree.Size(), octree.MaxDepth(), NodeLayout::Flattened, nodes.Size());
+    header.generator = generator;
+    return writeOctreeFile(path, header, pieces);
+}
+
+// Saves a compact tree built from an octree of the given size and maxDepth.
+inline bool saveOctreeFile(const std::string& path, const CompactOctree& compact, int size, int maxDepth, uint64_t generator = 0) {
+    OctreeFileHeader header = octreeFileHeader(size, maxDepth, NodeLayout::Compact, compact.nodes.size());
+    header.generator = generator;
+    header.encoding = static_cast<uint32_t>(compact.encoding);
+    header.brickSize = compact.brickSize;
+    std::vector<OctreeFilePiece> pieces[static_cast<int>(OctreeSection::Count)] = {
+        {{compact.nodes.data(), compact.nodes.size() * sizeof(CompactNode)}},
+        {{compact.colors.data(), compact.colors.size() * sizeof(uint32_t)}},
+        {{compact.palette.data(), compact.palette.size() * sizeof(glm::vec4)}},
+        {{compact.bricks.data(), compact.bricks.size() * sizeof(uint32_t)}},
+        {{compact.brickColors.data(), compact.brickColors.size() * sizeof(uint32_t)}}
+    };
+    return writeOctreeFile(path, header, pieces);
+}
+
+// Saves octree for PagedOctree. Nodes above cutDepth come first, breadth first, padded to
+// a whole page of the file system; they are always resident. Each subtree rooted at
+// cutDepth follows depth first, so a query stays within a few pages. A subtree that fits
+// in a page but not in what is left of the current one starts a new page, and the node
+// section is padded with empty nodes to a whole number of pages. Child indices point into
+// the reordered array. Subtrees shared in a DAG are written once.
+inline bool savePagedOctreeFile(const std::string& path, const SparseVoxelOctree& octree, int cutDepth, uint32_t pageNodes = 1024) {
+    const NodePool<FlattenedNode>& nodes = octree.Nodes();
+    cutDepth = std::max(1, std::min(cutDepth, octree.MaxDepth()));
+    const int UNVISITED = -1;
+    const int PENDING = -2; // subtree root found, not yet placed
+    std::vector<int> remap(nodes.Size(), UNVISITED);
+    std::vector<int> order;  // old index of each new index, -1 for padding
+    std::vector<int> roots;  // subtree roots at cutDepth in breadth-first order
+
+    std::vector<int> level(1, 0);
+    remap[0] = 0;
+    order.push_back(0);
+    for (int depth = 0; depth < cutDepth && !level.empty(); depth++) {
+        std::vector<int> next;
+        for (int index : level) {
+            if (nodes[index].IsLeaf) {
+                continue;
+            }
+            for (int child : nodes[index].childIndices) {
+                if (child == -1 || remap[child] != UNVISITED) {
+                    continue;
+                }
+                if (depth + 1 < cutDepth) {
+                    remap[child] = static_cast<int>(order.size());
+                    order.push_back(child);
+                    next.push_back(child);
+                } else {
+                    remap[child] = PENDING;
+                    roots.push_back(child);
+                }
+            }
+        }
+        level.swap(next);
+    }
+    const size_t alignNodes = OCTREE_FILE_ALIGNMENT / sizeof(FlattenedNode);
+    order.resize((order.size() + alignNodes - 1) / alignNodes * alignNodes, -1);
+    const size_t residentNodes = order.size();
+
+    std::vector<int> stack;
+    std::vector<int> subtree;
+    for (int root : roots) {
+        // Collect the subtree depth first, children in slot order, skipping shared nodes
+        // that are already placed.
+        subtree.clear();
+        stack.assign(1, root);
+        while (!stack.empty()) {
+            int index = stack.back();
+            stack.pop_back();
+            subtree.push_back(index);
+            remap[index] = 0; // placed below, marked so a DAG does not collect it twice
+            if (nodes[index].IsLeaf) {
+                continue;
+            }
+            for (int slot = 7; slot >= 0; slot--) {
+                int child = nodes[index].childIndices[slot];
+                if (child != -1 && remap[child] == UNVISITED) {
+                    remap[child] = 0;
+                    stack.push_back(child);
+                }
+            }
+        }
+        size_t used = (order.size() - residentNodes) % pageNodes;
+        if (subtree.size() <= pageNodes && used != 0 && used + subtree.size() > pageNodes) {
+            order.resize(order.size() + pageNodes - used, -1);
+        }
+        for (int index : subtree) {
+            remap[index] = static_cast<int>(order.size());
+            order.push_back(index);
+        }
+    }
+    size_t used = (order.size() - residentNodes) % pageNodes;
+    if (used != 0) {
+        order.resize(order.size() + pageNodes - used, -1);
+    }
+
+    std::vector<FlattenedNode> out(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        if (order[i] == -1) {
+            continue;
+        }
+        out[i] = nodes[order[i]];
+        if (!out[i].IsLeaf) {
+            for (int& child : out[i].childIndices) {
+                child = (child == -1) ? -1 : remap[child];
+            }
+        }
+    }
+    std::vector<OctreeFilePiece> pieces[static_cast<int>(OctreeSection::Count)];
+    pieces[0].push_back({out.data(), out.size() * sizeof(FlattenedNode)});
+    OctreeFileHeader header = octreeFileHeader(octree.Size(), octree.MaxDepth(), NodeLayout::Flattened, out.size());
+    header.pageNodes = pageNodes;
+    header.residentNodes = static_cast<uint32_t>(residentNodes);
+    return writeOctreeFile(path, header, pieces);
+}
+
+inline bool MappedOctreeFile::Open(const std::string& path) {
+    Close();
+#ifdef _WIN32
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart == 0) {
+        Close();
+        return false;
+    }
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* data = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (data == nullptr) {
+        std::cout << "Failed to map " << path << std::endl;
+        Close();
+        return false;
+    }
+    m_bytes = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if (data == MAP_FAILED) {
+        std::cout << "Failed to map " << path << std::endl;
+        return false;
+    }
+    m_bytes = static_cast<size_t>(info.st_size);
+#endif
+    m_data = static_cast<const unsigned char*>(data);
+    if (!Validate(path)) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+inline void MappedOctreeFile::Close() {
+#ifdef _WIN32
+    if (m_data != nullptr) {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping != nullptr) {
+        CloseHandle(m_mapping);
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_file);
+    }
+    m_mapping = nullptr;
+    m_file = INVALID_HANDLE_VALUE;
+#else
+    if (m_data != nullptr) {
+        munmap(const_cast<unsigned char*>(m_data), m_bytes);
+    }
+#endif
+    m_data = nullptr;
+    m_bytes = 0;
+}
+
+inline bool MappedOctreeFile::Validate(const std::string& path) const {
+    if (m_bytes < sizeof(OctreeFileHeader)) {
+        std::cout << path << " is too small to be an octree file" << std::endl;
+        return false;
+    }
+    return validateOctreeFileHeader(Header(), m_bytes, path) && ValidateLinks(path);
+}
+
+// Checks that every child, brick and color index a traversal follows stays inside its
+// section, one pass over the nodes.
+inline bool MappedOctreeFile::ValidateLinks(const std::string& path) const {
+    size_t nodeCount = NodeCount();
+    if (Layout() == NodeLayout::Flattened) {
+        const FlattenedNode* nodes = FlattenedNodes();
+        for (size_t i = 0; i < nodeCount; i++) {
+            for (int child : nodes[i].childIndices) {
+                if (child < -1 || (child != -1 && static_cast<size_t>(child) >= nodeCount)) {
+                    std::cout << path << " has node " << i << " linking to child " << child << " of " << nodeCount << std::endl;
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    const OctreeFileHeader& header = Header();
+    AttributeEncoding encoding = Encoding();
+    int brickSize = header.brickSize;
+    if (header.encoding > static_cast<uint32_t>(AttributeEncoding::Palette16) ||
+        (brickSize != 0 && brickSize != 4 && brickSize != 8)) {
+        std::cout << path << " has an unknown color encoding or brick size" << std::endl;
+        return false;
+    }
+    // Words needed for count colors, and whether palette indices stay inside the palette.
+    size_t paletteSize = SectionBytes(OctreeSection::Palette) / sizeof(glm::vec4);
+    auto colorsFit = [&](OctreeSection section, size_t count) {
+        size_t bits = static_cast<size_t>(attributeBits(encoding));
+        const uint32_t* words = static_cast<const uint32_t*>(Section(section));
+        if (SectionBytes(section) / sizeof(uint32_t) < (count * bits + 31) / 32) {
+            return false;
+        }
+        if (!isPaletteEncoding(encoding)) {
+            return true;
+        }
+        uint32_t mask = (1u << bits) - 1;
+        for (size_t i = 0; i < count; i++) {
+            size_t bit = i * bits;
+            if (((words[bit / 32] >> (bit % 32)) & mask) >= paletteSize) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    const CompactNode* nodes = CompactNodes();
+    const uint32_t* bricks = static_cast<const uint32_t*>(Section(OctreeSection::Bricks));
+    int brickVoxels = brickSize * brickSize * brickSize;
+    size_t brickStride = brickSize ? static_cast<size_t>(brickVoxels / 32 + 1) : 1;
+    size_t brickCount = brickSize ? SectionBytes(OctreeSection::Bricks) / sizeof(uint32_t) / brickStride : 0;
+    size_t brickColorCount = 0;
+    for (size_t i = 0; i < nodeCount; i++) {
+        const CompactNode& node = nodes[i];
+        if (node.flags & CompactNode::BRICK) {
+            if (node.firstChild >= brickCount) {
+                std::cout << path << " has node " << i << " linking to brick " << node.firstChild << " of " << brickCount << std::endl;
+                return false;
+            }
+            const uint32_t* brick = bricks + node.firstChild * brickStride;
+            size_t filled = 0;
+            for (int word = 0; word < brickVoxels / 32; word++) {
+                filled += static_cast<size_t>(popCount(brick[word]));
+            }
+            brickColorCount = std::max(brickColorCount, static_cast<size_t>(brick[brickVoxels / 32]) + filled);
+        } else if (node.childMask != 0 &&
+                   static_cast<uint64_t>(node.firstChild) + static_cast<uint64_t>(popCount(node.childMask)) > nodeCount) {
+            std::cout << path << " has node " << i << " linking to children past node " << nodeCount << std::endl;
+            return false;
+        }
+    }
+    if (!colorsFit(OctreeSection::Colors, nodeCount) || !colorsFit(OctreeSection::BrickColors, brickColorCount)) {
+        std::cout << path << " has colors missing or outside its palette" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline const void* MappedOctreeFile::Section(OctreeSection section) const {
+    return m_data + Header().sections[static_cast<int>(section)].offset;
+}
+
+inline size_t MappedOctreeFile::SectionBytes(OctreeSection section) const {
+    return static_cast<size_t>(Header().sections[static_cast<int>(section)].bytes);
+}
+
+// Copies a Compact layout file into a CompactOctree, for CPU traversal and FromCompact.
+inline CompactOctree MappedOctreeFile::ToCompact() const {
+    CompactOctree compact;
+    const CompactNode* nodes = CompactNodes();
+    compact.nodes.assign(nodes, nodes + NodeCount());
+    compact.encoding = Encoding();
+    compact.brickSize = Header().brickSize;
+    auto words = [&](OctreeSection section, std::vector<uint32_t>& out) {
+        const uint32_t* begin = static_cast<const uint32_t*>(Section(section));
+        out.assign(begin, begin + SectionBytes(section) / sizeof(uint32_t));
+    };
+    words(OctreeSection::Colors, compact.colors);
+    words(OctreeSection::Bricks, compact.bricks);
+    words(OctreeSection::BrickColors, compact.brickColors);
+    const glm::vec4* palette = static_cast<const glm::vec4*>(Section(OctreeSection::Palette));
+    compact.palette.assign(palette, palette + SectionBytes(OctreeSection::Palette) / sizeof(glm::vec4));
+    return compact;
+}
+
+#endif
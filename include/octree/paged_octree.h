@@ -0,0 +1,215 @@
+#ifndef PAGED_OCTREE_H
+#define PAGED_OCTREE_H
+
+#include <glm/glm.hpp>
+#include <octree/octree.h>
+#include <octree/octree_file.h>
+#include <vector>
+#include <string>
+#include <list>
+#include <iterator>
+#include <fstream>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+
+// Page cache counters. Every node read below the resident top is an access, and each one
+// is either a hit or a fault that read its page from disk.
+struct PagingStats {
+    uint64_t accesses = 0;
+    uint64_t hits = 0;
+    uint64_t faults = 0;
+    uint64_t evictions = 0;
+    uint64_t bytesRead = 0;
+
+    double HitRatio() const { return accesses ? static_cast<double>(hits) / accesses : 1.0; }
+    double FaultRate() const { return accesses ? static_cast<double>(faults) / accesses : 0.0; }
+};
+
+// Read-only octree that keeps only part of a paged octree file (see savePagedOctreeFile)
+// in memory. The nodes above the cut level are loaded by Open and stay resident; the
+// subtrees below it are read a page at a time with ordinary file reads the first time a
+// query reaches them, and kept in a least recently used cache that holds as many pages as
+// fit in the memory budget beside the resident nodes. At least one page is always cached.
+// Node indices are those of the file, so the same traversal code works on either. Not
+// thread safe: every read may change the cache.
+class PagedOctree {
+public:
+    bool Open(const std::string& path, size_t memoryBudget);
+    void Close();
+    void SetMemoryBudget(size_t memoryBudget);
+    bool Get(glm::ivec3 point, glm::vec4& color);
+    const FlattenedNode& Node(size_t index);
+    int Size() const { return m_header.size; }
+    int MaxDepth() const { return m_header.maxDepth; }
+    size_t NodeCount() const { return static_cast<size_t>(m_header.nodeCount); }
+    size_t PageCount() const { return m_pageCount; }
+    size_t CachedPages() const { return m_pages.size(); }
+    size_t PageBytes() const { return m_header.pageNodes * sizeof(FlattenedNode); }
+    size_t ResidentBytes() const { return m_resident.size() * sizeof(FlattenedNode) + m_pages.size() * PageBytes(); }
+    const PagingStats& Stats() const { return m_stats; }
+    void ResetStats() { m_stats = PagingStats(); }
+private:
+    struct Page {
+        size_t index;
+        std::vector<FlattenedNode> nodes;
+    };
+
+    const FlattenedNode* FetchPage(size_t page);
+
+    std::ifstream m_file;
+    std::string m_path;
+    OctreeFileHeader m_header = {};
+    std::vector<int> m_halfSizes;               // same truncation as SparseVoxelOctree
+    std::vector<FlattenedNode> m_resident;      // the nodes above the cut, always in memory
+    size_t m_pageCount = 0;
+    size_t m_maxPages = 1;
+    std::list<Page> m_pages;                    // most recently used first
+    std::unordered_map<size_t, std::list<Page>::iterator> m_pageLookup;
+    FlattenedNode m_empty;                      // returned for indices outside the file
+    PagingStats m_stats;
+};
+
+inline bool PagedOctree::Open(const std::string& path, size_t memoryBudget) {
+    Close();
+    m_file.open(path, std::ios::binary);
+    if (!m_file) {
+        return false;
+    }
+    m_file.seekg(0, std::ios::end);
+    uint64_t fileBytes = static_cast<uint64_t>(m_file.tellg());
+    m_file.seekg(0);
+    if (fileBytes < sizeof(OctreeFileHeader) || !m_file.read(reinterpret_cast<char*>(&m_header), sizeof(m_header))) {
+        std::cout << path << " is too small to be an octree file" << std::endl;
+        Close();
+        return false;
+    }
+    if (!validateOctreeFileHeader(m_header, fileBytes, path)) {
+        Close();
+        return false;
+    }
+    if (m_header.pageNodes == 0) {
+        std::cout << path << " is not a paged octree file" << std::endl;
+        Close();
+        return false;
+    }
+
+    m_path = path;
+    for (int depth = 0; depth < m_header.maxDepth; depth++) {
+        m_halfSizes.push_back(static_cast<int>(m_header.size / std::exp2(depth) / 2.0f));
+    }
+    m_resident.resize(m_header.residentNodes);
+    m_file.seekg(static_cast<std::streamoff>(m_header.sections[0].offset));
+    if (!m_file.read(reinterpret_cast<char*>(m_resident.data()), m_resident.size() * sizeof(FlattenedNode))) {
+        std::cout << "Failed to read " << path << std::endl;
+        Close();
+        return false;
+    }
+    m_pageCount = static_cast<size_t>((m_header.nodeCount - m_header.residentNodes) / m_header.pageNodes);
+    SetMemoryBudget(memoryBudget);
+    return true;
+}
+
+inline void PagedOctree::Close() {
+    m_file.close();
+    m_file.clear();
+    m_path.clear();
+    m_header = OctreeFileHeader();
+    m_halfSizes.clear();
+    m_resident.clear();
+    m_pageCount = 0;
+    m_pages.clear();
+    m_pageLookup.clear();
+    m_stats = PagingStats();
+}
+
+// Bytes for the resident nodes and the page cache together. Shrinking the budget evicts
+// the least recently used pages right away.
+inline void PagedOctree::SetMemoryBudget(size_t memoryBudget) {
+    size_t residentBytes = m_resident.size() * sizeof(FlattenedNode);
+    size_t pageBytes = std::max<size_t>(PageBytes(), 1);
+    m_maxPages = std::max<size_t>(1, (memoryBudget > residentBytes) ? (memoryBudget - residentBytes) / pageBytes : 0);
+    while (m_pages.size() > m_maxPages) {
+        m_pageLookup.erase(m_pages.back().index);
+        m_pages.pop_back();
+        m_stats.evictions++;
+    }
+}
+
+// The node at index, faulting its page in when needed. The reference stays valid until
+// the next call that reads a node.
+inline const FlattenedNode& PagedOctree::Node(size_t index) {
+    if (index < m_resident.size()) {
+        return m_resident[index];
+    }
+    if (index >= NodeCount()) {
+        return m_empty;
+    }
+    size_t paged = index - m_resident.size();
+    const FlattenedNode* page = FetchPage(paged / m_header.pageNodes);
+    return page ? page[paged % m_header.pageNodes] : m_empty;
+}
+
+// Looks the page up in the cache, moving it to the front, or reads it from the file into
+// the buffer of the least recently used page once the cache is full.
+inline const FlattenedNode* PagedOctree::FetchPage(size_t page) {
+    m_stats.accesses++;
+    auto found = m_pageLookup.find(page);
+    if (found != m_pageLookup.end()) {
+        m_stats.hits++;
+        m_pages.splice(m_pages.begin(), m_pages, found->second);
+        return m_pages.front().nodes.data();
+    }
+
+    m_stats.faults++;
+    if (m_pages.size() >= m_maxPages) {
+        m_pageLookup.erase(m_pages.back().index);
+        m_pages.splice(m_pages.begin(), m_pages, std::prev(m_pages.end()));
+        m_stats.evictions++;
+    } else {
+        m_pages.emplace_front();
+        m_pages.front().nodes.resize(m_header.pageNodes);
+    }
+    Page& entry = m_pages.front();
+    entry.index = page;
+    uint64_t offset = m_header.sections[0].offset + (m_header.residentNodes + page * m_header.pageNodes) * sizeof(FlattenedNode);
+    m_file.seekg(static_cast<std::streamoff>(offset));
+    if (!m_file.read(reinterpret_cast<char*>(entry.nodes.data()), PageBytes())) {
+        std::cout << "Failed to read page " << page << " of " << m_path << std::endl;
+        m_file.clear();
+        m_pages.pop_front();
+        return nullptr;
+    }
+    m_stats.bytesRead += PageBytes();
+    m_pageLookup[page] = m_pages.begin();
+    return entry.nodes.data();
+}
+
+// Same lookup as SparseVoxelOctree::Get, one node read per level.
+inline bool PagedOctree::Get(glm::ivec3 point, glm::vec4& color) {
+    if (!m_file.is_open()) {
+        return false;
+    }
+    const FlattenedNode* node = &Node(0);
+    glm::ivec3 position(0);
+    for (int depth = 0; !node->IsLeaf; depth++) {
+        if (depth == m_header.maxDepth) {
+            return false;
+        }
+        int half = m_halfSizes[depth];
+        glm::ivec3 center = position + glm::ivec3(half);
+        glm::ivec3 childPos(point.x >= center.x ? 1 : 0, point.y >= center.y ? 1 : 0, point.z >= center.z ? 1 : 0);
+        position += childPos * glm::ivec3(half);
+        int child = node->childIndices[(childPos.x << 2) | (childPos.y << 1) | childPos.z];
+        if (child == -1) {
+            return false;
+        }
+        node = &Node(static_cast<size_t>(child));
+    }
+    color = node->color;
+    return true;
+}
+
+#endif
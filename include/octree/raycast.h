@@ -0,0 +1,223 @@
+#ifndef RAYCAST_H
+#define RAYCAST_H
+
+#include <glm/glm.hpp>
+#include <octree/octree.h>
+#include <octree/succinct.h>
+#include <octree/paged_octree.h>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+// CPU version of traverseOctree in compute.glsl, for checking node layouts and timing
+// traversal without a GL context. Views hide the layout: child() returns a child's node
+// index (or -1) and sets leaf when the parent already knows the child is a leaf, and
+// isLeaf() decides on pop given that flag. Nodes that are bricks are marched by
+// traceBrick() instead of being subdivided.
+
+bool traceBrick(const CompactOctree& octree, uint32_t brickIndex, glm::vec3 ro, glm::vec3 rd,
+                glm::vec3 brickMin, glm::vec3 brickMax, float tEnter, glm::vec4& color);
+
+struct FlattenedView {
+    const std::vector<FlattenedNode>& nodes;
+
+    bool isLeaf(int index, bool /*knownLeaf*/) const { return nodes[index].IsLeaf; }
+    bool isBrick(int /*index*/) const { return false; }
+    bool traceBrick(int /*index*/, glm::vec3 /*ro*/, glm::vec3 /*rd*/, glm::vec3 /*nodeMin*/, glm::vec3 /*nodeMax*/,
+                    float /*tEnter*/, glm::vec4& /*hitColor*/) const { return false; }
+    int child(int index, int slot, bool& leaf) const {
+        leaf = false;
+        return nodes[index].childIndices[slot];
+    }
+    glm::vec4 color(int index) const { return nodes[index].color; }
+};
+
+struct CompactView {
+    const CompactOctree& octree;
+
+    bool isLeaf(int /*index*/, bool knownLeaf) const { return knownLeaf; }
+    bool isBrick(int index) const { return (octree.nodes[index].flags & CompactNode::BRICK) != 0; }
+    bool traceBrick(int index, glm::vec3 ro, glm::vec3 rd, glm::vec3 nodeMin, glm::vec3 nodeMax,
+                    float tEnter, glm::vec4& hitColor) const {
+        return ::traceBrick(octree, octree.nodes[index].firstChild, ro, rd, nodeMin, nodeMax, tEnter, hitColor);
+    }
+    int child(int index, int slot, bool& leaf) const {
+        const CompactNode& node = octree.nodes[index];
+        if (!(node.childMask & (1 << slot))) {
+            return -1;
+        }
+        leaf = (node.leafMask >> slot) & 1;
+        return static_cast<int>(node.firstChild) + popCount(node.childMask & ((1u << slot) - 1));
+    }
+    glm::vec4 color(int index) const { return octree.nodeColor(index); }
+};
+
+struct SuccinctView {
+    const SuccinctOctree& octree;
+
+    bool isLeaf(int index, bool /*knownLeaf*/) const { return octree.IsLeaf(index); }
+    bool isBrick(int /*index*/) const { return false; }
+    bool traceBrick(int /*index*/, glm::vec3 /*ro*/, glm::vec3 /*rd*/, glm::vec3 /*nodeMin*/, glm::vec3 /*nodeMax*/,
+                    float /*tEnter*/, glm::vec4& /*hitColor*/) const { return false; }
+    int child(int index, int slot, bool& leaf) const {
+        leaf = false;
+        return octree.Child(index, slot);
+    }
+    glm::vec4 color(int index) const { return octree.Color(index); }
+};
+
+// Faults pages in as the ray reaches them, so the octree cannot be const.
+struct PagedView {
+    PagedOctree& octree;
+
+    bool isLeaf(int index, bool /*knownLeaf*/) const { return octree.Node(index).IsLeaf; }
+    bool isBrick(int /*index*/) const { return false; }
+    bool traceBrick(int /*index*/, glm::vec3 /*ro*/, glm::vec3 /*rd*/, glm::vec3 /*nodeMin*/, glm::vec3 /*nodeMax*/,
+                    float /*tEnter*/, glm::vec4& /*hitColor*/) const { return false; }
+    int child(int index, int slot, bool& leaf) const {
+        leaf = false;
+        return octree.Node(index).childIndices[slot];
+    }
+    glm::vec4 color(int index) const { return octree.Node(index).color; }
+};
+
+inline bool intersectAABB(glm::vec3 ro, glm::vec3 rd, glm::vec3 boxMin, glm::vec3 boxMax, float& tEnter, float& tExit) {
+    glm::vec3 t1 = (boxMin - ro) / rd;
+    glm::vec3 t2 = (boxMax - ro) / rd;
+    glm::vec3 tmin = glm::min(t1, t2);
+    glm::vec3 tmax = glm::max(t1, t2);
+    tEnter = glm::max(glm::max(tmin.x, tmin.y), tmin.z);
+    tExit  = glm::min(glm::min(tmax.x, tmax.y), tmax.z);
+    return (tEnter <= tExit && tExit > 0.0f);
+}
+
+// Marches a ray through the voxels of a brick spanning [brickMin, brickMax] with a 3D DDA,
+// starting where it enters the brick. Returns true and the voxel color on a hit.
+inline bool traceBrick(const CompactOctree& octree, uint32_t brickIndex, glm::vec3 ro, glm::vec3 rd,
+                glm::vec3 brickMin, glm::vec3 brickMax, float tEnter, glm::vec4& color) {
+    int size = octree.brickSize;
+    const uint32_t* brick = &octree.bricks[static_cast<size_t>(brickIndex) * octree.brickStride()];
+    glm::vec3 cellSize = (brickMax - brickMin) / static_cast<float>(size);
+    glm::vec3 entry = ro + rd * std::max(tEnter, 0.0f);
+    glm::ivec3 cell = glm::clamp(glm::ivec3(glm::floor((entry - brickMin) / cellSize)), glm::ivec3(0), glm::ivec3(size - 1));
+
+    glm::ivec3 step;
+    glm::vec3 tMax, tDelta;
+    for (int axis = 0; axis < 3; axis++) {
+        step[axis] = (rd[axis] > 0.0f) ? 1 : -1;
+        if (rd[axis] == 0.0f) {
+            tMax[axis] = tDelta[axis] = std::numeric_limits<float>::infinity();
+            continue;
+        }
+        float boundary = brickMin[axis] + (cell[axis] + (step[axis] > 0 ? 1 : 0)) * cellSize[axis];
+        tMax[axis] = (boundary - ro[axis]) / rd[axis];
+        tDelta[axis] = cellSize[axis] / std::abs(rd[axis]);
+    }
+
+    while (true) {
+        int voxel = (cell.x * size + cell.y) * size + cell.z;
+        if (brick[voxel / 32] & (1u << (voxel % 32))) {
+            color = octree.brickColor(brickColorIndex(brick, size, voxel));
+            return true;
+        }
+        int axis = (tMax.x < tMax.y) ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+        cell[axis] += step[axis];
+        if (cell[axis] < 0 || cell[axis] >= size) {
+            return false;
+        }
+        tMax[axis] += tDelta[axis];
+    }
+}
+
+// Returns the color of the first leaf hit, or vec4(0) on a miss. A lodScale above 0 stops
+// at nodes smaller than lodScale * distance, like the shader's uniform of the same name.
+// rootIndex is the node spanning [minBound, maxBound], for views holding several trees.
+template <typename View>
+glm::vec4 raycastOctree(const View& view, glm::vec3 ro, glm::vec3 rd, glm::vec3 minBound, glm::vec3 maxBound,
+                        float lodScale = 0.0f, int rootIndex = 0) {
+    const float MAX_DIST = 1000.0f;
+    const int MAX_STACK_SIZE = 64;
+
+    struct StackEntry {
+        int nodeIndex;
+        bool isLeaf;
+        glm::vec3 nodeMin;
+        glm::vec3 nodeMax;
+        float tEnter;
+    };
+
+    float tEnterRoot, tExitRoot;
+    if (!intersectAABB(ro, rd, minBound, maxBound, tEnterRoot, tExitRoot)) {
+        return glm::vec4(0.0f);
+    }
+
+    StackEntry stack[MAX_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = {rootIndex, false, minBound, maxBound, tEnterRoot};
+
+    float bestT = MAX_DIST;
+    glm::vec4 hitColor(0.0f);
+
+    while (stackSize > 0) {
+        // Closest entry first, exactly like the shader.
+        int bestIndex = 0;
+        for (int i = 1; i < stackSize; i++) {
+            if (stack[i].tEnter < stack[bestIndex].tEnter) {
+                bestIndex = i;
+            }
+        }
+        StackEntry entry = stack[bestIndex];
+        stack[bestIndex] = stack[stackSize - 1];
+        stackSize--;
+
+        if (entry.tEnter > bestT) {
+            continue;
+        }
+        if (view.isLeaf(entry.nodeIndex, entry.isLeaf)) {
+            hitColor = view.color(entry.nodeIndex);
+            bestT = entry.tEnter;
+            break;
+        }
+        if (lodScale > 0.0f && entry.nodeMax.x - entry.nodeMin.x < lodScale * entry.tEnter) {
+            hitColor = view.color(entry.nodeIndex);
+            break;
+        }
+        // Boxes along a ray do not overlap, so a voxel hit inside the closest brick is final.
+        if (view.isBrick(entry.nodeIndex)) {
+            if (view.traceBrick(entry.nodeIndex, ro, rd, entry.nodeMin, entry.nodeMax, entry.tEnter, hitColor)) {
+                break;
+            }
+            continue;
+        }
+
+        glm::vec3 center = (entry.nodeMin + entry.nodeMax) * 0.5f;
+        for (int child = 0; child < 8; child++) {
+            bool childLeaf;
+            int childNodeIndex = view.child(entry.nodeIndex, child, childLeaf);
+            if (childNodeIndex == -1) {
+                continue;
+            }
+            glm::vec3 childMin, childMax;
+            int bx = (child >> 2) & 1;
+            int by = (child >> 1) & 1;
+            int bz = child & 1;
+            childMin.x = (bx == 0) ? entry.nodeMin.x : center.x;
+            childMax.x = (bx == 0) ? center.x : entry.nodeMax.x;
+            childMin.y = (by == 0) ? entry.nodeMin.y : center.y;
+            childMax.y = (by == 0) ? center.y : entry.nodeMax.y;
+            childMin.z = (bz == 0) ? entry.nodeMin.z : center.z;
+            childMax.z = (bz == 0) ? center.z : entry.nodeMax.z;
+
+            float tChildEnter, tChildExit;
+            if (intersectAABB(ro, rd, childMin, childMax, tChildEnter, tChildExit)) {
+                if (tChildEnter < bestT && stackSize < MAX_STACK_SIZE) {
+                    stack[stackSize++] = {childNodeIndex, childLeaf, childMin, childMax, tChildEnter};
+                }
+            }
+        }
+    }
+    return hitColor;
+}
+
+#endif
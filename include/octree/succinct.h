@@ -0,0 +1,246 @@
+#ifndef SUCCINCT_H
+#define SUCCINCT_H
+
+#include <glm/glm.hpp>
+#include <octree/octree.h>
+#include <octree/bitstream.h>
+#include <vector>
+#include <iostream>
+#include <cmath>
+#include <cstdint>
+
+// Bit vector with constant time rank and logarithmic select. Every block of 512 bits keeps
+// the number of set bits before it, which costs 1/16 of a bit per bit. Counts are 32-bit,
+// so a vector holds at most 2^32 set bits.
+class RankBitVector {
+public:
+    static const size_t BLOCK_WORDS = 8;
+
+    void Build(std::vector<uint64_t> words, size_t bits);
+    bool Get(size_t i) const { return (m_words[i / 64] >> (i % 64)) & 1; }
+    size_t Rank(size_t i) const;
+    size_t Select(size_t k) const;
+    size_t Ones() const { return m_ones; }
+    size_t Bits() const { return m_bits; }
+    size_t Bytes() const { return m_words.size() * sizeof(uint64_t) + m_blockRanks.size() * sizeof(uint32_t); }
+private:
+    std::vector<uint64_t> m_words;
+    std::vector<uint32_t> m_blockRanks;
+    size_t m_bits = 0;
+    size_t m_ones = 0;
+};
+
+inline void RankBitVector::Build(std::vector<uint64_t> words, size_t bits) {
+    m_words = std::move(words);
+    m_words.resize((bits + 63) / 64 + 1, 0); // one spare word so Rank(bits) never reads past the end
+    m_bits = bits;
+    m_blockRanks.assign((m_words.size() + BLOCK_WORDS - 1) / BLOCK_WORDS, 0);
+    size_t ones = 0;
+    for (size_t w = 0; w < m_words.size(); w++) {
+        if (w % BLOCK_WORDS == 0) {
+            m_blockRanks[w / BLOCK_WORDS] = static_cast<uint32_t>(ones);
+        }
+        ones += popCount(m_words[w]);
+    }
+    m_ones = ones;
+}
+
+// Number of set bits in [0, i).
+inline size_t RankBitVector::Rank(size_t i) const {
+    size_t word = i / 64;
+    size_t rank = m_blockRanks[word / BLOCK_WORDS];
+    for (size_t w = word - word % BLOCK_WORDS; w < word; w++) {
+        rank += popCount(m_words[w]);
+    }
+    return rank + popCount(m_words[word] & ((uint64_t(1) << (i % 64)) - 1));
+}
+
+// Position of the set bit with rank k, counting from 0. k must be below Ones().
+inline size_t RankBitVector::Select(size_t k) const {
+    size_t lo = 0;
+    size_t hi = m_blockRanks.size() - 1;
+    while (lo < hi) { // last block starting with at most k set bits before it
+        size_t mid = (lo + hi + 1) / 2;
+        if (m_blockRanks[mid] <= k) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    size_t remaining = k - m_blockRanks[lo];
+    for (size_t w = lo * BLOCK_WORDS; w < m_words.size(); w++) {
+        size_t ones = popCount(m_words[w]);
+        if (remaining < ones) {
+            uint64_t bits = m_words[w];
+            for (; remaining > 0; remaining--) {
+                bits &= bits - 1;
+            }
+            int bit = 0;
+            while (!((bits >> bit) & 1)) {
+                bit++;
+            }
+            return w * 64 + bit;
+        }
+        remaining -= ones;
+    }
+    return m_bits;
+}
+
+// Read-only octree that answers queries directly on the breadth-first child masks of an
+// OctreeBitstream, without rebuilding the node array. The masks form one bit vector with
+// bit 8 * node + slot set for each child, so in breadth-first order child slot of node
+// sits at 1 + Rank(8 * node + slot) and the parent of a node is Select(node - 1) / 8. A
+// second bit vector marks coarse leaves (mask 0 above maxDepth) so leaves can be counted.
+// Colors are kept as palette indices of colorBits bits each, indexed like the bitstream's
+// color stream: by node, or by leaf when the stream was filtered. Filtered streams have no
+// interior colors; Color() then returns the color of the node's first leaf.
+class SuccinctOctree {
+public:
+    explicit SuccinctOctree(const OctreeBitstream& stream);
+    bool Get(glm::ivec3 point, glm::vec4& color) const;
+    bool IsLeaf(size_t node) const;
+    int Child(size_t node, int slot) const;
+    size_t Parent(size_t node) const { return m_children.Select(node - 1) / 8; }
+    glm::vec4 Color(size_t node) const;
+    size_t NodeCount() const { return m_nodeCount; }
+    size_t Bytes() const;
+private:
+    size_t ColorEntry(size_t node) const;
+
+    int m_size;
+    int m_maxDepth;
+    std::vector<int> m_halfSizes;   // same truncation as SparseVoxelOctree
+    size_t m_nodeCount;
+    size_t m_maskCount;             // nodes above maxDepth, the first ones in breadth-first order
+    bool m_filtered;
+    RankBitVector m_children;
+    RankBitVector m_coarseLeaves;
+    int m_colorBits = 0;
+    std::vector<uint64_t> m_colorIndices;
+    std::vector<glm::vec4> m_palette;
+};
+
+inline SuccinctOctree::SuccinctOctree(const OctreeBitstream& stream)
+    : m_size(stream.size), m_maxDepth(stream.maxDepth), m_nodeCount(stream.nodeCount),
+      m_maskCount(stream.masks.size()), m_filtered(stream.filtered), m_palette(stream.palette) {
+    if (!stream.Validate()) {
+        std::cout << "Bitstream masks and colors do not describe one tree" << std::endl;
+        m_nodeCount = 0; // answers every query as empty
+        m_maskCount = 0;
+        m_palette.clear();
+        m_children.Build({}, 0);
+        m_coarseLeaves.Build({}, 0);
+        return;
+    }
+    for (int depth = 0; depth < m_maxDepth; depth++) {
+        m_halfSizes.push_back(static_cast<int>(m_size / std::exp2(depth) / 2.0f));
+    }
+    std::vector<uint64_t> children((m_maskCount + 7) / 8, 0);
+    std::vector<uint64_t> coarse((m_maskCount + 63) / 64, 0);
+    for (size_t i = 0; i < m_maskCount; i++) {
+        children[i / 8] |= static_cast<uint64_t>(stream.masks[i]) << (8 * (i % 8));
+        if (stream.masks[i] == 0) {
+            coarse[i / 64] |= uint64_t(1) << (i % 64);
+        }
+    }
+    m_children.Build(std::move(children), 8 * m_maskCount);
+    m_coarseLeaves.Build(std::move(coarse), m_maskCount);
+
+    while ((size_t(1) << m_colorBits) < m_palette.size()) {
+        m_colorBits++;
+    }
+    m_colorIndices.assign((stream.colorCount * m_colorBits + 63) / 64 + 1, 0);
+    int bits = m_colorBits;
+    decodeColorIndices(stream, [&](uint64_t i, uint32_t index) {
+        uint64_t bit = i * bits;
+        m_colorIndices[bit / 64] |= static_cast<uint64_t>(index) << (bit % 64);
+        if (bit % 64 + bits > 64) {
+            m_colorIndices[bit / 64 + 1] |= static_cast<uint64_t>(index) >> (64 - bit % 64);
+        }
+    });
+}
+
+inline bool SuccinctOctree::IsLeaf(size_t node) const {
+    if (m_nodeCount == 0) {
+        return false;
+    }
+    return node >= m_maskCount || m_coarseLeaves.Get(node);
+}
+
+// Node index of child slot of node, or -1 when it has none.
+inline int SuccinctOctree::Child(size_t node, int slot) const {
+    if (node >= m_maskCount) {
+        return -1;
+    }
+    size_t bit = 8 * node + slot;
+    if (!m_children.Get(bit)) {
+        return -1;
+    }
+    return static_cast<int>(1 + m_children.Rank(bit));
+}
+
+// Index into the color entries: every node in breadth-first order, or only the leaves
+// when filtered. Leaves are the coarse leaves followed by every node at maxDepth.
+inline size_t SuccinctOctree::ColorEntry(size_t node) const {
+    if (!m_filtered) {
+        return node;
+    }
+    if (node < m_maskCount) {
+        return m_coarseLeaves.Rank(node);
+    }
+    return m_coarseLeaves.Ones() + (node - m_maskCount);
+}
+
+inline glm::vec4 SuccinctOctree::Color(size_t node) const {
+    if (m_palette.empty()) {
+        return glm::vec4(1.0f);
+    }
+    if (m_filtered) {
+        while (!IsLeaf(node)) {
+            int slot = 0;
+            while (Child(node, slot) == -1) {
+                slot++;
+            }
+            node = Child(node, slot);
+        }
+    }
+    uint64_t bit = ColorEntry(node) * m_colorBits;
+    uint64_t value = m_colorIndices[bit / 64] >> (bit % 64);
+    if (bit % 64 + m_colorBits > 64) {
+        value |= m_colorIndices[bit / 64 + 1] << (64 - bit % 64);
+    }
+    size_t index = static_cast<size_t>(value & ((uint64_t(1) << m_colorBits) - 1));
+    return m_palette[std::min(index, m_palette.size() - 1)];
+}
+
+// Same lookup as SparseVoxelOctree::Get, one rank per level.
+inline bool SuccinctOctree::Get(glm::ivec3 point, glm::vec4& color) const {
+    if (m_nodeCount == 0) {
+        return false;
+    }
+    size_t node = 0;
+    glm::ivec3 position(0);
+    for (int depth = 0; !IsLeaf(node); depth++) {
+        if (depth == m_maxDepth) {
+            return false;
+        }
+        int half = m_halfSizes[depth];
+        glm::ivec3 center = position + glm::ivec3(half);
+        glm::ivec3 childPos(point.x >= center.x ? 1 : 0, point.y >= center.y ? 1 : 0, point.z >= center.z ? 1 : 0);
+        position += childPos * glm::ivec3(half);
+        int child = Child(node, (childPos.x << 2) | (childPos.y << 1) | childPos.z);
+        if (child == -1) {
+            return false;
+        }
+        node = static_cast<size_t>(child);
+    }
+    color = Color(node);
+    return true;
+}
+
+inline size_t SuccinctOctree::Bytes() const {
+    return m_children.Bytes() + m_coarseLeaves.Bytes() + m_colorIndices.size() * sizeof(uint64_t) +
+           m_palette.size() * sizeof(glm::vec4);
+}
+
+#endif
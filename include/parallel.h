@@ -0,0 +1,36 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+// Number of worker threads to use when the caller does not care.
+inline int defaultThreadCount() {
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+// Runs fn(job) for every job in [0, jobCount) on up to threadCount workers that pull
+// jobs from a shared counter, and returns once all of them are done. The calling thread
+// works too, so threadCount == 1 runs everything inline.
+template <typename Fn>
+void parallelFor(int jobCount, int threadCount, Fn fn) {
+    std::atomic<int> nextJob(0);
+    auto worker = [&]() {
+        for (int job = nextJob++; job < jobCount; job = nextJob++) {
+            fn(job);
+        }
+    };
+    int extraThreads = std::min(threadCount, jobCount) - 1;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < extraThreads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+#endif
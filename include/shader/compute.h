@@ -15,7 +15,7 @@ public:
     void use();
     void dispatch(GLuint x, GLuint y = 1, GLuint z = 1);
     void setSSBO(GLuint binding, GLuint ssbo);
-    void createSSBO(GLuint& ssbo, GLuint binding, size_t size, void* data = nullptr, GLenum usage = GL_DYNAMIC_DRAW);
+    void createSSBO(GLuint& ssbo, GLuint binding, size_t size, const void* data = nullptr, GLenum usage = GL_DYNAMIC_DRAW);
     void getSSBOData(GLuint ssbo, size_t size, void* outputBuffer);
 
     void setBool(const std::string &name, bool value) const {
@@ -42,6 +42,10 @@ public:
         //glUseProgram(0);
     }
 
+    void setIVec3(const std::string &name, const glm::ivec3 &value) const {
+        glUniform3iv(glGetUniformLocation(programID, name.c_str()), 1, &value[0]);
+    }
+
     void setVec2(const std::string &name, float x, float y) const
     {
         glUniform2f(glGetUniformLocation(programID, name.c_str()), x, y);
@@ -96,7 +100,7 @@ void ComputeShader::setSSBO(GLuint binding, GLuint ssbo) {
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, ssbo);
 }
 
-void ComputeShader::createSSBO(GLuint& ssbo, GLuint binding, size_t size, void* data, GLenum usage) {
+void ComputeShader::createSSBO(GLuint& ssbo, GLuint binding, size_t size, const void* data, GLenum usage) {
     glGenBuffers(1, &ssbo);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
     glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, usage);
@@ -0,0 +1,192 @@
+#ifndef DENSITY_H
+#define DENSITY_H
+
+#include <glm/glm.hpp>
+#include <fastnoise/fastnoise.h>
+#include <octree/octree.h>
+#include <terrain/terrain.h>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+// Ground with caves and overhangs, which a heightfield can't hold: the density at p is
+// groundHeight - p.y + amplitude * noise(p), solid where it is above zero, with the noise
+// one of FastNoise's 3D Value, Perlin or Simplex types, fractal or not. Bounds over a box
+// take each octave at the box's center and widen it by the most that octave can change
+// across the box, clamped to the range it can reach at all, then shape and weight the
+// octaves the way the fractal type does. Low octaves stay tight while high ones fall back
+// to their range, and neither is ever wrong. Other noise types get unbounded intervals and
+// every cell is sampled.
+class DensityTerrain {
+public:
+    DensityTerrain(const FastNoise& noise, float groundHeight, float amplitude);
+    float Density(glm::vec3 p) const;
+    void Sample(glm::vec3 origin, glm::ivec3 size, float step, float* densities) const;
+    void Bounds(glm::vec3 lo, glm::vec3 hi, float& minDensity, float& maxDensity) const;
+    DensityField Field(int octreeSize, int maxDepth) const;
+private:
+    FastNoise m_noise;
+    float m_groundHeight;
+    float m_amplitude;
+    bool m_bounded;                     // the noise type has known octave limits
+    float m_range;                      // every octave lies in [-m_range, m_range]
+    float m_jump;                       // what an octave can change by over no distance at all
+    std::vector<float> m_octaveWeights; // of each shaped octave in the sum
+    std::vector<float> m_octaveSlopes;  // most each octave changes per world unit along one axis
+};
+
+inline DensityTerrain::DensityTerrain(const FastNoise& noise, float groundHeight, float amplitude)
+    : m_noise(noise), m_groundHeight(groundHeight), m_amplitude(std::max(0.0f, amplitude)),
+      m_bounded(true), m_range(0.0f), m_jump(0.0f) {
+    // Range and slope of one octave in its own coordinates: the largest value and derivative
+    // along an axis over a lattice cell, with every corner's gradient picked to make it as
+    // large as it can be, found numerically and rounded up.
+    FastNoise::Interp interp = noise.GetInterp();
+    float slope = 0.0f;
+    bool fractal = false;
+    switch (noise.GetNoiseType()) {
+    case FastNoise::ValueFractal:
+        fractal = true;
+        // fall through
+    case FastNoise::Value:
+        // Corner values in [-1, 1]; along an axis only the fade between two of them moves,
+        // at most 1, 1.5 or 1.875 per unit.
+        m_range = 1.0f;
+        slope = (interp == FastNoise::Linear) ? 2.0f : (interp == FastNoise::Hermite ? 3.0f : 3.75f);
+        break;
+    case FastNoise::PerlinFractal:
+        fractal = true;
+        // fall through
+    case FastNoise::Perlin:
+        m_range = 1.08f;
+        slope = (interp == FastNoise::Linear) ? 3.2f : (interp == FastNoise::Hermite ? 3.1f : 3.85f);
+        break;
+    case FastNoise::SimplexFractal:
+        fractal = true;
+        // fall through
+    case FastNoise::Simplex:
+        // A corner 1/sqrt(2) away can still reach past its simplex, so crossing into the
+        // next one jumps by up to twice the 32 * 0.1^4 * |g . d| such a corner adds. A path
+        // of length l (in L1) crosses at most 4 l + 6 simplex faces: l + 1 per skewed axis
+        // and per difference of two axes.
+        m_range = 1.01f;
+        m_jump = 6.0f * 0.0064f;
+        slope = 6.5f + 4.0f * 0.0064f;
+        break;
+    default:
+        m_bounded = false;
+        return;
+    }
+
+    // FBM and billow sums are scaled by the fractal bounding, rigid multi sums are not.
+    int octaves = fractal ? std::max(1, noise.GetFractalOctaves()) : 1;
+    double amp = 1.0, ampSum = 0.0;
+    for (int i = 0; i < octaves; i++) {
+        ampSum += amp;
+        amp *= noise.GetFractalGain();
+    }
+    bool rigid = fractal && noise.GetFractalType() == FastNoise::RigidMulti;
+    double bounding = (fractal && !rigid) ? 1.0 / ampSum : 1.0;
+    double frequency = std::abs(noise.GetFrequency());
+    amp = 1.0;
+    for (int i = 0; i < octaves; i++) {
+        m_octaveWeights.push_back(static_cast<float>(amp * bounding));
+        m_octaveSlopes.push_back(static_cast<float>(slope * frequency));
+        amp *= noise.GetFractalGain();
+        frequency *= std::abs(noise.GetFractalLacunarity());
+    }
+}
+
+inline float DensityTerrain::Density(glm::vec3 p) const {
+    return m_groundHeight - p.y + m_amplitude * m_noise.GetNoise(p.x, p.y, p.z);
+}
+
+// Densities at origin + (x, y, z) * step, stored at densities[(x * size.y + y) * size.z + z].
+inline void DensityTerrain::Sample(glm::vec3 origin, glm::ivec3 size, float step, float* densities) const {
+    m_noise.FillNoiseSet(densities, origin.x, origin.y, origin.z, size.x, size.y, size.z, step);
+    for (int x = 0; x < size.x; x++) {
+        for (int y = 0; y < size.y; y++) {
+            float height = m_groundHeight - (origin.y + y * step);
+            float* row = densities + (static_cast<size_t>(x) * size.y + y) * size.z;
+            for (int z = 0; z < size.z; z++) {
+                row[z] = height + m_amplitude * row[z];
+            }
+        }
+    }
+}
+
+// An interval holding the density at every point of the box [lo, hi].
+inline void DensityTerrain::Bounds(glm::vec3 lo, glm::vec3 hi, float& minDensity, float& maxDensity) const {
+    const float infinity = std::numeric_limits<float>::infinity();
+    if (!m_bounded) {
+        minDensity = -infinity;
+        maxDensity = infinity;
+        return;
+    }
+    glm::vec3 center = (lo + hi) * 0.5f;
+    glm::vec3 half = (hi - lo) * 0.5f;
+    float distance = half.x + half.y + half.z;
+    std::vector<FN_DECIMAL> octaves(m_octaveWeights.size());
+    m_noise.GetOctaveNoise(center.x, center.y, center.z, octaves.data());
+
+    bool fractal = m_noise.GetNoiseType() == FastNoise::ValueFractal || m_noise.GetNoiseType() == FastNoise::PerlinFractal ||
+                   m_noise.GetNoiseType() == FastNoise::SimplexFractal;
+    FastNoise::FractalType fractalType = m_noise.GetFractalType();
+    float noiseMin = 0.0f, noiseMax = 0.0f;
+    for (size_t i = 0; i < octaves.size(); i++) {
+        float reach = m_octaveSlopes[i] * distance + m_jump + 1e-4f; // and some slack for rounding
+        float low = std::max(-m_range, static_cast<float>(octaves[i]) - reach);
+        float high = std::min(m_range, static_cast<float>(octaves[i]) + reach);
+        if (low > high) {
+            low = -m_range;
+            high = m_range;
+        }
+        if (fractal && fractalType != FastNoise::FBM) {
+            // Billow adds |n| * 2 - 1, rigid multi 1 - |n| first and |n| - 1 after.
+            float absLow = (low > 0.0f) ? low : (high < 0.0f ? -high : 0.0f);
+            float absHigh = std::max(std::abs(low), std::abs(high));
+            if (fractalType == FastNoise::Billow) {
+                low = absLow * 2.0f - 1.0f;
+                high = absHigh * 2.0f - 1.0f;
+            } else if (i == 0) {
+                low = 1.0f - absHigh;
+                high = 1.0f - absLow;
+            } else {
+                low = absLow - 1.0f;
+                high = absHigh - 1.0f;
+            }
+        }
+        float weight = m_octaveWeights[i];
+        noiseMin += std::min(weight * low, weight * high);
+        noiseMax += std::max(weight * low, weight * high);
+    }
+
+    float slack = 1e-5f * (std::abs(m_groundHeight) + std::max(std::abs(lo.y), std::abs(hi.y)) +
+                           m_amplitude * std::max(std::abs(noiseMin), std::abs(noiseMax)));
+    minDensity = m_groundHeight - hi.y + m_amplitude * noiseMin - slack;
+    maxDensity = m_groundHeight - lo.y + m_amplitude * noiseMax + slack;
+}
+
+// The terrain over the cells of an octree of the given size and depth, one cell per leaf
+// as in generateTerrainHeightfield, colored rock below groundHeight through ice to snow
+// halfway up the noise. The field calls back into this terrain, which must outlive it.
+inline DensityField DensityTerrain::Field(int octreeSize, int maxDepth) const {
+    DensityField field;
+    field.cellSize = std::max(1, octreeSize / (1 << maxDepth));
+    int layers = (octreeSize + field.cellSize - 1) / field.cellSize;
+    for (int yi = 0; yi < layers; yi++) {
+        field.layerColors.push_back(terrainColor(static_cast<float>(yi * field.cellSize), m_groundHeight,
+                                                 m_groundHeight + 0.5f * m_amplitude));
+    }
+    float cellSize = static_cast<float>(field.cellSize);
+    field.sample = [this, cellSize](glm::ivec3 lo, glm::ivec3 size, float* densities) {
+        Sample(glm::vec3(lo) * cellSize, size, cellSize, densities);
+    };
+    field.bounds = [this, cellSize](glm::ivec3 lo, glm::ivec3 hi, float& minDensity, float& maxDensity) {
+        Bounds(glm::vec3(lo) * cellSize, glm::vec3(hi - glm::ivec3(1)) * cellSize, minDensity, maxDensity);
+    };
+    return field;
+}
+
+#endif
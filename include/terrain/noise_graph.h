@@ -0,0 +1,541 @@
+#ifndef NOISE_GRAPH_H
+#define NOISE_GRAPH_H
+
+#include <fastnoise/fastnoise.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include <iostream>
+
+// Terrain noise made of several FastNoise generators and math nodes, e.g. warped continents
+// plus ridges plus cellular caves. Compile() flattens the graph into a list of instructions
+// over block-sized registers, and Evaluate runs that list one block of points at a time, so
+// a chunk is one pass over its points rather than one pass per noise layer, and every
+// generator samples a whole block through FastNoiseKernel::GetNoiseSet.
+// Needs include/fastnoise/fastnoise.cpp built alongside.
+
+// A value of the graph, one float per sample point.
+struct NoiseNode {
+    int id = -1;
+};
+
+// Where a generator samples: 3D at (x, y, z), or 2D at (x, y) when z is unset.
+struct NoiseDomain {
+    NoiseNode x;
+    NoiseNode y;
+    NoiseNode z;
+};
+
+class NoiseGraph {
+public:
+    NoiseGraph();
+
+    // The coordinates of the point being evaluated.
+    NoiseNode X() const { return NoiseNode{0}; }
+    NoiseNode Y() const { return NoiseNode{1}; }
+    NoiseNode Z() const { return NoiseNode{2}; }
+    NoiseDomain Domain3D() const { return NoiseDomain{X(), Y(), Z()}; }
+    NoiseDomain DomainXZ() const { return NoiseDomain{X(), Z(), NoiseNode()}; }
+
+    NoiseNode Constant(float value);
+    NoiseNode Add(NoiseNode a, NoiseNode b);
+    NoiseNode Sub(NoiseNode a, NoiseNode b);
+    NoiseNode Mul(NoiseNode a, NoiseNode b);
+    NoiseNode Min(NoiseNode a, NoiseNode b);
+    NoiseNode Max(NoiseNode a, NoiseNode b);
+    NoiseNode ScaleBias(NoiseNode a, float scale, float bias);     // a * scale + bias
+    NoiseNode Abs(NoiseNode a);
+    NoiseNode Clamp(NoiseNode a, float lo, float hi);
+    NoiseNode Lerp(NoiseNode a, NoiseNode b, NoiseNode t);
+    // Piecewise linear through points sorted by x, flat past the first and last.
+    NoiseNode Curve(NoiseNode a, const std::vector<glm::vec2>& points);
+
+    // noise.GetNoise at the domain's point. The graph keeps a copy of noise.
+    NoiseNode Noise(const FastNoise& noise, NoiseDomain domain);
+    // The domain moved by noise.GradientPerturb, or GradientPerturbFractal with fractal set.
+    NoiseDomain Warp(const FastNoise& noise, NoiseDomain domain, bool fractal = false);
+
+    void SetOutput(NoiseNode node) { m_output = node.id; }
+
+    // Must follow the last change to the graph. Folds constants, merges repeated
+    // subexpressions, drops nodes the output does not use and assigns registers.
+    bool Compile();
+    size_t InstructionCount() const { return m_program.size(); }
+    int RegisterCount() const { return m_registerCount; }
+
+    // out[i] is the output at (xs[i], ys[i], zs[i]); zs may be null when nothing samples z.
+    void Evaluate(float* out, const float* xs, const float* ys, const float* zs, int count) const;
+    // The output over size points from origin, step apart, point (x, y, z) stored at
+    // out[(x * size.y + y) * size.z + z] as in FastNoise::FillNoiseSet. Nodes that do not
+    // depend on y, such as 2D height layers, run once per (x, z) column rather than per point.
+    void EvaluateGrid(float* out, glm::vec3 origin, glm::ivec3 size, float step) const;
+
+    static const int BlockSize = 256;
+private:
+    enum class Op { Coordinate, Constant, Add, Sub, Mul, Min, Max, ScaleBias, Abs, Clamp, Lerp, Curve, Noise, Warp, WarpOutput };
+
+    // inputs are node ids, -1 when unused. index is the generator or curve for Noise, Warp
+    // and Curve, the axis for Coordinate and WarpOutput.
+    struct Node {
+        Op op;
+        int inputs[3];
+        float a;
+        float b;
+        int index;
+    };
+
+    // The same fields with registers in place of node ids. A Warp writes its three outputs
+    // to outputs, -1 for those nothing reads. invariant instructions do not depend on y;
+    // slots are where EvaluateGrid keeps the results that y dependent ones read (dest, or a
+    // Warp's outputs), -1 for results nothing else needs.
+    struct Instruction {
+        Op op;
+        int dest;
+        int inputs[3];
+        float a;
+        float b;
+        int index;
+        int outputs[3];
+        bool invariant;
+        int slots[3];
+    };
+
+    // Which instructions Run executes: all of them, only the y invariant ones (storing their
+    // slots), or only the rest (loading the invariant results from their slots).
+    enum class Pass { All, Columns, Points };
+
+    NoiseNode Push(Op op, int in0, int in1 = -1, int in2 = -1, float a = 0.0f, float b = 0.0f, int index = -1);
+    void Run(float* registers, int count, Pass pass = Pass::All, float* slots = nullptr, int slotStride = 0, int slotOffset = 0) const;
+
+    std::vector<Node> m_nodes;
+    std::vector<FastNoise> m_generators;
+    std::vector<std::vector<glm::vec2>> m_curves;
+    int m_output = -1;
+
+    // Compiled state.
+    std::vector<Instruction> m_program;
+    std::vector<std::unique_ptr<FastNoiseKernel>> m_kernels;   // one per generator index used
+    int m_outputRegister = -1;
+    int m_registerCount = 0;
+    int m_slotCount = 0;
+    bool m_hasInvariant = false;
+};
+
+inline NoiseGraph::NoiseGraph() {
+    for (int axis = 0; axis < 3; axis++) {
+        m_nodes.push_back({Op::Coordinate, {-1, -1, -1}, 0.0f, 0.0f, axis});
+    }
+}
+
+inline NoiseNode NoiseGraph::Push(Op op, int in0, int in1, int in2, float a, float b, int index) {
+    m_nodes.push_back({op, {in0, in1, in2}, a, b, index});
+    return NoiseNode{static_cast<int>(m_nodes.size()) - 1};
+}
+
+inline NoiseNode NoiseGraph::Constant(float value) { return Push(Op::Constant, -1, -1, -1, value); }
+inline NoiseNode NoiseGraph::Add(NoiseNode a, NoiseNode b) { return Push(Op::Add, a.id, b.id); }
+inline NoiseNode NoiseGraph::Sub(NoiseNode a, NoiseNode b) { return Push(Op::Sub, a.id, b.id); }
+inline NoiseNode NoiseGraph::Mul(NoiseNode a, NoiseNode b) { return Push(Op::Mul, a.id, b.id); }
+inline NoiseNode NoiseGraph::Min(NoiseNode a, NoiseNode b) { return Push(Op::Min, a.id, b.id); }
+inline NoiseNode NoiseGraph::Max(NoiseNode a, NoiseNode b) { return Push(Op::Max, a.id, b.id); }
+inline NoiseNode NoiseGraph::ScaleBias(NoiseNode a, float scale, float bias) { return Push(Op::ScaleBias, a.id, -1, -1, scale, bias); }
+inline NoiseNode NoiseGraph::Abs(NoiseNode a) { return Push(Op::Abs, a.id); }
+inline NoiseNode NoiseGraph::Clamp(NoiseNode a, float lo, float hi) { return Push(Op::Clamp, a.id, -1, -1, lo, hi); }
+inline NoiseNode NoiseGraph::Lerp(NoiseNode a, NoiseNode b, NoiseNode t) { return Push(Op::Lerp, a.id, b.id, t.id); }
+
+inline NoiseNode NoiseGraph::Curve(NoiseNode a, const std::vector<glm::vec2>& points) {
+    m_curves.push_back(points);
+    return Push(Op::Curve, a.id, -1, -1, 0.0f, 0.0f, static_cast<int>(m_curves.size()) - 1);
+}
+
+inline NoiseNode NoiseGraph::Noise(const FastNoise& noise, NoiseDomain domain) {
+    m_generators.push_back(noise);
+    return Push(Op::Noise, domain.x.id, domain.y.id, domain.z.id, 0.0f, 0.0f, static_cast<int>(m_generators.size()) - 1);
+}
+
+inline NoiseDomain NoiseGraph::Warp(const FastNoise& noise, NoiseDomain domain, bool fractal) {
+    m_generators.push_back(noise);
+    NoiseNode warp = Push(Op::Warp, domain.x.id, domain.y.id, domain.z.id, fractal ? 1.0f : 0.0f, 0.0f,
+                          static_cast<int>(m_generators.size()) - 1);
+    NoiseDomain warped;
+    warped.x = Push(Op::WarpOutput, warp.id, -1, -1, 0.0f, 0.0f, 0);
+    warped.y = Push(Op::WarpOutput, warp.id, -1, -1, 0.0f, 0.0f, 1);
+    if (domain.z.id >= 0) {
+        warped.z = Push(Op::WarpOutput, warp.id, -1, -1, 0.0f, 0.0f, 2);
+    }
+    return warped;
+}
+
+inline float evaluateCurve(const std::vector<glm::vec2>& points, float x) {
+    if (points.empty()) {
+        return x;
+    }
+    if (x <= points.front().x) {
+        return points.front().y;
+    }
+    if (x >= points.back().x) {
+        return points.back().y;
+    }
+    auto upper = std::upper_bound(points.begin(), points.end(), x,
+                                  [](float value, const glm::vec2& point) { return value < point.x; });
+    const glm::vec2& lo = *(upper - 1);
+    const glm::vec2& hi = *upper;
+    return lo.y + (x - lo.x) / (hi.x - lo.x) * (hi.y - lo.y);
+}
+
+inline bool NoiseGraph::Compile() {
+    m_program.clear();
+    m_kernels.clear();
+    m_outputRegister = -1;
+    m_registerCount = 0;
+    m_slotCount = 0;
+    m_hasInvariant = false;
+    int nodeCount = static_cast<int>(m_nodes.size());
+    if (m_output < 0 || m_output >= nodeCount) {
+        std::cout << "NoiseGraph has no output" << std::endl;
+        return false;
+    }
+
+    // Nodes only ever refer to earlier ones, so node order is already an evaluation order.
+    // Fold constants and merge nodes that repeat an earlier one, mapping each node to the
+    // node that stands in for it.
+    std::vector<int> canonical(nodeCount);
+    std::vector<Node> nodes = m_nodes;
+    std::unordered_map<uint64_t, std::vector<int>> seen;
+    for (int id = 0; id < nodeCount; id++) {
+        Node& node = nodes[id];
+        for (int& input : node.inputs) {
+            if (input >= id) {
+                std::cout << "NoiseGraph node " << id << " reads a later node" << std::endl;
+                return false;
+            }
+            input = input >= 0 ? canonical[input] : -1;
+        }
+        const int* in = node.inputs;
+        auto value = [&](int input) { return nodes[input].a; };
+        bool constantInputs = in[0] >= 0 && nodes[in[0]].op == Op::Constant && (in[1] < 0 || nodes[in[1]].op == Op::Constant) &&
+                              (in[2] < 0 || nodes[in[2]].op == Op::Constant);
+        if (constantInputs && node.op != Op::Noise && node.op != Op::Warp && node.op != Op::WarpOutput) {
+            float folded = 0.0f;
+            switch (node.op) {
+            case Op::Add: folded = value(in[0]) + value(in[1]); break;
+            case Op::Sub: folded = value(in[0]) - value(in[1]); break;
+            case Op::Mul: folded = value(in[0]) * value(in[1]); break;
+            case Op::Min: folded = std::min(value(in[0]), value(in[1])); break;
+            case Op::Max: folded = std::max(value(in[0]), value(in[1])); break;
+            case Op::ScaleBias: folded = value(in[0]) * node.a + node.b; break;
+            case Op::Abs: folded = std::abs(value(in[0])); break;
+            case Op::Clamp: folded = std::min(std::max(value(in[0]), node.a), node.b); break;
+            case Op::Lerp: folded = value(in[0]) + (value(in[1]) - value(in[0])) * value(in[2]); break;
+            case Op::Curve: folded = evaluateCurve(m_curves[node.index], value(in[0])); break;
+            default: break;
+            }
+            node = {Op::Constant, {-1, -1, -1}, folded, 0.0f, -1};
+        }
+
+        // Generators are copies the graph owns, so two Noise nodes only match if they share one.
+        uint64_t key = static_cast<uint64_t>(node.op) * 0x9e3779b97f4a7c15ULL;
+        for (int input : node.inputs) {
+            key = (key ^ static_cast<uint32_t>(input + 1)) * 0xc2b2ae3d27d4eb4fULL;
+        }
+        key ^= static_cast<uint64_t>(static_cast<uint32_t>(node.index)) << 32;
+        canonical[id] = id;
+        for (int other : seen[key]) {
+            const Node& match = nodes[other];
+            if (match.op == node.op && match.a == node.a && match.b == node.b && match.index == node.index &&
+                std::equal(node.inputs, node.inputs + 3, match.inputs)) {
+                canonical[id] = other;
+                break;
+            }
+        }
+        if (canonical[id] == id) {
+            seen[key].push_back(id);
+        }
+    }
+
+    // Keep what the output reads, and find each kept node's last reader.
+    int output = canonical[m_output];
+    std::vector<char> live(nodeCount, 0);
+    std::vector<int> lastUse(nodeCount, -1);
+    live[output] = 1;
+    lastUse[output] = nodeCount;
+    for (int id = output; id >= 0; id--) {
+        if (!live[id]) {
+            continue;
+        }
+        for (int input : nodes[id].inputs) {
+            if (input >= 0) {
+                live[input] = 1;
+                lastUse[input] = std::max(lastUse[input], id);
+            }
+        }
+    }
+
+    // Nodes that do not depend on y, and which of them y dependent nodes (or the output) read.
+    std::vector<char> dependsOnY(nodeCount, 0);
+    std::vector<char> readByVariant(nodeCount, 0);
+    for (int id = 0; id <= output; id++) {
+        const Node& node = nodes[id];
+        dependsOnY[id] = node.op == Op::Coordinate && node.index == 1;
+        for (int input : node.inputs) {
+            dependsOnY[id] |= input >= 0 && dependsOnY[input];
+        }
+        if (live[id] && dependsOnY[id]) {
+            for (int input : node.inputs) {
+                if (input >= 0) {
+                    readByVariant[input] = 1;
+                }
+            }
+        }
+    }
+    readByVariant[output] = 1;
+
+    // Registers 0-2 always hold x, y and z. A WarpOutput node is the register its Warp wrote;
+    // the Warp stays alive until the last of its outputs is read.
+    std::vector<int> reg(nodeCount, -1);
+    std::vector<int> freeRegisters;
+    m_registerCount = 3;
+    auto allocate = [&]() {
+        if (freeRegisters.empty()) {
+            return m_registerCount++;
+        }
+        int r = freeRegisters.back();
+        freeRegisters.pop_back();
+        return r;
+    };
+    std::vector<int> warpOf(nodeCount, -1);
+    for (int id = 0; id <= output; id++) {
+        if (live[id] && nodes[id].op == Op::WarpOutput) {
+            warpOf[id] = nodes[id].inputs[0];
+        }
+    }
+
+    std::vector<int> kernelOf(m_generators.size(), -1);
+    for (int id = 0; id <= output; id++) {
+        if (!live[id]) {
+            continue;
+        }
+        const Node& node = nodes[id];
+        if (node.op == Op::Coordinate) {
+            reg[id] = node.index;
+            continue;
+        }
+        if (node.op == Op::WarpOutput) {
+            continue;   // assigned along with its Warp
+        }
+
+        Instruction instruction;
+        instruction.op = node.op;
+        instruction.a = node.a;
+        instruction.b = node.b;
+        instruction.index = node.index;
+        instruction.invariant = !dependsOnY[id];
+        m_hasInvariant |= instruction.invariant;
+        for (int i = 0; i < 3; i++) {
+            instruction.inputs[i] = node.inputs[i] >= 0 ? reg[node.inputs[i]] : -1;
+            instruction.outputs[i] = -1;
+            instruction.slots[i] = -1;
+        }
+        if (node.op == Op::Noise && kernelOf[node.index] < 0) {
+            kernelOf[node.index] = static_cast<int>(m_kernels.size());
+            m_kernels.push_back(m_generators[node.index].CreateKernel());
+        }
+        if (node.op == Op::Noise) {
+            instruction.index = kernelOf[node.index];
+        }
+
+        // Registers whose last reader is this node are free again. Elementwise ops may write
+        // their result over an input, a Warp's outputs are taken before its inputs are freed.
+        auto releaseInputs = [&]() {
+            for (int input : node.inputs) {
+                if (input >= 0 && lastUse[input] == id && reg[input] > 2 &&
+                    std::find(freeRegisters.begin(), freeRegisters.end(), reg[input]) == freeRegisters.end()) {
+                    freeRegisters.push_back(reg[input]);
+                }
+            }
+        };
+        if (node.op == Op::Warp) {
+            for (int out = id + 1; out <= output; out++) {
+                if (warpOf[out] == id) {
+                    reg[out] = allocate();
+                    instruction.outputs[nodes[out].index] = reg[out];
+                    if (instruction.invariant && readByVariant[out]) {
+                        instruction.slots[nodes[out].index] = m_slotCount++;
+                    }
+                }
+            }
+            instruction.dest = -1;
+            releaseInputs();
+        } else {
+            releaseInputs();
+            reg[id] = allocate();
+            instruction.dest = reg[id];
+            if (instruction.invariant && readByVariant[id]) {
+                instruction.slots[0] = m_slotCount++;
+            }
+        }
+        m_program.push_back(instruction);
+    }
+    m_outputRegister = reg[output];
+    return true;
+}
+
+inline void NoiseGraph::Run(float* registers, int count, Pass pass, float* slots, int slotStride, int slotOffset) const {
+    auto r = [&](int index) { return registers + static_cast<size_t>(index) * BlockSize; };
+    auto slot = [&](int index) { return slots + static_cast<size_t>(index) * slotStride + slotOffset; };
+    for (const Instruction& in : m_program) {
+        if (pass != Pass::All && (pass == Pass::Columns) != in.invariant) {
+            for (int i = 0; pass == Pass::Points && i < 3; i++) {
+                if (in.slots[i] >= 0) {
+                    std::copy(slot(in.slots[i]), slot(in.slots[i]) + count, r(in.op == Op::Warp ? in.outputs[i] : in.dest));
+                }
+            }
+            continue;
+        }
+        float* dest = in.dest >= 0 ? r(in.dest) : nullptr;
+        const float* a = in.inputs[0] >= 0 ? r(in.inputs[0]) : nullptr;
+        const float* b = in.inputs[1] >= 0 ? r(in.inputs[1]) : nullptr;
+        const float* c = in.inputs[2] >= 0 ? r(in.inputs[2]) : nullptr;
+        switch (in.op) {
+        case Op::Constant:
+            std::fill(dest, dest + count, in.a);
+            break;
+        case Op::Add:
+            for (int i = 0; i < count; i++) dest[i] = a[i] + b[i];
+            break;
+        case Op::Sub:
+            for (int i = 0; i < count; i++) dest[i] = a[i] - b[i];
+            break;
+        case Op::Mul:
+            for (int i = 0; i < count; i++) dest[i] = a[i] * b[i];
+            break;
+        case Op::Min:
+            for (int i = 0; i < count; i++) dest[i] = std::min(a[i], b[i]);
+            break;
+        case Op::Max:
+            for (int i = 0; i < count; i++) dest[i] = std::max(a[i], b[i]);
+            break;
+        case Op::ScaleBias:
+            for (int i = 0; i < count; i++) dest[i] = a[i] * in.a + in.b;
+            break;
+        case Op::Abs:
+            for (int i = 0; i < count; i++) dest[i] = std::abs(a[i]);
+            break;
+        case Op::Clamp:
+            for (int i = 0; i < count; i++) dest[i] = std::min(std::max(a[i], in.a), in.b);
+            break;
+        case Op::Lerp:
+            for (int i = 0; i < count; i++) dest[i] = a[i] + (b[i] - a[i]) * c[i];
+            break;
+        case Op::Curve: {
+            const std::vector<glm::vec2>& points = m_curves[in.index];
+            for (int i = 0; i < count; i++) dest[i] = evaluateCurve(points, a[i]);
+            break;
+        }
+        case Op::Noise:
+            m_kernels[in.index]->GetNoiseSet(dest, a, b, c, count);
+            break;
+        case Op::Warp: {
+            const FastNoise& noise = m_generators[in.index];
+            bool fractal = in.a != 0.0f;
+            float* outX = in.outputs[0] >= 0 ? r(in.outputs[0]) : nullptr;
+            float* outY = in.outputs[1] >= 0 ? r(in.outputs[1]) : nullptr;
+            float* outZ = in.outputs[2] >= 0 ? r(in.outputs[2]) : nullptr;
+            for (int i = 0; i < count; i++) {
+                float x = a[i];
+                float y = b[i];
+                if (c) {
+                    float z = c[i];
+                    if (fractal) noise.GradientPerturbFractal(x, y, z); else noise.GradientPerturb(x, y, z);
+                    if (outZ) outZ[i] = z;
+                } else {
+                    if (fractal) noise.GradientPerturbFractal(x, y); else noise.GradientPerturb(x, y);
+                }
+                if (outX) outX[i] = x;
+                if (outY) outY[i] = y;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        for (int i = 0; pass == Pass::Columns && i < 3; i++) {
+            if (in.slots[i] >= 0) {
+                const float* result = r(in.op == Op::Warp ? in.outputs[i] : in.dest);
+                std::copy(result, result + count, slot(in.slots[i]));
+            }
+        }
+    }
+}
+
+inline void NoiseGraph::Evaluate(float* out, const float* xs, const float* ys, const float* zs, int count) const {
+    if (m_outputRegister < 0) {
+        std::cout << "NoiseGraph evaluated before Compile" << std::endl;
+        return;
+    }
+    std::vector<float> registers(static_cast<size_t>(m_registerCount) * BlockSize, 0.0f);
+    for (int begin = 0; begin < count; begin += BlockSize) {
+        int length = std::min(BlockSize, count - begin);
+        std::copy(xs + begin, xs + begin + length, registers.begin());
+        std::copy(ys + begin, ys + begin + length, registers.begin() + BlockSize);
+        if (zs) {
+            std::copy(zs + begin, zs + begin + length, registers.begin() + 2 * BlockSize);
+        }
+        Run(registers.data(), length);
+        const float* result = registers.data() + static_cast<size_t>(m_outputRegister) * BlockSize;
+        std::copy(result, result + length, out + begin);
+    }
+}
+
+inline void NoiseGraph::EvaluateGrid(float* out, glm::vec3 origin, glm::ivec3 size, float step) const {
+    if (m_outputRegister < 0) {
+        std::cout << "NoiseGraph evaluated before Compile" << std::endl;
+        return;
+    }
+    std::vector<float> registers(static_cast<size_t>(m_registerCount) * BlockSize, 0.0f);
+    if (size.y > 1 && m_hasInvariant) {
+        // One x slice at a time: the y invariant instructions over its row of z, then
+        // everything else for each y with their results loaded from the slots.
+        std::vector<float> slots(static_cast<size_t>(m_slotCount) * size.z);
+        for (int x = 0; x < size.x; x++) {
+            for (int pass = 0; pass <= size.y; pass++) {
+                int y = pass - 1;
+                for (int begin = 0; begin < size.z; begin += BlockSize) {
+                    int length = std::min(BlockSize, size.z - begin);
+                    for (int i = 0; i < length; i++) {
+                        registers[i] = origin.x + x * step;
+                        registers[BlockSize + i] = origin.y + std::max(y, 0) * step;
+                        registers[2 * BlockSize + i] = origin.z + (begin + i) * step;
+                    }
+                    Run(registers.data(), length, pass == 0 ? Pass::Columns : Pass::Points, slots.data(), size.z, begin);
+                    if (pass > 0) {
+                        const float* result = registers.data() + static_cast<size_t>(m_outputRegister) * BlockSize;
+                        std::copy(result, result + length, out + (static_cast<size_t>(x) * size.y + y) * size.z + begin);
+                    }
+                }
+            }
+        }
+        return;
+    }
+    size_t total = static_cast<size_t>(size.x) * size.y * size.z;
+    for (size_t begin = 0; begin < total; begin += BlockSize) {
+        int length = static_cast<int>(std::min<size_t>(BlockSize, total - begin));
+        for (int i = 0; i < length; i++) {
+            size_t point = begin + i;
+            int z = static_cast<int>(point % size.z);
+            int y = static_cast<int>((point / size.z) % size.y);
+            int x = static_cast<int>(point / (static_cast<size_t>(size.z) * size.y));
+            registers[i] = origin.x + x * step;
+            registers[BlockSize + i] = origin.y + y * step;
+            registers[2 * BlockSize + i] = origin.z + z * step;
+        }
+        Run(registers.data(), length);
+        const float* result = registers.data() + static_cast<size_t>(m_outputRegister) * BlockSize;
+        std::copy(result, result + length, out + begin);
+    }
+}
+
+#endif
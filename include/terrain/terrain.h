@@ -0,0 +1,143 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <glm/glm.hpp>
+#include <octree/octree.h>
+#include <terrain/noise.h>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+
+// Version of the terrain these functions generate and of the way main() builds its world
+// from it. Bump it with any change to either; cached worlds record it (see
+// OctreeFileHeader::generator) and are regenerated when it differs.
+const uint64_t TERRAIN_GENERATOR_VERSION = 1;
+
+// Color of a terrain voxel at height y, blended from rock through ice to snow between
+// rockHeight and snowHeight.
+inline glm::vec4 terrainColor(float y, float rockHeight, float snowHeight) {
+    glm::vec4 rockColor = glm::vec4(0.4f, 0.3f, 0.2f, 1.0f);  // Brownish rock
+    glm::vec4 midColor  = glm::vec4(0.7f, 0.7f, 0.7f, 1.0f);  // Icy gray (transition)
+    glm::vec4 snowColor = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);  // Pure white snow
+
+    float t = glm::clamp((y - rockHeight) / (snowHeight - rockHeight), 0.0f, 1.0f);
+    if (t < 0.5f) {
+        return glm::mix(rockColor, midColor, t * 2.0f); // Rock to ice
+    }
+    return glm::mix(midColor, snowColor, (t - 0.5f) * 2.0f); // Ice to snow
+}
+
+// Column-filled heightfield voxels for an octree of the given size and depth, in the
+// order main() has always inserted them.
+inline std::vector<VoxelSample> generateTerrainVoxels(int octreeSize, int maxDepth) {
+    std::vector<VoxelSample> voxels;
+
+    int numSteps = 1 << maxDepth;
+    int voxelSize = std::max(1, octreeSize / numSteps);
+
+    float rockHeight = octreeSize * 0.01f; // Below 30% height → Rock
+    float snowHeight = octreeSize * 0.013f; // Above 80% height → Snow
+
+    std::vector<float> noise(static_cast<size_t>(numSteps) * numSteps);
+    generateTerrainNoiseTile(0.0f, 0.0f, static_cast<float>(voxelSize), numSteps, numSteps, noise.data());
+    for (int xi = 0; xi < numSteps; xi++) {
+        int x = xi * voxelSize;
+        for (int zi = 0; zi < numSteps; zi++) {
+            int z = zi * voxelSize;
+            float noiseHeight = noise[static_cast<size_t>(xi) * numSteps + zi];
+
+            int ySteps = std::max(1, static_cast<int>(std::ceil(noiseHeight / voxelSize)));
+
+            for (int yi = 0; yi < ySteps; yi++) {
+                int y = yi * voxelSize;
+                voxels.push_back({glm::ivec3(x, y, z), terrainColor(static_cast<float>(y), rockHeight, snowHeight)});
+            }
+        }
+    }
+    return voxels;
+}
+
+// The same terrain as generateTerrainVoxels, as a Heightfield for BuildFromHeightfield.
+inline Heightfield generateTerrainHeightfield(int octreeSize, int maxDepth) {
+    Heightfield field;
+    field.columns = 1 << maxDepth;
+    field.cellSize = std::max(1, octreeSize / field.columns);
+    float rockHeight = octreeSize * 0.01f;
+    float snowHeight = octreeSize * 0.013f;
+
+    int layers = 1;
+    field.heights.resize(static_cast<size_t>(field.columns) * field.columns);
+    std::vector<float> noise(field.heights.size());
+    generateTerrainNoiseTile(0.0f, 0.0f, static_cast<float>(field.cellSize), field.columns, field.columns, noise.data());
+    for (int xi = 0; xi < field.columns; xi++) {
+        for (int zi = 0; zi < field.columns; zi++) {
+            float noiseHeight = noise[static_cast<size_t>(xi) * field.columns + zi];
+            int ySteps = std::max(1, static_cast<int>(std::ceil(noiseHeight / field.cellSize)));
+            field.heights[static_cast<size_t>(xi) * field.columns + zi] = ySteps;
+            layers = std::max(layers, ySteps);
+        }
+    }
+    for (int yi = 0; yi < layers; yi++) {
+        field.layerColors.push_back(terrainColor(static_cast<float>(yi * field.cellSize), rockHeight, snowHeight));
+    }
+    return field;
+}
+
+// The part of an unbounded heightfield that falls in the chunk of chunkSize world units
+// whose corner is origin, in chunk-local coordinates for an octree of chunkSize and
+// maxDepth. Heights and colors depend only on world position, so neighbouring chunks
+// line up; colorScale plays the part octreeSize plays in generateTerrainVoxels.
+inline std::vector<VoxelSample> generateTerrainChunk(glm::ivec3 origin, int chunkSize, int maxDepth, float colorScale) {
+    std::vector<VoxelSample> voxels;
+    int numSteps = 1 << maxDepth;
+    int voxelSize = std::max(1, chunkSize / numSteps);
+    float rockHeight = colorScale * 0.01f;
+    float snowHeight = colorScale * 0.013f;
+
+    std::vector<float> noise(static_cast<size_t>(numSteps) * numSteps);
+    generateTerrainNoiseTile(static_cast<float>(origin.x), static_cast<float>(origin.z), static_cast<float>(voxelSize),
+                             numSteps, numSteps, noise.data());
+    for (int xi = 0; xi < numSteps; xi++) {
+        int x = origin.x + xi * voxelSize;
+        for (int zi = 0; zi < numSteps; zi++) {
+            int z = origin.z + zi * voxelSize;
+            float noiseHeight = noise[static_cast<size_t>(xi) * numSteps + zi];
+            int top = std::max(1, static_cast<int>(std::ceil(noiseHeight / voxelSize))) * voxelSize;
+            for (int y = std::max(origin.y, 0); y < std::min(top, origin.y + chunkSize); y += voxelSize) {
+                voxels.push_back({glm::ivec3(x, y, z) - origin, terrainColor(static_cast<float>(y), rockHeight, snowHeight)});
+            }
+        }
+    }
+    return voxels;
+}
+
+// generateTerrainChunk as a Heightfield, for chunks at or above y = 0.
+inline Heightfield generateTerrainChunkHeightfield(glm::ivec3 origin, int chunkSize, int maxDepth, float colorScale) {
+    Heightfield field;
+    field.columns = 1 << maxDepth;
+    field.cellSize = std::max(1, chunkSize / field.columns);
+    float rockHeight = colorScale * 0.01f;
+    float snowHeight = colorScale * 0.013f;
+
+    int layers = 1;
+    field.heights.resize(static_cast<size_t>(field.columns) * field.columns);
+    std::vector<float> noise(field.heights.size());
+    generateTerrainNoiseTile(static_cast<float>(origin.x), static_cast<float>(origin.z), static_cast<float>(field.cellSize),
+                             field.columns, field.columns, noise.data());
+    for (int xi = 0; xi < field.columns; xi++) {
+        for (int zi = 0; zi < field.columns; zi++) {
+            float noiseHeight = noise[static_cast<size_t>(xi) * field.columns + zi];
+            int top = std::max(1, static_cast<int>(std::ceil(noiseHeight / field.cellSize))) * field.cellSize;
+            int height = std::max(0, (std::min(top, origin.y + chunkSize) - origin.y + field.cellSize - 1) / field.cellSize);
+            field.heights[static_cast<size_t>(xi) * field.columns + zi] = height;
+            layers = std::max(layers, height);
+        }
+    }
+    for (int yi = 0; yi < layers; yi++) {
+        field.layerColors.push_back(terrainColor(static_cast<float>(origin.y + yi * field.cellSize), rockHeight, snowHeight));
+    }
+    return field;
+}
+
+#endif
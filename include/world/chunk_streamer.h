@@ -0,0 +1,365 @@
+#ifndef CHUNK_STREAMER_H
+#define CHUNK_STREAMER_H
+
+#include <glm/glm.hpp>
+#include <octree/octree.h>
+#include <octree/octree_file.h>
+#include <world/chunked_world.h>
+#include <parallel.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <filesystem>
+
+enum class ChunkJobKind {
+    Generate,   // build the chunk from terrain noise
+    Load,       // map the chunk back in from the cache directory
+    Unload      // write an evicted chunk to the cache directory
+};
+
+// Counters for the window title and the benchmark. Queue depths are as of the last Update;
+// latency runs from when a chunk was first requested to when it was integrated.
+struct StreamingMetrics {
+    size_t queued = 0;          // jobs waiting for a worker
+    size_t running = 0;         // jobs a worker is busy with
+    size_t ready = 0;           // finished chunks waiting to be integrated
+    size_t generated = 0;
+    size_t loaded = 0;
+    size_t unloaded = 0;
+    size_t integrated = 0;
+    size_t cancelled = 0;       // requests dropped because the camera moved away first
+    double meanLatencyMs = 0.0;
+    double maxLatencyMs = 0.0;
+    double lastLatencyMs = 0.0;
+};
+
+// Streams the chunks of a ChunkedWorld on background threads so the frame never waits for
+// terrain generation. Every Update the wanted chunks are those within the world's view
+// radius of the camera and of where the camera will be in prefetchSeconds at its current
+// (smoothed) velocity, so the leading edge is generated before it comes into view. The
+// lead is capped at the view radius, which keeps memory bounded at any speed. Missing
+// chunks are queued and workers always take the job with the lowest score: distance to
+// the camera, stretched up to twice for chunks that are neither in the view direction nor
+// in the direction of travel. Finished chunks are integrated on the calling thread, best
+// score first, at most integrateBudget a frame. Each one copies only its own nodes into the
+// world's pool (see ChunkedWorld::Grid), so the upload after Update is that many chunks.
+//
+// With a cache directory, evicted chunks are written there by an unload job and come back
+// through a load job instead of being generated again. Only files written by this streamer
+// are read, so stale files from other runs or other terrain settings are never picked up.
+class ChunkStreamer {
+public:
+    ChunkStreamer(ChunkedWorld& world, int threadCount = defaultThreadCount(), const std::string& cacheDirectory = "");
+    ~ChunkStreamer();
+    ChunkStreamer(const ChunkStreamer&) = delete;
+    ChunkStreamer& operator=(const ChunkStreamer&) = delete;
+
+    bool Update(glm::vec3 cameraPos, glm::vec3 cameraFront, float deltaTime);
+    void WaitIdle();
+    StreamingMetrics Metrics() const;
+    glm::vec3 Velocity() const { return m_velocity; }
+
+    int integrateBudget = 2;        // chunks integrated per Update at most
+    float prefetchSeconds = 0.5f;   // how far ahead along the velocity to prefetch, 0 for none
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Job {
+        ChunkJobKind kind;
+        glm::ivec3 coord;
+        float score;
+        Clock::time_point requested;
+        std::unique_ptr<SparseVoxelOctree> octree;  // the result, or the chunk to unload
+    };
+
+    void WorkerLoop();
+    void Run(Job& job) const;
+    float Score(glm::ivec3 coord) const;
+    bool Wanted(glm::ivec3 coord) const;
+    bool Keep(glm::ivec3 coord) const;
+    std::string CachePath(glm::ivec3 coord) const;
+
+    ChunkedWorld& m_world;
+    std::string m_cacheDirectory;
+    std::vector<std::thread> m_workers;
+
+    // Camera state of the last Update, only touched by the calling thread.
+    glm::vec3 m_cameraPos = glm::vec3(0.0f);
+    glm::vec3 m_cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
+    glm::vec3 m_velocity = glm::vec3(0.0f);
+    glm::vec3 m_heading = glm::vec3(0.0f);      // direction of travel, 0 when standing still
+    glm::ivec3 m_center = glm::ivec3(0);
+    glm::ivec3 m_predictedCenter = glm::ivec3(0);
+    bool m_hasCamera = false;
+
+    // Shared with the workers, guarded by m_mutex.
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;     // a job was queued, or the streamer is stopping
+    std::condition_variable m_idle;     // a job finished
+    bool m_stop = false;
+    std::vector<Job> m_queue;
+    std::vector<Job> m_ready;
+    size_t m_running = 0;
+    std::unordered_set<glm::ivec3, ChunkCoordHash> m_requested;  // queued, running or ready loads
+    std::unordered_set<glm::ivec3, ChunkCoordHash> m_unloading;  // unloads not yet written
+    std::unordered_set<glm::ivec3, ChunkCoordHash> m_cached;     // chunks with a cache file
+    StreamingMetrics m_metrics;
+    double m_totalLatencyMs = 0.0;
+};
+
+inline ChunkStreamer::ChunkStreamer(ChunkedWorld& world, int threadCount, const std::string& cacheDirectory)
+    : m_world(world), m_cacheDirectory(cacheDirectory) {
+    std::error_code error;
+    if (!m_cacheDirectory.empty() && !std::filesystem::create_directories(m_cacheDirectory, error) && error) {
+        std::cout << "Failed to create " << m_cacheDirectory << ", evicted chunks will be generated again" << std::endl;
+        m_cacheDirectory.clear();
+    }
+    for (int i = 0; i < std::max(1, threadCount); i++) {
+        m_workers.emplace_back(&ChunkStreamer::WorkerLoop, this);
+    }
+}
+
+// Stops after the running jobs; queued ones are dropped, pending unloads included.
+inline ChunkStreamer::~ChunkStreamer() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+// Moves the wanted set with the camera, queues and cancels jobs to match and integrates
+// finished chunks. Returns whether any chunk came or went, in which case the world's dirty
+// pool ranges and root grid need uploading.
+inline bool ChunkStreamer::Update(glm::vec3 cameraPos, glm::vec3 cameraFront, float deltaTime) {
+    if (m_hasCamera && deltaTime > 0.0f) {
+        glm::vec3 velocity = (cameraPos - m_cameraPos) / deltaTime;
+        m_velocity = glm::mix(m_velocity, velocity, 0.2f); // smoothed, so one jerky frame does not redirect prefetch
+    }
+    m_hasCamera = true;
+    m_cameraPos = cameraPos;
+    m_cameraFront = (glm::length(cameraFront) > 0.0f) ? glm::normalize(cameraFront) : glm::vec3(0.0f, 0.0f, -1.0f);
+    m_center = m_world.ChunkCoord(cameraPos);
+    m_center.y = 0;
+    float speed = glm::length(m_velocity);
+    m_heading = (speed > 1e-3f) ? m_velocity / speed : glm::vec3(0.0f);
+    float lead = std::min(speed * prefetchSeconds, static_cast<float>(m_world.ViewRadius() * m_world.ChunkSize()));
+    m_predictedCenter = m_world.ChunkCoord(cameraPos + m_heading * lead);
+    m_predictedCenter.y = 0;
+    m_world.SetCenter(m_center);
+
+    bool changed = false;
+    std::vector<glm::ivec3> wanted = m_world.ChunksAround(m_center, m_world.ViewRadius());
+    if (m_predictedCenter != m_center) {
+        std::vector<glm::ivec3> ahead = m_world.ChunksAround(m_predictedCenter, m_world.ViewRadius());
+        wanted.insert(wanted.end(), ahead.begin(), ahead.end());
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // Drop queued requests the camera has left behind and rescore the rest.
+    for (size_t i = 0; i < m_queue.size();) {
+        Job& job = m_queue[i];
+        if (job.kind != ChunkJobKind::Unload && !Wanted(job.coord)) {
+            m_requested.erase(job.coord);
+            m_metrics.cancelled++;
+            job = std::move(m_queue.back());
+            m_queue.pop_back();
+            continue;
+        }
+        job.score = (job.kind == ChunkJobKind::Unload) ? -1.0f : Score(job.coord);
+        i++;
+    }
+
+    // Evict. Unloads go first so their memory is given back soon.
+    for (const glm::ivec3& coord : m_world.ResidentChunks()) {
+        if (Keep(coord)) {
+            continue;
+        }
+        std::unique_ptr<SparseVoxelOctree> octree = m_world.Remove(coord);
+        changed = true;
+        if (!m_cacheDirectory.empty() && octree) {
+            m_unloading.insert(coord);
+            m_queue.push_back({ChunkJobKind::Unload, coord, -1.0f, Clock::now(), std::move(octree)});
+        }
+    }
+
+    // Request what is missing. A chunk whose unload has not started yet is taken straight
+    // back; one being written waits for a later Update.
+    for (const glm::ivec3& coord : wanted) {
+        if (m_world.IsResident(coord) || m_requested.count(coord)) {
+            continue;
+        }
+        if (m_unloading.count(coord)) {
+            for (size_t i = 0; i < m_queue.size(); i++) {
+                if (m_queue[i].kind == ChunkJobKind::Unload && m_queue[i].coord == coord) {
+                    m_world.Insert(coord, std::move(m_queue[i].octree));
+                    m_queue[i] = std::move(m_queue.back());
+                    m_queue.pop_back();
+                    m_unloading.erase(coord);
+                    changed = true;
+                    break;
+                }
+            }
+            continue;
+        }
+        ChunkJobKind kind = m_cached.count(coord) ? ChunkJobKind::Load : ChunkJobKind::Generate;
+        m_requested.insert(coord);
+        m_queue.push_back({kind, coord, Score(coord), Clock::now(), nullptr});
+    }
+    m_wake.notify_all();
+
+    // Integrate finished chunks, best score first, within the budget.
+    for (Job& job : m_ready) {
+        job.score = Score(job.coord);
+    }
+    std::sort(m_ready.begin(), m_ready.end(), [](const Job& a, const Job& b) { return a.score > b.score; });
+    Clock::time_point now = Clock::now();
+    for (int integrated = 0; !m_ready.empty() && integrated < integrateBudget;) {
+        Job job = std::move(m_ready.back());
+        m_ready.pop_back();
+        m_requested.erase(job.coord);
+        if (!Keep(job.coord)) {
+            m_metrics.cancelled++;
+            continue;
+        }
+        m_world.Insert(job.coord, std::move(job.octree));
+        changed = true;
+        integrated++;
+        double latency = std::chrono::duration<double, std::milli>(now - job.requested).count();
+        m_metrics.integrated++;
+        m_metrics.lastLatencyMs = latency;
+        m_metrics.maxLatencyMs = std::max(m_metrics.maxLatencyMs, latency);
+        m_totalLatencyMs += latency;
+        m_metrics.meanLatencyMs = m_totalLatencyMs / m_metrics.integrated;
+    }
+    m_metrics.queued = m_queue.size();
+    m_metrics.running = m_running;
+    m_metrics.ready = m_ready.size();
+    return changed;
+}
+
+// Blocks until every queued job has run. Finished chunks still need Update to integrate.
+inline void ChunkStreamer::WaitIdle() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [&]() { return m_queue.empty() && m_running == 0; });
+}
+
+inline StreamingMetrics ChunkStreamer::Metrics() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_metrics;
+}
+
+inline void ChunkStreamer::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_wake.wait(lock, [&]() { return m_stop || !m_queue.empty(); });
+        if (m_stop) {
+            return;
+        }
+        // The queue is at most a few hundred jobs, so a scan is cheaper than keeping a heap
+        // ordered while Update rescores it every frame.
+        size_t best = 0;
+        for (size_t i = 1; i < m_queue.size(); i++) {
+            if (m_queue[i].score < m_queue[best].score) {
+                best = i;
+            }
+        }
+        Job job = std::move(m_queue[best]);
+        m_queue[best] = std::move(m_queue.back());
+        m_queue.pop_back();
+        m_running++;
+
+        lock.unlock();
+        Run(job);
+        lock.lock();
+
+        m_running--;
+        if (job.kind == ChunkJobKind::Unload) {
+            m_unloading.erase(job.coord);
+            if (job.octree) { // written
+                m_cached.insert(job.coord);
+                m_metrics.unloaded++;
+            }
+        } else {
+            if (job.kind == ChunkJobKind::Load) {
+                m_metrics.loaded++;
+            } else {
+                m_metrics.generated++;
+            }
+            m_ready.push_back(std::move(job));
+        }
+        m_idle.notify_all();
+    }
+}
+
+// Unload jobs come back with the octree cleared when the file could not be written.
+inline void ChunkStreamer::Run(Job& job) const {
+    switch (job.kind) {
+    case ChunkJobKind::Generate:
+        job.octree = m_world.GenerateChunk(job.coord);
+        break;
+    case ChunkJobKind::Load: {
+        MappedOctreeFile file;
+        if (file.Open(CachePath(job.coord)) && file.Layout() == NodeLayout::Flattened) {
+            job.octree.reset(new SparseVoxelOctree(file.Header().size, file.Header().maxDepth));
+            job.octree->LoadNodes(file.FlattenedNodes(), file.NodeCount());
+        } else {
+            std::cout << "Failed to load " << CachePath(job.coord) << ", generating it again" << std::endl;
+            job.octree = m_world.GenerateChunk(job.coord);
+        }
+        break;
+    }
+    case ChunkJobKind::Unload:
+        if (!saveOctreeFile(CachePath(job.coord), *job.octree)) {
+            job.octree.reset();
+        }
+        break;
+    }
+}
+
+// Lower is sooner. Distance from the camera to the chunk center, from 1x for chunks in
+// the view direction or the direction of travel to 2x for chunks behind both.
+inline float ChunkStreamer::Score(glm::ivec3 coord) const {
+    glm::vec3 center = (glm::vec3(coord) + 0.5f) * static_cast<float>(m_world.ChunkSize());
+    glm::vec3 offset = center - m_cameraPos;
+    float distance = glm::length(offset);
+    if (distance == 0.0f) {
+        return 0.0f;
+    }
+    glm::vec3 direction = offset / distance;
+    float facing = std::max(glm::dot(direction, m_cameraFront), glm::dot(direction, m_heading));
+    return distance * (1.5f - 0.5f * facing);
+}
+
+// In the view radius of the camera or of the predicted position.
+inline bool ChunkStreamer::Wanted(glm::ivec3 coord) const {
+    glm::ivec3 offset = glm::abs(coord - m_center);
+    glm::ivec3 ahead = glm::abs(coord - m_predictedCenter);
+    return std::min(std::max(offset.x, offset.z), std::max(ahead.x, ahead.z)) <= m_world.ViewRadius();
+}
+
+// Wanted, with a margin of one chunk so chunks on the edge do not churn.
+inline bool ChunkStreamer::Keep(glm::ivec3 coord) const {
+    glm::ivec3 offset = glm::abs(coord - m_center);
+    glm::ivec3 ahead = glm::abs(coord - m_predictedCenter);
+    return std::min(std::max(offset.x, offset.z), std::max(ahead.x, ahead.z)) <= m_world.ViewRadius() + 1;
+}
+
+inline std::string ChunkStreamer::CachePath(glm::ivec3 coord) const {
+    return m_cacheDirectory + "/chunk_" + std::to_string(coord.x) + "_" + std::to_string(coord.y) + "_" +
+           std::to_string(coord.z) + ".octree";
+}
+
+#endif
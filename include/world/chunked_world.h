@@ -0,0 +1,382 @@
+#ifndef CHUNKED_WORLD_H
+#define CHUNKED_WORLD_H
+
+#include <glm/glm.hpp>
+#include <octree/octree.h>
+#include <octree/raycast.h>
+#include <terrain/terrain.h>
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+
+struct ChunkCoordHash {
+    size_t operator()(const glm::ivec3& coord) const {
+        uint64_t hash = static_cast<uint32_t>(coord.x) * 0x9e3779b97f4a7c15ULL;
+        hash ^= static_cast<uint32_t>(coord.y) * 0xc2b2ae3d27d4eb4fULL + (hash << 6) + (hash >> 2);
+        hash ^= static_cast<uint32_t>(coord.z) * 0x165667b19e3779f9ULL + (hash << 6) + (hash >> 2);
+        return static_cast<size_t>(hash);
+    }
+};
+
+// Resident chunks packed for the shader: all of their flattened nodes in one array with
+// child indices rebased, and a dense grid of chunk cells around the camera holding the
+// index of each chunk's root node, or -1 where there is nothing to draw. Cell (x, y, z)
+// of the grid is chunk origin + (x, y, z) and sits at roots[(x * dims.y + y) * dims.z + z].
+// The nodes may contain unused gaps, see ChunkedWorld::Grid.
+struct ChunkGrid {
+    glm::ivec3 origin = glm::ivec3(0);
+    glm::ivec3 dims = glm::ivec3(0);
+    int chunkSize = 0;
+    std::vector<int> roots;
+    std::vector<FlattenedNode> nodes;
+
+    glm::vec3 minBound() const { return glm::vec3(origin * chunkSize); }
+    glm::vec3 maxBound() const { return glm::vec3((origin + dims) * chunkSize); }
+};
+
+// Unbounded terrain split into cubic chunks of chunkSize world units, each its own octree
+// of chunkDepth levels. Chunks live in a hash map keyed by chunk coordinate; Update()
+// generates the missing ones within viewRadius chunks of the camera (horizontally, for
+// heightChunks layers from y = 0 up) and evicts those more than viewRadius + 1 away, so
+// memory stays bounded however far the camera travels. Chunks with no voxels are kept as
+// null entries so they are not generated again. chunkSize should be a power of two, so
+// chunk octrees split on whole voxels.
+//
+// The world also keeps every resident chunk's nodes in one shared pool, Grid(), where
+// each chunk owns a range of its own. Inserting a chunk copies just its nodes into a free
+// range and marks that range dirty, and removing one only frees its range, so a change
+// costs O(chunk) and the renderer uploads only TakeDirtyRanges() and the root grid.
+class ChunkedWorld {
+public:
+    ChunkedWorld(int chunkSize, int chunkDepth, int viewRadius, int heightChunks = 1, float colorScale = 1000.0f);
+    bool Update(glm::vec3 cameraPos, int maxNewChunks = -1);
+    glm::ivec3 ChunkCoord(glm::vec3 point) const;
+    const SparseVoxelOctree* Chunk(glm::ivec3 coord) const;
+    bool IsResident(glm::ivec3 coord) const { return m_chunks.count(coord) != 0; }
+    bool Get(glm::ivec3 point, glm::vec4& color) const;
+    ChunkGrid Pack() const;
+    const ChunkGrid& Grid();
+    std::vector<NodeRange> TakeDirtyRanges();
+    size_t ChunkCount() const { return m_chunks.size(); }
+    size_t NodeCount() const;
+    size_t PendingCount() const { return m_pending; }
+    int ChunkSize() const { return m_chunkSize; }
+    int ViewRadius() const { return m_viewRadius; }
+
+    // Pieces of Update for callers that generate chunks elsewhere, see ChunkStreamer.
+    // GenerateChunk only reads the world's settings, so it may run on any thread.
+    void SetCenter(glm::ivec3 center);
+    glm::ivec3 Center() const { return m_center; }
+    std::vector<glm::ivec3> ChunksAround(glm::ivec3 center, int radius) const;
+    std::vector<glm::ivec3> ResidentChunks() const;
+    std::unique_ptr<SparseVoxelOctree> GenerateChunk(glm::ivec3 coord) const;
+    void Insert(glm::ivec3 coord, std::unique_ptr<SparseVoxelOctree> octree);
+    std::unique_ptr<SparseVoxelOctree> Remove(glm::ivec3 coord);
+private:
+    void AddToPool(glm::ivec3 coord, const SparseVoxelOctree& octree);
+    void RemoveFromPool(glm::ivec3 coord);
+
+    int m_chunkSize;
+    int m_chunkDepth;
+    int m_viewRadius;
+    int m_heightChunks;
+    float m_colorScale;
+    glm::ivec3 m_center = glm::ivec3(0);   // chunk the camera was in at the last Update
+    size_t m_pending = 0;                  // chunks in range still to be generated
+    std::unordered_map<glm::ivec3, std::unique_ptr<SparseVoxelOctree>, ChunkCoordHash> m_chunks;
+
+    ChunkGrid m_grid;                      // the shared pool, roots rebuilt by Grid when stale
+    bool m_rootsStale = true;
+    std::unordered_map<glm::ivec3, NodeRange, ChunkCoordHash> m_ranges;  // pool range of each chunk
+    std::vector<NodeRange> m_free;         // unused pool ranges, sorted and coalesced
+    std::vector<NodeRange> m_dirty;        // pool ranges written since the last TakeDirtyRanges
+};
+
+inline ChunkedWorld::ChunkedWorld(int chunkSize, int chunkDepth, int viewRadius, int heightChunks, float colorScale)
+    : m_chunkSize(chunkSize), m_chunkDepth(chunkDepth), m_viewRadius(viewRadius), m_heightChunks(heightChunks),
+      m_colorScale(colorScale) {
+}
+
+inline glm::ivec3 ChunkedWorld::ChunkCoord(glm::vec3 point) const {
+    return glm::ivec3(glm::floor(point / static_cast<float>(m_chunkSize)));
+}
+
+inline void ChunkedWorld::SetCenter(glm::ivec3 center) {
+    center.y = 0;
+    m_rootsStale = m_rootsStale || center != m_center;
+    m_center = center;
+}
+
+// Evicts chunks that fell out of range, then generates missing chunks nearest first, at
+// most maxNewChunks of them (all when negative). Returns whether any chunk came or went.
+inline bool ChunkedWorld::Update(glm::vec3 cameraPos, int maxNewChunks) {
+    SetCenter(ChunkCoord(cameraPos));
+    bool changed = false;
+    for (const glm::ivec3& coord : ResidentChunks()) {
+        glm::ivec3 offset = glm::abs(coord - m_center);
+        if (std::max(offset.x, offset.z) > m_viewRadius + 1) {
+            Remove(coord);
+            changed = true;
+        }
+    }
+
+    std::vector<glm::ivec3> missing;
+    for (const glm::ivec3& coord : ChunksAround(m_center, m_viewRadius)) {
+        if (!IsResident(coord)) {
+            missing.push_back(coord);
+        }
+    }
+    size_t count = (maxNewChunks < 0) ? missing.size() : std::min(missing.size(), static_cast<size_t>(maxNewChunks));
+    for (size_t i = 0; i < count; i++) {
+        Insert(missing[i], GenerateChunk(missing[i]));
+        changed = true;
+    }
+    m_pending = missing.size() - count;
+    return changed;
+}
+
+// Every chunk within radius chunks of center horizontally, for all height layers, nearest
+// first.
+inline std::vector<glm::ivec3> ChunkedWorld::ChunksAround(glm::ivec3 center, int radius) const {
+    center.y = 0;
+    std::vector<glm::ivec3> coords;
+    for (int x = -radius; x <= radius; x++) {
+        for (int z = -radius; z <= radius; z++) {
+            for (int y = 0; y < m_heightChunks; y++) {
+                coords.push_back(center + glm::ivec3(x, y, z));
+            }
+        }
+    }
+    std::sort(coords.begin(), coords.end(), [&](const glm::ivec3& a, const glm::ivec3& b) {
+        glm::ivec3 da = a - center;
+        glm::ivec3 db = b - center;
+        return da.x * da.x + da.y * da.y + da.z * da.z < db.x * db.x + db.y * db.y + db.z * db.z;
+    });
+    return coords;
+}
+
+inline std::vector<glm::ivec3> ChunkedWorld::ResidentChunks() const {
+    std::vector<glm::ivec3> coords;
+    coords.reserve(m_chunks.size());
+    for (const auto& chunk : m_chunks) {
+        coords.push_back(chunk.first);
+    }
+    return coords;
+}
+
+// Adds a chunk, replacing any chunk already at coord. A null octree is an empty chunk.
+inline void ChunkedWorld::Insert(glm::ivec3 coord, std::unique_ptr<SparseVoxelOctree> octree) {
+    RemoveFromPool(coord);
+    if (octree) {
+        AddToPool(coord, *octree);
+    }
+    m_chunks[coord] = std::move(octree);
+}
+
+// Takes a chunk out of the world and hands its octree back (nullptr for an empty chunk).
+inline std::unique_ptr<SparseVoxelOctree> ChunkedWorld::Remove(glm::ivec3 coord) {
+    auto found = m_chunks.find(coord);
+    if (found == m_chunks.end()) {
+        return nullptr;
+    }
+    RemoveFromPool(coord);
+    std::unique_ptr<SparseVoxelOctree> octree = std::move(found->second);
+    m_chunks.erase(found);
+    return octree;
+}
+
+// Copies the chunk's nodes into the first free range that fits, or onto the end of the
+// pool, with child indices rebased to the pool.
+inline void ChunkedWorld::AddToPool(glm::ivec3 coord, const SparseVoxelOctree& octree) {
+    const NodePool<FlattenedNode>& nodes = octree.Nodes();
+    size_t count = nodes.Size();
+    size_t base = m_grid.nodes.size();
+    auto fit = std::find_if(m_free.begin(), m_free.end(), [&](const NodeRange& range) {
+        return range.end - range.begin >= count;
+    });
+    if (fit != m_free.end()) {
+        base = fit->begin;
+        fit->begin += count;
+        if (fit->begin == fit->end) {
+            m_free.erase(fit);
+        }
+    } else {
+        m_grid.nodes.resize(base + count);
+    }
+    size_t next = base;
+    for (size_t c = 0; c < nodes.ChunkCount(); c++) {
+        std::copy(nodes.Chunk(c), nodes.Chunk(c) + nodes.ChunkNodes(c), m_grid.nodes.begin() + next);
+        next += nodes.ChunkNodes(c);
+    }
+    for (size_t i = base; i < next; i++) {
+        for (int& child : m_grid.nodes[i].childIndices) {
+            child = (child == -1) ? -1 : child + static_cast<int>(base);
+        }
+    }
+    m_ranges[coord] = {base, next};
+    m_dirty.push_back({base, next});
+    m_rootsStale = true;
+}
+
+// Gives the chunk's range back. Nothing needs uploading, the root grid just stops pointing
+// at it. A free range at the end of the pool is trimmed off.
+inline void ChunkedWorld::RemoveFromPool(glm::ivec3 coord) {
+    auto found = m_ranges.find(coord);
+    if (found == m_ranges.end()) {
+        return;
+    }
+    NodeRange freed = found->second;
+    m_ranges.erase(found);
+    m_rootsStale = true;
+    m_free.push_back(freed);
+    m_free = mergeNodeRanges(std::move(m_free));
+    if (!m_free.empty() && m_free.back().end == m_grid.nodes.size()) {
+        m_grid.nodes.resize(m_free.back().begin);
+        m_free.pop_back();
+    }
+}
+
+// The shared pool with the root grid around the current center. Roots are rebuilt only
+// after a chunk came or went or the center moved, which is a few hundred cells.
+inline const ChunkGrid& ChunkedWorld::Grid() {
+    if (!m_rootsStale) {
+        return m_grid;
+    }
+    m_grid.chunkSize = m_chunkSize;
+    m_grid.origin = m_center - glm::ivec3(m_viewRadius + 1, 0, m_viewRadius + 1);
+    m_grid.dims = glm::ivec3(2 * m_viewRadius + 3, m_heightChunks, 2 * m_viewRadius + 3);
+    m_grid.roots.assign(static_cast<size_t>(m_grid.dims.x) * m_grid.dims.y * m_grid.dims.z, -1);
+    for (const auto& range : m_ranges) {
+        glm::ivec3 cell = range.first - m_grid.origin;
+        if (glm::all(glm::greaterThanEqual(cell, glm::ivec3(0))) && glm::all(glm::lessThan(cell, m_grid.dims))) {
+            m_grid.roots[(static_cast<size_t>(cell.x) * m_grid.dims.y + cell.y) * m_grid.dims.z + cell.z] =
+                static_cast<int>(range.second.begin);
+        }
+    }
+    m_rootsStale = false;
+    return m_grid;
+}
+
+// Sorted, non-overlapping pool ranges written since the last call, clipped to the pool.
+inline std::vector<NodeRange> ChunkedWorld::TakeDirtyRanges() {
+    std::vector<NodeRange> ranges;
+    for (NodeRange range : mergeNodeRanges(std::move(m_dirty))) {
+        range.end = std::min(range.end, m_grid.nodes.size());
+        if (range.begin < range.end) {
+            ranges.push_back(range);
+        }
+    }
+    m_dirty.clear();
+    return ranges;
+}
+
+inline std::unique_ptr<SparseVoxelOctree> ChunkedWorld::GenerateChunk(glm::ivec3 coord) const {
+    Heightfield field = generateTerrainChunkHeightfield(coord * m_chunkSize, m_chunkSize, m_chunkDepth, m_colorScale);
+    if (std::all_of(field.heights.begin(), field.heights.end(), [](int height) { return height == 0; })) {
+        return nullptr;
+    }
+    std::unique_ptr<SparseVoxelOctree> octree(new SparseVoxelOctree(m_chunkSize, m_chunkDepth));
+    octree->BuildFromHeightfield(field);
+    octree->FilterColors();
+    return octree;
+}
+
+// The octree of a resident chunk, or nullptr when the chunk is empty or not resident.
+inline const SparseVoxelOctree* ChunkedWorld::Chunk(glm::ivec3 coord) const {
+    auto found = m_chunks.find(coord);
+    return (found == m_chunks.end()) ? nullptr : found->second.get();
+}
+
+// Voxel lookup in world coordinates. Points in chunks that are not resident are empty.
+inline bool ChunkedWorld::Get(glm::ivec3 point, glm::vec4& color) const {
+    glm::ivec3 coord = ChunkCoord(glm::vec3(point));
+    const SparseVoxelOctree* chunk = Chunk(coord);
+    return chunk != nullptr && chunk->Get(point - coord * m_chunkSize, color);
+}
+
+inline size_t ChunkedWorld::NodeCount() const {
+    size_t count = 0;
+    for (const auto& chunk : m_chunks) {
+        count += chunk.second ? chunk.second->Nodes().Size() : 0;
+    }
+    return count;
+}
+
+// Packs every resident chunk into a fresh grid covering the range Update keeps resident,
+// with no gaps between chunks. This copies the whole world; the renderer uses Grid().
+inline ChunkGrid ChunkedWorld::Pack() const {
+    ChunkGrid grid;
+    grid.chunkSize = m_chunkSize;
+    grid.origin = m_center - glm::ivec3(m_viewRadius + 1, 0, m_viewRadius + 1);
+    grid.dims = glm::ivec3(2 * m_viewRadius + 3, m_heightChunks, 2 * m_viewRadius + 3);
+    grid.roots.assign(static_cast<size_t>(grid.dims.x) * grid.dims.y * grid.dims.z, -1);
+    for (const auto& chunk : m_chunks) {
+        glm::ivec3 cell = chunk.first - grid.origin;
+        if (!chunk.second || glm::any(glm::lessThan(cell, glm::ivec3(0))) ||
+            glm::any(glm::greaterThanEqual(cell, grid.dims))) {
+            continue;
+        }
+        int base = static_cast<int>(grid.nodes.size());
+        const NodePool<FlattenedNode>& nodes = chunk.second->Nodes();
+        for (size_t c = 0; c < nodes.ChunkCount(); c++) {
+            grid.nodes.insert(grid.nodes.end(), nodes.Chunk(c), nodes.Chunk(c) + nodes.ChunkNodes(c));
+        }
+        for (size_t i = base; i < grid.nodes.size(); i++) {
+            for (int& child : grid.nodes[i].childIndices) {
+                child = (child == -1) ? -1 : child + base;
+            }
+        }
+        grid.roots[(static_cast<size_t>(cell.x) * grid.dims.y + cell.y) * grid.dims.z + cell.z] = base;
+    }
+    return grid;
+}
+
+// CPU version of traverseChunks in compute.glsl: walks the grid cells along the ray with
+// a 3D DDA and traces the octree of each occupied cell in turn. Cells do not overlap, so
+// the first hit is the closest one. Returns vec4(0) on a miss like raycastOctree.
+inline glm::vec4 raycastChunks(const ChunkGrid& grid, glm::vec3 ro, glm::vec3 rd, float lodScale = 0.0f) {
+    float tEnter, tExit;
+    if (grid.nodes.empty() || !intersectAABB(ro, rd, grid.minBound(), grid.maxBound(), tEnter, tExit)) {
+        return glm::vec4(0.0f);
+    }
+    float size = static_cast<float>(grid.chunkSize);
+    glm::vec3 gridMin = grid.minBound();
+    glm::vec3 entry = ro + rd * std::max(tEnter, 0.0f);
+    glm::ivec3 cell = glm::clamp(glm::ivec3(glm::floor((entry - gridMin) / size)), glm::ivec3(0), grid.dims - 1);
+
+    glm::ivec3 step;
+    glm::vec3 tMax, tDelta;
+    for (int axis = 0; axis < 3; axis++) {
+        step[axis] = (rd[axis] > 0.0f) ? 1 : -1;
+        if (rd[axis] == 0.0f) {
+            tMax[axis] = tDelta[axis] = std::numeric_limits<float>::infinity();
+            continue;
+        }
+        float boundary = gridMin[axis] + (cell[axis] + (step[axis] > 0 ? 1 : 0)) * size;
+        tMax[axis] = (boundary - ro[axis]) / rd[axis];
+        tDelta[axis] = size / std::abs(rd[axis]);
+    }
+
+    FlattenedView view{grid.nodes};
+    while (true) {
+        int root = grid.roots[(static_cast<size_t>(cell.x) * grid.dims.y + cell.y) * grid.dims.z + cell.z];
+        if (root != -1) {
+            glm::vec3 cellMin = gridMin + glm::vec3(cell) * size;
+            glm::vec4 color = raycastOctree(view, ro, rd, cellMin, cellMin + size, lodScale, root);
+            if (color != glm::vec4(0.0f)) {
+                return color;
+            }
+        }
+        int axis = (tMax.x < tMax.y) ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+        cell[axis] += step[axis];
+        if (cell[axis] < 0 || cell[axis] >= grid.dims[axis]) {
+            return glm::vec4(0.0f);
+        }
+        tMax[axis] += tDelta[axis];
+    }
+}
+
+#endif
@@ -0,0 +1,2035 @@
+// Standalone timing harness for the octree and terrain code. Needs no window or GL
+// context, build it like main.cpp but without glad/glfw:
+//   g++ -O2 -std=c++17 -Iinclude src/benchmark.cpp include/fastnoise/fastnoise.cpp -o benchmark -pthread
+// Every correctness check goes through check(); the run exits with 1 when any of them failed.
+#include <octree/octree.h>
+#include <octree/raycast.h>
+#include <octree/octree_file.h>
+#include <octree/paged_octree.h>
+#include <terrain/terrain.h>
+#include <fastnoise/fastnoise.h>
+#include <terrain/noise_graph.h>
+#include <terrain/density.h>
+#include <world/chunked_world.h>
+#include <world/chunk_streamer.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Checks that failed so far. main exits nonzero when there are any.
+int failedChecks = 0;
+
+// Returns pass when ok holds, otherwise counts a failed check and returns fail.
+const char* check(bool ok, const char* pass, const char* fail = "MISMATCH") {
+    failedChecks += ok ? 0 : 1;
+    return ok ? pass : fail;
+}
+
+double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Compares two trees by structure and color regardless of how their nodes are laid out.
+// With leafColorsOnly, interior node colors are ignored.
+bool sameSubtree(const std::vector<FlattenedNode>& a, int ia, const std::vector<FlattenedNode>& b, int ib,
+                 bool leafColorsOnly = false) {
+    const FlattenedNode& na = a[ia];
+    const FlattenedNode& nb = b[ib];
+    if (na.IsLeaf != nb.IsLeaf || ((na.IsLeaf || !leafColorsOnly) && na.color != nb.color)) {
+        return false;
+    }
+    for (int child = 0; child < 8; child++) {
+        int ca = na.childIndices[child];
+        int cb = nb.childIndices[child];
+        if ((ca == -1) != (cb == -1)) {
+            return false;
+        }
+        if (ca != -1 && !sameSubtree(a, ca, b, cb, leafColorsOnly)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void benchmarkBuild() {
+    std::cout << "== Octree build: per-voxel Insert vs BuildFromVoxels ==" << std::endl;
+    for (int maxDepth = 7; maxDepth <= 10; maxDepth++) {
+        int octreeSize = std::max(1000, 1 << maxDepth);
+        std::vector<VoxelSample> voxels = generateTerrainVoxels(octreeSize, maxDepth);
+
+        auto start = std::chrono::steady_clock::now();
+        SparseVoxelOctree insertTree(octreeSize, maxDepth);
+        for (const VoxelSample& voxel : voxels) {
+            insertTree.Insert(glm::vec3(voxel.position), voxel.color);
+        }
+        double insertMs = elapsedMs(start);
+        std::vector<FlattenedNode> inserted = insertTree.ExportNodes();
+
+        start = std::chrono::steady_clock::now();
+        SparseVoxelOctree bulkTree(octreeSize, maxDepth);
+        bulkTree.BuildFromVoxels(voxels);
+        double bulkMs = elapsedMs(start);
+        std::vector<FlattenedNode> bulk = bulkTree.ExportNodes();
+
+        std::cout << "maxDepth " << maxDepth << ": " << voxels.size() << " voxels, "
+                  << bulk.size() << " nodes | Insert " << insertMs << " ms | BuildFromVoxels "
+                  << bulkMs << " ms | speedup " << insertMs / bulkMs << "x | "
+                  << check(inserted.size() == bulk.size() && sameSubtree(inserted, 0, bulk, 0), "match")
+                  << std::endl;
+    }
+}
+
+void benchmarkParallelBuild() {
+    std::cout << "== Parallel build: thread scaling (" << defaultThreadCount() << " hardware threads) ==" << std::endl;
+    for (int maxDepth = 9; maxDepth <= 10; maxDepth++) {
+        int octreeSize = std::max(1000, 1 << maxDepth);
+        std::vector<VoxelSample> voxels = generateTerrainVoxels(octreeSize, maxDepth);
+        SparseVoxelOctree octree(octreeSize, maxDepth);
+
+        auto start = std::chrono::steady_clock::now();
+        octree.BuildFromVoxels(voxels);
+        double serialMs = elapsedMs(start);
+        std::vector<FlattenedNode> serial = octree.ExportNodes();
+        std::cout << "maxDepth " << maxDepth << ": serial " << serialMs << " ms" << std::endl;
+
+        for (int splitDepth = 1; splitDepth <= 2; splitDepth++) {
+            for (int threads = 1; threads <= 16; threads *= 2) {
+                start = std::chrono::steady_clock::now();
+                octree.BuildFromVoxelsParallel(voxels, threads, splitDepth);
+                double parallelMs = elapsedMs(start);
+                std::vector<FlattenedNode> nodes = octree.ExportNodes();
+                bool identical = nodes.size() == serial.size() &&
+                    std::memcmp(nodes.data(), serial.data(), serial.size() * sizeof(FlattenedNode)) == 0;
+                std::cout << "  " << (8 << (3 * (splitDepth - 1))) << " subtrees, " << threads << " threads: "
+                          << parallelMs << " ms | speedup " << serialMs / parallelMs << "x | "
+                          << check(identical, "byte-identical") << std::endl;
+            }
+        }
+    }
+}
+
+// World-space primary ray directions for a width x height image from main()'s starting
+// camera, generated the way compute.glsl does it.
+std::vector<glm::vec3> cameraRays(int width, int height, glm::vec3 cameraPos, glm::vec3 cameraFront) {
+    float fov = 45.0f;
+    glm::mat4 viewMatrix = glm::lookAt(cameraPos, cameraPos + cameraFront, glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat3 invViewMatrix = glm::mat3(glm::transpose(viewMatrix));
+    std::vector<glm::vec3> rays;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            glm::vec2 uv = (glm::vec2(x, y) / glm::vec2(width, height)) * 2.0f - 1.0f;
+            uv.x *= static_cast<float>(width) / height;
+            glm::vec3 dir = glm::normalize(glm::vec3(uv, -1.0f / std::tan(glm::radians(fov / 2.0f))));
+            rays.push_back(glm::normalize(invViewMatrix * dir));
+        }
+    }
+    return rays;
+}
+
+// Renders the rays against one node layout and returns the time taken.
+template <typename View>
+double renderRays(const View& view, const std::vector<glm::vec3>& rays, glm::vec3 origin, float size,
+                  std::vector<glm::vec4>& image, float lodScale = 0.0f) {
+    image.resize(rays.size());
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rays.size(); i++) {
+        image[i] = raycastOctree(view, origin, rays[i], glm::vec3(0.0f), glm::vec3(size), lodScale);
+    }
+    return elapsedMs(start);
+}
+
+void benchmarkCompactLayout() {
+    std::cout << "== Compact node layout: memory and CPU traversal ==" << std::endl;
+    glm::vec3 cameraPos(50.0f, 30.0f, 120.0f);
+    std::vector<glm::vec3> rays = cameraRays(200, 150, cameraPos, glm::vec3(0.0f, -0.3f, -1.0f));
+    for (int maxDepth = 7; maxDepth <= 9; maxDepth++) {
+        int octreeSize = 1000;
+        SparseVoxelOctree octree(octreeSize, maxDepth);
+        octree.BuildFromVoxels(generateTerrainVoxels(octreeSize, maxDepth));
+        std::vector<FlattenedNode> flattened = octree.ExportNodes();
+
+        auto start = std::chrono::steady_clock::now();
+        CompactOctree compact = octree.ToCompact();
+        double convertMs = elapsedMs(start);
+        octree.FromCompact(compact);
+        bool roundTrip = sameSubtree(flattened, 0, octree.ExportNodes(), 0);
+
+        std::vector<glm::vec4> flatImage, compactImage;
+        double flatMs = renderRays(FlattenedView{flattened}, rays, cameraPos, static_cast<float>(octreeSize), flatImage);
+        double compactMs = renderRays(CompactView{compact}, rays, cameraPos, static_cast<float>(octreeSize), compactImage);
+
+        size_t flatBytes = flattened.size() * sizeof(FlattenedNode);
+        size_t nodeBytes = compact.nodes.size() * sizeof(CompactNode);
+        size_t colorBytes = compact.colors.size() * sizeof(uint32_t);
+        std::cout << "maxDepth " << maxDepth << ": " << flattened.size() << " nodes | flattened "
+                  << flatBytes / 1024 << " KiB | compact nodes " << nodeBytes / 1024 << " KiB ("
+                  << static_cast<double>(flatBytes) / nodeBytes << "x smaller) + colors " << colorBytes / 1024
+                  << " KiB | convert " << convertMs << " ms | round trip " << check(roundTrip, "ok")
+                  << " | raycast flattened " << flatMs << " ms, compact " << compactMs << " ms | images "
+                  << check(flatImage == compactImage, "identical", "DIFFER") << std::endl;
+    }
+}
+
+void benchmarkLeafBricks() {
+    std::cout << "== Leaf bricks: node count and CPU traversal ==" << std::endl;
+    glm::vec3 cameraPos(50.0f, 30.0f, 120.0f);
+    std::vector<glm::vec3> rays = cameraRays(200, 150, cameraPos, glm::vec3(0.0f, -0.3f, -1.0f));
+    for (int maxDepth = 7; maxDepth <= 9; maxDepth++) {
+        int octreeSize = 1000;
+        SparseVoxelOctree octree(octreeSize, maxDepth);
+        octree.BuildFromVoxels(generateTerrainVoxels(octreeSize, maxDepth));
+        std::vector<FlattenedNode> flattened = octree.ExportNodes();
+        std::vector<glm::vec4> reference;
+        CompactOctree plain = octree.ToCompact();
+        double plainMs = renderRays(CompactView{plain}, rays, cameraPos, static_cast<float>(octreeSize), reference);
+        std::cout << "maxDepth " << maxDepth << ": no bricks " << plain.nodes.size() << " nodes, "
+                  << (plain.nodes.size() * sizeof(CompactNode) + plain.colors.size() * sizeof(uint32_t)) / 1024
+                  << " KiB, raycast " << plainMs << " ms" << std::endl;
+
+        for (int brickSize = 4; brickSize <= 8; brickSize *= 2) {
+            CompactOctree bricked = octree.ToCompact(brickSize);
+            size_t bytes = bricked.nodes.size() * sizeof(CompactNode) + bricked.colors.size() * sizeof(uint32_t) +
+                           bricked.bricks.size() * sizeof(uint32_t) + bricked.brickColors.size() * sizeof(uint32_t);
+            std::vector<glm::vec4> image;
+            double brickMs = renderRays(CompactView{bricked}, rays, cameraPos, static_cast<float>(octreeSize), image);
+            int differing = 0;
+            for (size_t i = 0; i < image.size(); i++) {
+                differing += (image[i] != reference[i]) ? 1 : 0;
+            }
+            octree.FromCompact(bricked);
+            bool roundTrip = sameSubtree(flattened, 0, octree.ExportNodes(), 0, true);
+            std::cout << "  " << brickSize << "^3 bricks: " << bricked.nodes.size() << " nodes ("
+                      << static_cast<double>(plain.nodes.size()) / bricked.nodes.size() << "x fewer), "
+                      << bricked.bricks.size() / bricked.brickStride() << " bricks, " << bytes / 1024
+                      << " KiB, raycast " << brickMs << " ms, " << differing << " of " << image.size()
+                      << " pixels differ" << check(differing == 0, "", " MISMATCH") << ", round trip " << check(roundTrip, "ok")
+                      << std::endl;
+        }
+    }
+}
+
+void benchmarkAttributeEncodings() {
+    std::cout << "== Attribute encodings: color memory, error and CPU traversal ==" << std::endl;
+    const char* names[] = {"Float", "RGBA8", "RGB565", "Palette8", "Palette16"};
+    glm::vec3 cameraPos(50.0f, 30.0f, 120.0f);
+    std::vector<glm::vec3> rays = cameraRays(200, 150, cameraPos, glm::vec3(0.0f, -0.3f, -1.0f));
+    for (int maxDepth = 8; maxDepth <= 9; maxDepth++) {
+        int octreeSize = 1000;
+        SparseVoxelOctree octree(octreeSize, maxDepth);
+        octree.BuildFromVoxels(generateTerrainVoxels(octreeSize, maxDepth));
+        CompactOctree reference = octree.ToCompact(8);
+        std::vector<glm::vec4> referenceImage;
+        renderRays(CompactView{reference}, rays, cameraPos, static_cast<float>(octreeSize), referenceImage);
+        std::cout << "maxDepth " << maxDepth << ": " << reference.nodes.size() << " nodes, "
+                  << reference.brickColors.size() / 4 << " brick voxels" << std::endl;
+
+        for (int e = 0; e <= static_cast<int>(AttributeEncoding::Palette16); e++) {
+            AttributeEncoding encoding = static_cast<AttributeEncoding>(e);
+            auto start = std::chrono::steady_clock::now();
+            CompactOctree compact = octree.ToCompact(8, encoding);
+            double convertMs = elapsedMs(start);
+            size_t bytes = (compact.colors.size() + compact.brickColors.size()) * sizeof(uint32_t) +
+                           compact.palette.size() * sizeof(glm::vec4);
+
+            float maxError = 0.0f;
+            for (size_t i = 0; i < compact.nodes.size(); i++) {
+                glm::vec4 d = glm::abs(compact.nodeColor(i) - reference.nodeColor(i));
+                maxError = std::max(maxError, std::max(std::max(d.r, d.g), std::max(d.b, d.a)));
+            }
+            for (size_t i = 0; i < reference.brickColors.size() / 4; i++) {
+                glm::vec4 d = glm::abs(compact.brickColor(i) - reference.brickColor(i));
+                maxError = std::max(maxError, std::max(std::max(d.r, d.g), std::max(d.b, d.a)));
+            }
+
+            std::vector<glm::vec4> image;
+            double renderMs = renderRays(CompactView{compact}, rays, cameraPos, static_cast<float>(octreeSize), image);
+            float maxPixelError = 0.0f;
+            for (size_t i = 0; i < image.size(); i++) {
+                glm::vec3 d = glm::abs(glm::vec3(image[i]) - glm::vec3(referenceImage[i]));
+                maxPixelError = std::max(maxPixelError, std::max(std::max(d.r, d.g), d.b));
+            }
+            std::cout << "  " << names[e] << ": colors " << bytes / 1024 << " KiB";
+            if (isPaletteEncoding(encoding)) {
+                std::cout << " (" << compact.palette.size() << " palette entries)";
+            }
+            std::cout << " | ToCompact " << convertMs << " ms | max channel error " << maxError
+                      << " | raycast " << renderMs << " ms, max pixel error " << maxPixelError << std::endl;
+        }
+    }
+}
+
+void benchmarkDAG() {
+    std::cout << "== DAG compression: shared subtrees ==" << std::endl;
+    glm::vec3 cameraPos(50.0f, 30.0f, 120.0f);
+    std::vector<glm::vec3> rays = cameraRays(200, 150, cameraPos, glm::vec3(0.0f, -0.3f, -1.0f));
+    for (int maxDepth = 7; maxDepth <= 10; maxDepth++) {
+        int octreeSize = 1000;
+        SparseVoxelOctree octree(octreeSize, maxDepth);
+        octree.BuildFromVoxels(generateTerrainVoxels(octreeSize, maxDepth));
+        std::vector<FlattenedNode> tree = octree.ExportNodes();
+
+        auto start = std::chrono::steady_clock::now();
+        octree.CompressToDAG();
+        double compressMs = elapsedMs(start);
+        std::vector<FlattenedNode> dag = octree.ExportNodes();
+
+        std::vector<glm::vec4> treeImage, dagImage;
+        double treeMs = renderRays(FlattenedView{tree}, rays, cameraPos, static_cast<float>(octreeSize), treeImage);
+        double dagMs = renderRays(FlattenedView{dag}, rays, cameraPos, static_cast<float>(octreeSize), dagImage);
+        std::cout << "maxDepth " << maxDepth << ": " << tree.size() << " -> " << dag.size() << " nodes ("
+                  << static_cast<double>(tree.size()) / dag.size() << "x), "
+                  << tree.size() * sizeof(FlattenedNode) / 1024 << " -> " << dag.size() * sizeof(FlattenedNode) / 1024
+                  << " KiB | CompressToDAG " << compressMs << " ms | "
+                  << check(sameSubtree(tree, 0, dag, 0), "same tree") << " | raycast tree " << treeMs
+                  << " ms, DAG " << dagMs << " ms | images " << check(treeImage == dagImage, "identical", "DIFFER") << std::endl;
+    }
+}
+
+// Removes a block of voxels and sets a spread of others, so the freed slots are handed back
+// to nodes far from their parents.
+void editTerrain(SparseVoxelOctree& octree) {
+    for (int x = 8; x < 40; x++) {
+        for (int y = 0; y < 24; y++) {
+            for (int z = 16; z < 48; z++) {
+                octree.Remove(glm::ivec3(x, y, z));
+            }
+        }
+    }
+    for (int x = 0; x < 64; x += 3) {
+        for (int z = 0; z < 64; z += 5) {
+            octree.Set(glm::ivec3(x, 30 + (x + z) % 7, z), glm::vec4(x / 64.0f, 0.5f, z / 64.0f, 1.0f));
+        }
+    }
+}
+
+// Carves a tunnel, adds a boulder and repaints part of it, each through one brush.
+void brushTerrain(SparseVoxelOctree& octree) {
+    glm::vec4 rock(0.45f, 0.4f, 0.35f, 1.0f);
+    glm::vec4 paint(0.9f, 0.3f, 0.1f, 1.0f);
+    octree.ApplyBrush({BrushShape::Capsule, BrushOp::Subtract, glm::vec3(4.0f, 8.0f, 10.0f), glm::vec3(60.0f, 14.0f, 50.0f),
+                       6.0f, rock});
+    octree.ApplyBrush({BrushShape::Sphere, BrushOp::Union, glm::vec3(32.0f, 28.0f, 32.0f), glm::vec3(0.0f), 11.0f, rock});
+    octree.ApplyBrush({BrushShape::Box, BrushOp::Paint, glm::vec3(20.0f, 0.0f, 20.0f), glm::vec3(44.0f, 40.0f, 36.0f), 0.0f,
+                       paint});
+    octree.ApplyBrush({BrushShape::Sphere, BrushOp::Subtract, glm::vec3(40.0f, 30.0f, 28.0f), glm::vec3(0.0f), 5.0f, rock});
+}
+
+// The same cells, built from scratch.
+void rebuildFromCells(const SparseVoxelOctree& octree, SparseVoxelOctree& rebuilt) {
+    std::vector<VoxelSample> voxels;
+    glm::vec4 color;
+    for (int x = 0; x < octree.Size(); x++) {
+        for (int y = 0; y < octree.Size(); y++) {
+            for (int z = 0; z < octree.Size(); z++) {
+                if (octree.Get(glm::ivec3(x, y, z), color)) {
+                    voxels.push_back({glm::ivec3(x, y, z), color});
+                }
+            }
+        }
+    }
+    rebuilt.BuildFromVoxels(voxels);
+}
+
+int differingCells(const SparseVoxelOctree& a, const SparseVoxelOctree& b) {
+    int differing = 0;
+    for (int x = 0; x < a.Size(); x++) {
+        for (int y = 0; y < a.Size(); y++) {
+            for (int z = 0; z < a.Size(); z++) {
+                glm::vec4 colorA, colorB;
+                bool hasA = a.Get(glm::ivec3(x, y, z), colorA);
+                bool hasB = b.Get(glm::ivec3(x, y, z), colorB);
+                differing += (hasA != hasB || (hasA && colorA != colorB)) ? 1 : 0;
+            }
+        }
+    }
+    return differing;
+}
+
+// CompressToDAG and FilterColors on an edited tree, where freed slots put children ahead of
+// their parents, against the same cells rebuilt in builder order.
+void benchmarkEditedDAG() {
+    std::cout << "== DAG and filtered colors after edits ==" << std::endl;
+    int octreeSize = 64;
+    int maxDepth = 6;
+    std::vector<VoxelSample> voxels = generateTerrainVoxels(octreeSize, maxDepth);
+    struct Edit {
+        const char* name;
+        void (*apply)(SparseVoxelOctree&);
+    };
+    for (Edit edit : {Edit{"Remove + Set", editTerrain}, Edit{"brushes", brushTerrain}}) {
+        SparseVoxelOctree dag(octreeSize, maxDepth), filtered(octreeSize, maxDepth);
+        for (SparseVoxelOctree* octree : {&dag, &filtered}) {
+            octree->BuildFromVoxels(voxels);
+            edit.apply(*octree);
+        }
+        SparseVoxelOctree rebuilt(octreeSize, maxDepth);
+        rebuildFromCells(dag, rebuilt);
+
+        dag.CompressToDAG();
+        int differing = differingCells(dag, rebuilt);
+        filtered.FilterColors();
+        rebuilt.FilterColors();
+        const FlattenedNode& root = filtered.Nodes()[0];
+        const FlattenedNode& rebuiltRoot = rebuilt.Nodes()[0];
+        float colorError = glm::length(root.color - rebuiltRoot.color);
+        float coverageError = std::abs(root.coverage - rebuiltRoot.coverage);
+        std::cout << edit.name << ": DAG " << dag.Nodes().Size() << " nodes, " << differing << " cells differ"
+                  << check(differing == 0, "", " MISMATCH") << " | filtered root color error " << colorError << ", coverage error "
+                  << coverageError << check(colorError <= 1e-4f && coverageError <= 1e-4f, "", " MISMATCH") << std::endl;
+    }
+
+    // Edits on a DAG would write nodes that several parents share, so they must be refused,
+    // also on a DAG loaded from its nodes, until the tree is built again.
+    SparseVoxelOctree dag(octreeSize, maxDepth);
+    dag.BuildFromVoxels(voxels);
+    dag.CompressToDAG();
+    std::vector<FlattenedNode> compressed = dag.ExportNodes();
+    SparseVoxelOctree loaded(octreeSize, maxDepth);
+    loaded.LoadNodes(compressed.data(), compressed.size());
+    bool refused = true;
+    for (SparseVoxelOctree* octree : {&dag, &loaded}) {
+        glm::vec4 red(1.0f, 0.0f, 0.0f, 1.0f);
+        octree->Set(glm::ivec3(5, 6, 7), red);
+        refused = !octree->Remove(glm::ivec3(20, 2, 20)) && refused;
+        octree->ApplyBrush({BrushShape::Sphere, BrushOp::Paint, glm::vec3(32.0f), glm::vec3(0.0f), 8.0f, red});
+        refused = octree->CollapseUniform(1.0f) == 0 && refused;
+        std::vector<FlattenedNode> after = octree->ExportNodes();
+        refused = after.size() == compressed.size() && sameSubtree(compressed, 0, after, 0) && refused;
+    }
+    dag.BuildFromVoxels(voxels);
+    glm::vec4 color;
+    dag.Set(glm::ivec3(5, 6, 7), glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
+    bool editable = dag.Get(glm::ivec3(5, 6, 7), color) && color == glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+    std::cout << "edits on a DAG " << check(refused, "refused", "APPLIED") << " | after a rebuild "
+              << check(editable, "applied", "REFUSED") << std::endl;
+}
+
+// Mean absolute RGB difference per pixel.
+float meanImageError(const std::vector<glm::vec4>& a, const std::vector<glm::vec4>& b) {
+    double total = 0.0;
+    for (size_t i = 0; i < a.size(); i++) {
+        glm::vec3 d = glm::abs(glm::vec3(a[i]) - glm::vec3(b[i]));
+        total += (d.r + d.g + d.b) / 3.0f;
+    }
+    return static_cast<float>(total / a.size());
+}
+
+void benchmarkFilteredColors() {
+    std::cout << "== Filtered interior colors: level of detail cutoff ==" << std::endl;
+    // Looking across the whole terrain from one edge, where most of it is far away.
+    int width = 200, height = 150;
+    glm::vec3 cameraPos(500.0f, 60.0f, 990.0f);
+    std::vector<glm::vec3> rays = cameraRays(width, height, cameraPos, glm::vec3(0.0f, -0.1f, -1.0f));
+    float pixelScale = 2.0f * std::tan(glm::radians(45.0f / 2.0f)) / height;
+    for (int maxDepth = 8; maxDepth <= 10; maxDepth++) {
+        int octreeSize = 1000;
+        std::vector<VoxelSample> voxels = generateTerrainVoxels(octreeSize, maxDepth);
+        SparseVoxelOctree octree(octreeSize, maxDepth);
+        octree.BuildFromVoxels(voxels);
+        std::vector<FlattenedNode> unfiltered = octree.ExportNodes();
+        auto start = std::chrono::steady_clock::now();
+        octree.FilterColors();
+        double filterMs = elapsedMs(start);
+        std::vector<FlattenedNode> filtered = octree.ExportNodes();
+        std::cout << "maxDepth " << maxDepth << ": " << filtered.size() << " nodes | FilterColors " << filterMs << " ms";
+
+        if (maxDepth == 8) {
+            // Filtering while inserting must end up where filtering afterwards does.
+            SparseVoxelOctree incremental(octreeSize, maxDepth);
+            incremental.FilterColors();
+            start = std::chrono::steady_clock::now();
+            for (const VoxelSample& voxel : voxels) {
+                incremental.Insert(glm::vec3(voxel.position), voxel.color);
+            }
+            double insertMs = elapsedMs(start);
+            std::cout << " | filtered Insert " << insertMs << " ms, "
+                      << check(sameSubtree(filtered, 0, incremental.ExportNodes(), 0), "matches");
+        }
+        std::cout << std::endl;
+
+        std::vector<glm::vec4> reference;
+        double fullMs = renderRays(FlattenedView{filtered}, rays, cameraPos, static_cast<float>(octreeSize), reference);
+        std::cout << "  full detail: raycast " << fullMs << " ms" << std::endl;
+        for (float pixels = 1.0f; pixels <= 8.0f; pixels *= 2.0f) {
+            std::vector<glm::vec4> lastColor, averaged;
+            renderRays(FlattenedView{unfiltered}, rays, cameraPos, static_cast<float>(octreeSize), lastColor,
+                       pixels * pixelScale);
+            double lodMs = renderRays(FlattenedView{filtered}, rays, cameraPos, static_cast<float>(octreeSize), averaged,
+                                      pixels * pixelScale);
+            std::cout << "  cutoff " << pixels << " px: raycast " << lodMs << " ms | mean error vs full detail: "
+                      << "filtered " << meanImageError(averaged, reference) << ", last-inserted "
+                      << meanImageError(lastColor, reference) << std::endl;
+        }
+    }
+}
+
+void benchmarkNodePool() {
+    std::cout << "== Node pool: allocation against std::vector ==" << std::endl;
+    for (size_t count = 1 << 20; count <= (1 << 22); count <<= 1) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<FlattenedNode> grown;
+        for (size_t i = 0; i < count; i++) {
+            grown.push_back(FlattenedNode());
+        }
+        double vectorMs = elapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        std::vector<FlattenedNode> reserved;
+        reserved.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            reserved.push_back(FlattenedNode());
+        }
+        double reservedMs = elapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        NodePool<FlattenedNode> pool;
+        for (size_t i = 0; i < count; i++) {
+            pool.Allocate();
+        }
+        double poolMs = elapsedMs(start);
+
+        // Free every other node and take the slots back.
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; i += 2) {
+            pool.Free(static_cast<int>(i));
+        }
+        for (size_t i = 0; i < count; i += 2) {
+            pool.Allocate();
+        }
+        double churnMs = elapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        std::vector<FlattenedNode> exported = pool.Export();
+        double exportMs = elapsedMs(start);
+
+        std::cout << count << " nodes: vector " << vectorMs << " ms, reserved vector " << reservedMs
+                  << " ms, pool " << poolMs << " ms | free + reuse half " << churnMs << " ms, pool size "
+                  << pool.Size() << " | export " << exportMs << " ms" << std::endl;
+    }
+}
+
+void benchmarkEdits() {
+    std::cout << "== Voxel edits: Remove / Set / Get with dirty ranges ==" << std::endl;
+    for (int maxDepth = 8; maxDepth <= 10; maxDepth++) {
+        int octreeSize = 1000;
+        std::vector<VoxelSample> voxels = generateTerrainVoxels(octreeSize, maxDepth);
+        SparseVoxelOctree octree(octreeSize, maxDepth);
+        octree.BuildFromVoxels(voxels);
+        std::vector<FlattenedNode> original = octree.ExportNodes();
+        octree.TakeDirtyRanges();
+
+        // Every 16th sample, spread over the whole terrain, with the color its cell ended up with.
+        std::vector<VoxelSample> edits;
+        for (size_t i = 0; i < voxels.size(); i += 16) {
+            VoxelSample edit = voxels[i];
+            octree.Get(edit.position, edit.color);
+            edits.push_back(edit);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        size_t removed = 0;
+        for (const VoxelSample& voxel : edits) {
+            removed += octree.Remove(voxel.position) ? 1 : 0;
+        }
+        double removeMs = elapsedMs(start);
+        size_t freed = octree.Nodes().FreeCount();
+        std::vector<NodeRange> dirty = octree.TakeDirtyRanges();
+        size_t dirtyNodes = 0;
+        for (const NodeRange& range : dirty) {
+            dirtyNodes += range.end - range.begin;
+        }
+
+        bool allGone = true;
+        glm::vec4 color;
+        for (const VoxelSample& voxel : edits) {
+            allGone = allGone && !octree.Get(voxel.position, color);
+        }
+
+        // Putting the voxels back has to reuse the freed slots and restore the tree.
+        start = std::chrono::steady_clock::now();
+        for (const VoxelSample& voxel : voxels) {
+            octree.Get(voxel.position, color);
+        }
+        double getMs = elapsedMs(start);
+        start = std::chrono::steady_clock::now();
+        for (const VoxelSample& voxel : edits) {
+            octree.Set(voxel.position, voxel.color);
+        }
+        double setMs = elapsedMs(start);
+        bool restored = sameSubtree(original, 0, octree.ExportNodes(), 0, true);
+
+        std::cout << "maxDepth " << maxDepth << ": " << original.size() << " nodes | Remove " << removed << " voxels "
+                  << removeMs * 1000.0 / edits.size() << " us each, " << freed << " nodes freed, "
+                  << dirty.size() << " dirty ranges covering " << dirtyNodes * sizeof(FlattenedNode) / 1024 << " of "
+                  << original.size() * sizeof(FlattenedNode) / 1024 << " KiB | Get " << getMs * 1000.0 / voxels.size()
+                  << " us each | Set " << setMs * 1000.0 / edits.size() << " us each, pool grew by "
+                  << octree.Nodes().Size() - original.size() << " | " << check(allGone, "removed", "NOT REMOVED") << ", "
+                  << check(restored, "restored") << std::endl;
+    }
+}
+
+// Applies brush to reference one voxel at a time, the way ApplyBrush decides per voxel:
+// every cell is one unit, so a voxel is inside when p + 0.5 is.
+void applyBrushPerVoxel(SparseVoxelOctree& reference, const Brush& brush, glm::ivec3 lo, glm::ivec3 hi) {
+    glm::vec4 color;
+    for (int x = lo.x; x < hi.x; x++) {
+        for (int y = lo.y; y < hi.y; y++) {
+            for (int z = lo.z; z < hi.z; z++) {
+                glm::ivec3 p(x, y, z);
+                if (!brushContains(brush, glm::vec3(p) + 0.5f)) {
+                    continue;
+                }
+                if (brush.op == BrushOp::Union || (brush.op == BrushOp::Paint && reference.Get(p, color))) {
+                    reference.Set(p, brush.color);
+                } else if (brush.op == BrushOp::Subtract) {
+                    reference.Remove(p);
+                }
+            }
+        }
+    }
+}
+
+void benchmarkBrushes() {
+    std::cout << "== CSG brushes: subtree edits against per-voxel edits ==" << std::endl;
+    const char* shapeNames[] = {"sphere", "box", "capsule"};
+    const char* opNames[] = {"union", "subtract", "paint"};
+    glm::vec4 paint(0.9f, 0.3f, 0.1f, 1.0f);
+
+    // 1 unit cells, so the per-voxel reference can visit every cell of the brush.
+    int octreeSize = 512;
+    int maxDepth = 9;
+    std::vector<VoxelSample> voxels = generateTerrainVoxels(octreeSize, maxDepth);
+    glm::vec3 center(256.0f, 10.0f, 256.0f);
+    for (int shape = 0; shape < 3; shape++) {
+        for (int op = 0; op < 3; op++) {
+            Brush brush = {static_cast<BrushShape>(shape), static_cast<BrushOp>(op), center, center, 20.0f, paint};
+            if (brush.shape == BrushShape::Box) {
+                brush.a = center - glm::vec3(18.0f, 7.0f, 25.0f);
+                brush.b = center + glm::vec3(21.0f, 9.0f, 12.0f);
+            } else if (brush.shape == BrushShape::Capsule) {
+                brush.a = center - glm::vec3(30.0f, 5.0f, 10.0f);
+                brush.b = center + glm::vec3(25.0f, 0.0f, 20.0f);
+                brush.radius = 8.0f;
+            }
+            SparseVoxelOctree octree(octreeSize, maxDepth);
+            octree.BuildFromVoxels(voxels);
+            SparseVoxelOctree reference(octreeSize, maxDepth);
+            reference.BuildFromVoxels(voxels);
+
+            glm::ivec3 lo = glm::max(glm::ivec3(glm::floor(center - 60.0f)), glm::ivec3(0));
+            glm::ivec3 hi = glm::min(glm::ivec3(glm::ceil(center + 60.0f)), glm::ivec3(octreeSize));
+            auto start = std::chrono::steady_clock::now();
+            octree.ApplyBrush(brush);
+            double brushMs = elapsedMs(start);
+            start = std::chrono::steady_clock::now();
+            applyBrushPerVoxel(reference, brush, lo, hi);
+            double perVoxelMs = elapsedMs(start);
+
+            int differing = 0;
+            for (int x = lo.x; x < hi.x; x++) {
+                for (int y = lo.y; y < hi.y; y++) {
+                    for (int z = lo.z; z < hi.z; z++) {
+                        glm::vec4 a, b;
+                        bool hasA = octree.Get(glm::ivec3(x, y, z), a);
+                        bool hasB = reference.Get(glm::ivec3(x, y, z), b);
+                        differing += (hasA != hasB || (hasA && a != b)) ? 1 : 0;
+                    }
+                }
+            }
+            std::cout << "  " << shapeNames[shape] << " " << opNames[op] << ": brush " << brushMs << " ms, per voxel "
+                      << perVoxelMs << " ms | " << differing << " voxels differ" << check(differing == 0, "", " MISMATCH")
+                      << std::endl;
+        }
+    }
+
+    std::cout << "sphere radius vs edit latency, maxDepth 10 (size 1000):" << std::endl;
+    octreeSize = 1000;
+    maxDepth = 10;
+    voxels = generateTerrainVoxels(octreeSize, maxDepth);
+    SparseVoxelOctree octree(octreeSize, maxDepth);
+    octree.BuildFromVoxels(voxels);
+    octree.TakeDirtyRanges();
+    center = glm::vec3(500.0f, 10.0f, 500.0f);
+    for (float radius = 4.0f; radius <= 256.0f; radius *= 4.0f) {
+        std::cout << "  radius " << radius << ":";
+        for (BrushOp op : {BrushOp::Union, BrushOp::Paint, BrushOp::Subtract}) {
+            Brush brush = {BrushShape::Sphere, op, center, center, radius, paint};
+            auto start = std::chrono::steady_clock::now();
+            octree.ApplyBrush(brush);
+            double brushMs = elapsedMs(start);
+            size_t dirtyNodes = 0;
+            for (const NodeRange& range : octree.TakeDirtyRanges()) {
+                dirtyNodes += range.end - range.begin;
+            }
+            std::cout << " " << opNames[static_cast<int>(op)] << " " << brushMs << " ms (" << dirtyNodes << " nodes)";
+        }
+        std::cout << " | pool " << octree.Nodes().Size() << " nodes, " << octree.Nodes().FreeCount() << " free" << std::endl;
+    }
+}
+
+bool sameNodes(const std::vector<FlattenedNode>& a, const std::vector<FlattenedNode>& b) {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(FlattenedNode)) == 0;
+}
+
+// Describes how a collapsed tree's image differs from the full tree's. Rays can slip
+// through float cracks between neighbouring leaf boxes; a coarse leaf has no such seams,
+// so pixels that only the full tree misses are expected.
+std::string crackPixels(const std::vector<glm::vec4>& full, const std::vector<glm::vec4>& collapsed) {
+    int differing = 0;
+    int cracks = 0;
+    for (size_t i = 0; i < full.size(); i++) {
+        if (full[i] != collapsed[i]) {
+            differing++;
+            cracks += (full[i] == glm::vec4(0.0f)) ? 1 : 0;
+        }
+    }
+    if (differing == 0) {
+        return "images identical";
+    }
+    return std::to_string(differing) + " pixels differ, " + std::to_string(cracks) + " of them cracks in the full tree" +
+           check(differing == cracks, "", " MISMATCH");
+}
+
+void benchmarkCollapse() {
+    std::cout << "== Uniform subtree collapse: post-pass and inline in the bulk build ==" << std::endl;
+    glm::vec3 cameraPos(50.0f, 30.0f, 120.0f);
+    std::vector<glm::vec3> rays = cameraRays(200, 150, cameraPos, glm::vec3(0.0f, -0.3f, -1.0f));
+    struct Case {
+        int size;
+        int maxDepth;
+    };
+    for (Case c : {Case{1000, 8}, Case{1000, 10}, Case{512, 9}, Case{1024, 10}}) {
+        std::vector<VoxelSample> voxels = generateTerrainVoxels(c.size, c.maxDepth);
+        SparseVoxelOctree octree(c.size, c.maxDepth);
+        auto start = std::chrono::steady_clock::now();
+        octree.BuildFromVoxels(voxels);
+        double buildMs = elapsedMs(start);
+        std::vector<FlattenedNode> full = octree.ExportNodes();
+        std::vector<glm::vec4> reference;
+        renderRays(FlattenedView{full}, rays, cameraPos, static_cast<float>(c.size), reference);
+
+        start = std::chrono::steady_clock::now();
+        size_t saved = octree.CollapseUniform();
+        double collapseMs = elapsedMs(start);
+        std::vector<FlattenedNode> collapsed = octree.ExportNodes();
+        std::vector<glm::vec4> image;
+        renderRays(FlattenedView{collapsed}, rays, cameraPos, static_cast<float>(c.size), image);
+
+        SparseVoxelOctree inlineTree(c.size, c.maxDepth);
+        inlineTree.SetBuildCollapse(true);
+        start = std::chrono::steady_clock::now();
+        inlineTree.BuildFromVoxels(voxels);
+        double inlineMs = elapsedMs(start);
+        bool inlineSame = sameNodes(collapsed, inlineTree.ExportNodes());
+        inlineTree.BuildFromVoxelsParallel(voxels, 4, 2);
+        bool parallelSame = sameNodes(collapsed, inlineTree.ExportNodes());
+
+        std::cout << "size " << c.size << ", maxDepth " << c.maxDepth << ": " << full.size() << " -> " << collapsed.size()
+                  << " nodes (" << saved << " saved, " << 100.0 * saved / full.size() << "%) | build " << buildMs
+                  << " ms + CollapseUniform " << collapseMs << " ms, inline build " << inlineMs << " ms | inline "
+                  << check(inlineSame, "identical") << ", parallel " << check(parallelSame, "identical")
+                  << " | " << crackPixels(reference, image) << std::endl;
+
+        for (float tolerance : {0.05f, 0.35f}) {
+            SparseVoxelOctree lossy(c.size, c.maxDepth);
+            lossy.SetBuildCollapse(true, tolerance);
+            lossy.BuildFromVoxels(voxels);
+            std::vector<FlattenedNode> nodes = lossy.ExportNodes();
+            renderRays(FlattenedView{nodes}, rays, cameraPos, static_cast<float>(c.size), image);
+            std::cout << "  tolerance " << tolerance << ": " << nodes.size() << " nodes ("
+                      << 100.0 * (full.size() - nodes.size()) / full.size() << "% saved), mean pixel error "
+                      << meanImageError(image, reference) << std::endl;
+        }
+    }
+
+    // Setting one voxel inside a coarse leaf has to keep the rest of its cube in the old color.
+    SparseVoxelOctree uniform(64, 6);
+    const glm::vec4 green(0.2f, 0.7f, 0.2f, 1.0f), red(0.9f, 0.1f, 0.1f, 1.0f);
+    for (int x = 0; x < 16; x++) {
+        for (int y = 0; y < 16; y++) {
+            for (int z = 0; z < 16; z++) {
+                uniform.Set(glm::ivec3(x, y, z), green);
+            }
+        }
+    }
+    size_t before = uniform.ExportNodes().size();
+    uniform.CollapseUniform();
+    size_t collapsedNodes = uniform.ExportNodes().size();
+    uniform.Set(glm::ivec3(5, 6, 7), red);
+    int recolored = 0;
+    for (int x = 0; x < 16; x++) {
+        for (int y = 0; y < 16; y++) {
+            for (int z = 0; z < 16; z++) {
+                glm::vec4 color;
+                glm::vec4 expected = (glm::ivec3(x, y, z) == glm::ivec3(5, 6, 7)) ? red : green;
+                recolored += (!uniform.Get(glm::ivec3(x, y, z), color) || color != expected) ? 1 : 0;
+            }
+        }
+    }
+    std::cout << "Set inside a collapsed leaf (" << before << " -> " << collapsedNodes << " nodes): "
+              << check(recolored == 0 && collapsedNodes < before, "siblings keep their color") << std::endl;
+}
+
+bool sameCompact(const CompactOctree& a, const CompactOctree& b) {
+    return a.nodes.size() == b.nodes.size() &&
+           std::memcmp(a.nodes.data(), b.nodes.data(), a.nodes.size() * sizeof(CompactNode)) == 0 &&
+           a.encoding == b.encoding && a.colors == b.colors && a.palette == b.palette &&
+           a.brickSize == b.brickSize && a.bricks == b.bricks && a.brickColors == b.brickColors;
+}
+
+void benchmarkFileFormat() {
+    std::cout << "== Octree file: save, map and load ==" << std::endl;
+    const std::string path = "benchmark.octree";
+    for (int maxDepth = 8; maxDepth <= 10; maxDepth++) {
+        int octreeSize = 1000;
+        auto start = std::chrono::steady_clock::now();
+        SparseVoxelOctree octree(octreeSize, maxDepth);
+        octree.BuildFromVoxels(generateTerrainVoxels(octreeSize, maxDepth));
+        octree.FilterColors();
+        double generateMs = elapsedMs(start);
+        std::vector<FlattenedNode> nodes = octree.ExportNodes();
+
+        start = std::chrono::steady_clock::now();
+        bool saved = saveOctreeFile(path, octree);
+        double saveMs = elapsedMs(start);
+
+        // Map, which checks every child link once, then read one byte per page so the time
+        // includes faulting the nodes in.
+        start = std::chrono::steady_clock::now();
+        MappedOctreeFile file;
+        bool opened = saved && file.Open(path);
+        double mapMs = elapsedMs(start);
+        volatile unsigned int touched = 0; // keeps the reads from being optimized away
+        start = std::chrono::steady_clock::now();
+        if (opened) {
+            const unsigned char* bytes = static_cast<const unsigned char*>(file.Section(OctreeSection::Nodes));
+            for (size_t i = 0; i < file.SectionBytes(OctreeSection::Nodes); i += 4096) {
+                touched += bytes[i];
+            }
+        }
+        double touchMs = elapsedMs(start);
+        bool mappedOk = opened && file.NodeCount() == nodes.size() && file.Header().maxDepth == maxDepth &&
+                        std::memcmp(file.FlattenedNodes(), nodes.data(), nodes.size() * sizeof(FlattenedNode)) == 0;
+
+        start = std::chrono::steady_clock::now();
+        SparseVoxelOctree loaded(octreeSize, maxDepth);
+        if (opened) {
+            loaded.LoadNodes(file.FlattenedNodes(), file.NodeCount());
+        }
+        double loadMs = elapsedMs(start);
+        std::vector<FlattenedNode> loadedNodes = loaded.ExportNodes();
+        bool loadOk = loadedNodes.size() == nodes.size() &&
+                      std::memcmp(loadedNodes.data(), nodes.data(), nodes.size() * sizeof(FlattenedNode)) == 0;
+        size_t fileBytes = opened ? file.Header().fileBytes : 0;
+        file.Close();
+
+        // What loading cost before: read the whole file into memory.
+        start = std::chrono::steady_clock::now();
+        std::ifstream stream(path, std::ios::binary);
+        std::vector<char> contents(fileBytes);
+        stream.read(contents.data(), static_cast<std::streamsize>(contents.size()));
+        double readMs = elapsedMs(start);
+
+        CompactOctree compact = octree.ToCompact(8, AttributeEncoding::Palette8);
+        bool compactOk = saveOctreeFile(path, compact, octreeSize, maxDepth) && file.Open(path) &&
+                         sameCompact(file.ToCompact(), compact);
+        file.Close();
+
+        std::cout << "maxDepth " << maxDepth << ": " << nodes.size() << " nodes, " << fileBytes / 1024
+                  << " KiB | generate " << generateMs << " ms | save " << saveMs << " ms | map " << mapMs
+                  << " ms + page in " << touchMs << " ms | LoadNodes " << loadMs << " ms | read whole file "
+                  << readMs << " ms | round trip " << check(mappedOk && loadOk, "ok") << ", compact "
+                  << check(compactOk, "ok") << std::endl;
+    }
+
+    // Damaged files have to be rejected, not read out of bounds.
+    MappedOctreeFile file;
+    SparseVoxelOctree small(64, 6);
+    small.BuildFromVoxels(generateTerrainVoxels(64, 6));
+    bool generatorKept = saveOctreeFile(path, small, 7) && file.Open(path) && file.Header().generator == 7;
+    file.Close();
+    // Overwrites 4 bytes at offset into the node section.
+    auto corruptNodes = [&](size_t offset, uint32_t value) {
+        OctreeFileHeader header;
+        std::fstream stream(path, std::ios::binary | std::ios::in | std::ios::out);
+        stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+        stream.seekp(static_cast<std::streamoff>(header.sections[0].offset + offset));
+        stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    corruptNodes(offsetof(FlattenedNode, childIndices) + 3 * sizeof(int), 1u << 30);
+    bool badChild = !file.Open(path);
+    saveOctreeFile(path, small.ToCompact(4, AttributeEncoding::Palette8), 64, 6);
+    corruptNodes(offsetof(CompactNode, firstChild), 0xffffff00u);
+    bool badCompactChild = !file.Open(path);
+    std::cout << "generator " << check(generatorKept, "kept") << " | child index out of range: flattened "
+              << check(badChild, "rejected", "ACCEPTED MISMATCH") << ", compact "
+              << check(badCompactChild, "rejected", "ACCEPTED MISMATCH") << std::endl;
+
+    std::fstream damaged(path, std::ios::binary | std::ios::in | std::ios::out);
+    damaged.seekp(0);
+    damaged.write("NOTOCTRE", 8);
+    damaged.close();
+    bool badMagic = !file.Open(path);
+    {
+        std::ofstream truncated(path, std::ios::binary | std::ios::trunc);
+        truncated.write("VOXOCTRE", 8);
+    }
+    bool badSize = !file.Open(path);
+    std::remove(path.c_str());
+    bool missing = !file.Open(path);
+    std::cout << "damaged files: bad magic " << check(badMagic, "rejected", "ACCEPTED") << ", truncated "
+              << check(badSize, "rejected", "ACCEPTED") << ", missing " << check(missing, "rejected", "ACCEPTED") << std::endl;
+}
+
+void benchmarkBitstream() {
+    std::cout << "== Breadth-first bitstream: size and throughput ==" << std::endl;
+    const std::string path = "benchmark.octbits";
+    for (int maxDepth = 8; maxDepth <= 10; maxDepth++) {
+        for (bool filtered : {false, true}) {
+            int octreeSize = 1000;
+            SparseVoxelOctree octree(octreeSize, maxDepth);
+            octree.BuildFromVoxels(generateTerrainVoxels(octreeSize, maxDepth));
+            if (filtered) {
+                octree.FilterColors();
+            }
+            std::vector<FlattenedNode> nodes = octree.ExportNodes();
+
+            auto start = std::chrono::steady_clock::now();
+            OctreeBitstream stream = octree.ToBitstream();
+            double encodeMs = elapsedMs(start);
+
+            // The round trip goes through the file, as an archived world would.
+            OctreeBitstream read;
+            bool readOk = stream.Save(path) && read.Load(path);
+
+            SparseVoxelOctree decoded(octreeSize, maxDepth);
+            start = std::chrono::steady_clock::now();
+            decoded.FromBitstream(read);
+            double decodeMs = elapsedMs(start);
+            std::vector<FlattenedNode> decodedNodes = decoded.ExportNodes();
+            OctreeBitstream again = decoded.ToBitstream();
+            bool exact = readOk && decodedNodes.size() == nodes.size() && sameSubtree(nodes, 0, decodedNodes, 0) &&
+                         again.masks == stream.masks && again.colors == stream.colors && again.palette == stream.palette;
+
+            // Throughput is given in megabytes of flattened nodes per second and in megabytes
+            // of bitstream per second.
+            double flatMB = nodes.size() * sizeof(FlattenedNode) / 1e6;
+            double streamMB = stream.Bytes() / 1e6;
+            std::cout << "maxDepth " << maxDepth << (filtered ? " filtered" : "") << ": " << nodes.size()
+                      << " nodes | geometry " << stream.masks.size() / 1024 << " KiB ("
+                      << static_cast<double>(stream.masks.size()) / nodes.size() << " bytes/node) | colors "
+                      << stream.colors.size() / 1024 << " KiB + palette " << stream.palette.size() << " | total "
+                      << stream.Bytes() / 1024 << " KiB, " << nodes.size() * sizeof(FlattenedNode) / stream.Bytes()
+                      << "x smaller | encode " << encodeMs << " ms (" << flatMB / encodeMs * 1000.0 << " MB/s nodes, "
+                      << streamMB / encodeMs * 1000.0 << " MB/s stream) | decode " << decodeMs << " ms ("
+                      << flatMB / decodeMs * 1000.0 << " MB/s nodes, " << streamMB / decodeMs * 1000.0
+                      << " MB/s stream) | round trip " << check(exact, "exact") << std::endl;
+        }
+    }
+    std::remove(path.c_str());
+
+    // Damaged byte forms must be refused, and so must streams whose counts do not add up.
+    SparseVoxelOctree octree(1000, 8);
+    octree.BuildFromVoxels(generateTerrainVoxels(1000, 8));
+    OctreeBitstream stream = octree.ToBitstream();
+    const std::vector<uint8_t> bytes = stream.Write();
+    auto refused = [](std::vector<uint8_t> damaged) {
+        OctreeBitstream read;
+        return !read.Read(damaged.data(), damaged.size()) && read.nodeCount == 0;
+    };
+    std::vector<uint8_t> badMagic = bytes, badVersion = bytes, badNodes = bytes, badMask = bytes, badColors = bytes;
+    badMagic[0] ^= 0xff;
+    badVersion[8]++;
+    badNodes[24]++;                                 // nodeCount
+    badMask[OCTREE_BITSTREAM_HEADER_BYTES] ^= 0x01; // root mask gains or loses a child
+    badColors[48]++;                                // colorCount
+    std::vector<uint8_t> truncated(bytes.begin(), bytes.end() - 1);
+    std::vector<uint8_t> extended = bytes;
+    extended.push_back(0);
+    std::vector<uint8_t> header(bytes.begin(), bytes.begin() + OCTREE_BITSTREAM_HEADER_BYTES);
+    bool allRefused = refused(badMagic) && refused(badVersion) && refused(badNodes) && refused(badMask) &&
+                      refused(badColors) && refused(truncated) && refused(extended) && refused(header);
+
+    OctreeBitstream counted = stream;
+    counted.colorCount--;
+    SparseVoxelOctree target(1000, 8);
+    target.BuildFromVoxels(generateTerrainVoxels(1000, 8));
+    size_t before = target.ExportNodes().size();
+    target.FromBitstream(counted);
+    bool keptTree = target.ExportNodes().size() == before;
+
+    OctreeBitstream empty;
+    empty.size = 1000;
+    empty.maxDepth = 8;
+    std::vector<uint8_t> emptyBytes = empty.Write();
+    OctreeBitstream emptyRead;
+    bool emptyOk = emptyRead.Read(emptyBytes.data(), emptyBytes.size()) && emptyRead.nodeCount == 0;
+    std::cout << "byte form " << bytes.size() / 1024 << " KiB, header " << OCTREE_BITSTREAM_HEADER_BYTES
+              << " bytes | damaged streams " << check(allRefused && keptTree, "refused")
+              << " | empty tree " << check(emptyOk, "reads back") << std::endl;
+}
+
+void benchmarkSuccinct() {
+    std::cout << "== Succinct octree: queries on the bitstream ==" << std::endl;
+    glm::vec3 cameraPos(50.0f, 30.0f, 120.0f);
+    std::vector<glm::vec3> rays = cameraRays(200, 150, cameraPos, glm::vec3(0.0f, -0.3f, -1.0f));
+    for (int maxDepth = 8; maxDepth <= 10; maxDepth++) {
+        for (bool filtered : {false, true}) {
+            int octreeSize = 1000;
+            SparseVoxelOctree octree(octreeSize, maxDepth);
+            std::vector<VoxelSample> voxels = generateTerrainVoxels(octreeSize, maxDepth);
+            octree.BuildFromVoxels(voxels);
+            if (filtered) {
+                octree.FilterColors();
+            }
+            std::vector<FlattenedNode> nodes = octree.ExportNodes();
+            OctreeBitstream stream = octree.ToBitstream();
+
+            auto start = std::chrono::steady_clock::now();
+            SuccinctOctree succinct(stream);
+            double buildMs = elapsedMs(start);
+
+            // Every sampled cell plus as many cells above the terrain, which are empty.
+            std::vector<glm::ivec3> points;
+            for (size_t i = 0; i < voxels.size(); i += 7) {
+                points.push_back(voxels[i].position);
+                points.push_back(voxels[i].position + glm::ivec3(0, octreeSize / 3, 0));
+            }
+            int mismatches = 0;
+            size_t hits = 0;
+            start = std::chrono::steady_clock::now();
+            for (const glm::ivec3& point : points) {
+                glm::vec4 color;
+                hits += succinct.Get(point, color) ? 1 : 0;
+            }
+            double succinctMs = elapsedMs(start);
+            start = std::chrono::steady_clock::now();
+            for (const glm::ivec3& point : points) {
+                glm::vec4 color;
+                hits -= octree.Get(point, color) ? 1 : 0;
+            }
+            double octreeMs = elapsedMs(start);
+            for (const glm::ivec3& point : points) {
+                glm::vec4 expected, color;
+                bool found = octree.Get(point, expected);
+                if (succinct.Get(point, color) != found || (found && color != expected)) {
+                    mismatches++;
+                }
+            }
+            for (size_t node = 1; node < succinct.NodeCount(); node += 97) {
+                size_t parent = succinct.Parent(node);
+                bool linked = false;
+                for (int slot = 0; slot < 8; slot++) {
+                    linked = linked || succinct.Child(parent, slot) == static_cast<int>(node);
+                }
+                mismatches += linked ? 0 : 1;
+            }
+
+            std::vector<glm::vec4> flatImage, succinctImage;
+            double flatMs = renderRays(FlattenedView{nodes}, rays, cameraPos, static_cast<float>(octreeSize), flatImage);
+            double rayMs = renderRays(SuccinctView{succinct}, rays, cameraPos, static_cast<float>(octreeSize), succinctImage);
+
+            size_t flatBytes = nodes.size() * sizeof(FlattenedNode);
+            std::cout << "maxDepth " << maxDepth << (filtered ? " filtered" : "") << ": " << nodes.size()
+                      << " nodes | flattened " << flatBytes / 1024 << " KiB, succinct " << succinct.Bytes() / 1024
+                      << " KiB (" << static_cast<double>(flatBytes) / succinct.Bytes() << "x smaller, "
+                      << static_cast<double>(succinct.Bytes()) / nodes.size() << " bytes/node) | build " << buildMs
+                      << " ms | " << points.size() << " Get: octree " << octreeMs << " ms, succinct " << succinctMs
+                      << " ms | raycast flattened " << flatMs << " ms, succinct " << rayMs << " ms | "
+                      << check(mismatches == 0 && hits == 0, "queries match") << ", images "
+                      << check(flatImage == succinctImage, "identical", "DIFFER") << std::endl;
+        }
+    }
+}
+
+void benchmarkChunkedWorld() {
+    std::cout << "== Chunked world: chunks around a moving camera ==" << std::endl;
+    // The chunks covering [0, 512) have to hold exactly what one 512 octree of the same
+    // voxel size holds.
+    ChunkedWorld world(128, 5, 2);
+    world.Update(glm::vec3(256.0f, 30.0f, 256.0f));
+    SparseVoxelOctree whole(512, 7);
+    std::vector<VoxelSample> voxels = generateTerrainChunk(glm::ivec3(0), 512, 7, 1000.0f);
+    whole.BuildFromVoxels(voxels);
+    int mismatches = 0;
+    for (const VoxelSample& voxel : voxels) {
+        for (glm::ivec3 point : {voxel.position, voxel.position + glm::ivec3(0, 100, 0)}) {
+            glm::vec4 expected, color;
+            bool found = whole.Get(point, expected);
+            if (world.Get(point, color) != found || (found && color != expected)) {
+                mismatches++;
+            }
+        }
+    }
+    ChunkGrid grid = world.Pack();
+    glm::vec3 cameraPos(256.0f, 40.0f, 300.0f);
+    std::vector<glm::vec3> rays = cameraRays(200, 150, cameraPos, glm::vec3(0.0f, -0.3f, -1.0f));
+    auto start = std::chrono::steady_clock::now();
+    int hits = 0;
+    for (const glm::vec3& rd : rays) {
+        hits += (raycastChunks(grid, cameraPos, rd) != glm::vec4(0.0f)) ? 1 : 0;
+    }
+    double rayMs = elapsedMs(start);
+    std::cout << world.ChunkCount() << " chunks, " << world.NodeCount() << " nodes, grid " << grid.dims.x << "x"
+              << grid.dims.y << "x" << grid.dims.z << " | Get against one octree: "
+              << check(mismatches == 0, "match") << " | raycast " << rays.size() << " rays " << rayMs
+              << " ms, " << hits << " hits" << std::endl;
+
+    // Fly in a straight line; resident chunks and nodes have to level off. Update includes
+    // copying new chunks into the pool; upload is what a frame sends to the GPU after it,
+    // the dirty pool ranges and the root grid, against the whole world Pack would send.
+    for (int viewRadius : {4, 8}) {
+        ChunkedWorld flight(128, 5, viewRadius);
+        size_t maxChunks = 0;
+        size_t maxNodes = 0;
+        size_t maxPool = 0;
+        double updateMs = 0.0;
+        double worstMs = 0.0;
+        size_t firstUpload = 0;     // the whole world, generated by the first Update
+        size_t uploadBytes = 0;
+        size_t worstUpload = 0;
+        int updates = 0;
+        int changes = 0;
+        int imageMismatches = 0;
+        for (float x = 0.0f; x <= 20000.0f; x += 64.0f) {
+            auto step = std::chrono::steady_clock::now();
+            bool changed = flight.Update(glm::vec3(x, 30.0f, 0.0f));
+            size_t bytes = 0;
+            if (changed) {
+                const ChunkGrid& pool = flight.Grid();
+                for (const NodeRange& range : flight.TakeDirtyRanges()) {
+                    bytes += (range.end - range.begin) * sizeof(FlattenedNode);
+                }
+                bytes += pool.roots.size() * sizeof(int);
+            }
+            double ms = elapsedMs(step);
+            updateMs += ms;
+            worstMs = std::max(worstMs, ms);
+            updates++;
+            if (updates == 1) {
+                firstUpload = bytes;
+            } else {
+                changes += changed ? 1 : 0;
+                uploadBytes += bytes;
+                worstUpload = std::max(worstUpload, bytes);
+            }
+            maxChunks = std::max(maxChunks, flight.ChunkCount());
+            maxNodes = std::max(maxNodes, flight.NodeCount());
+            maxPool = std::max(maxPool, flight.Grid().nodes.size());
+            // The pool has to draw what a fresh Pack draws.
+            if (updates % 64 == 0) {
+                glm::vec3 eye(x, 60.0f, 0.0f);
+                ChunkGrid reference = flight.Pack();
+                for (const glm::vec3& rd : cameraRays(64, 48, eye, glm::vec3(1.0f, -0.3f, 0.2f))) {
+                    imageMismatches += (raycastChunks(flight.Grid(), eye, rd) != raycastChunks(reference, eye, rd)) ? 1 : 0;
+                }
+            }
+        }
+        start = std::chrono::steady_clock::now();
+        ChunkGrid packed = flight.Pack();
+        double packMs = elapsedMs(start);
+        size_t packBytes = packed.nodes.size() * sizeof(FlattenedNode) + packed.roots.size() * sizeof(int);
+        std::cout << "view radius " << viewRadius << ", 20000 units: at most " << maxChunks << " chunks, "
+                  << maxNodes << " nodes (" << maxNodes * sizeof(FlattenedNode) / 1024 << " KiB), pool at most "
+                  << maxPool << " | Update mean " << updateMs / updates << " ms, worst " << worstMs
+                  << " ms | upload first " << firstUpload / 1024 << " KiB, then per change mean "
+                  << uploadBytes / std::max(changes, 1) / 1024 << " KiB, worst " << worstUpload / 1024
+                  << " KiB | full Pack " << packMs << " ms, " << packBytes / 1024
+                  << " KiB | pool " << check(imageMismatches == 0, "draws the same") << std::endl;
+    }
+}
+
+struct FlightStats {
+    double meanMs = 0.0;    // main thread time per frame spent streaming
+    double worstMs = 0.0;
+    int holeFrames = 0;     // frames with a chunk in view missing
+    int holes = 0;          // missing chunks summed over all frames
+    int frames = 0;
+};
+
+// Flies at speed units a second along direction for the given seconds in real time at 60
+// frames a second, calling update(cameraPos, front, deltaTime) each frame. The upload after
+// an update is left out (see benchmarkChunkedWorld). A hole is
+// a chunk within the view radius of the camera that is not resident yet.
+template <typename Update>
+FlightStats flyChunks(ChunkedWorld& world, glm::vec3 start, glm::vec3 direction, float speed, float seconds, Update update) {
+    FlightStats stats;
+    const float frameSeconds = 1.0f / 60.0f;
+    auto frameStart = std::chrono::steady_clock::now();
+    for (float t = 0.0f; t < seconds; t += frameSeconds) {
+        glm::vec3 cameraPos = start + direction * (speed * t);
+        auto begin = std::chrono::steady_clock::now();
+        update(cameraPos, direction, frameSeconds);
+        double ms = elapsedMs(begin);
+        stats.meanMs += ms;
+        stats.worstMs = std::max(stats.worstMs, ms);
+        int holes = 0;
+        for (const glm::ivec3& coord : world.ChunksAround(world.ChunkCoord(cameraPos), world.ViewRadius())) {
+            holes += world.IsResident(coord) ? 0 : 1;
+        }
+        stats.holes += holes;
+        stats.holeFrames += (holes > 0) ? 1 : 0;
+        stats.frames++;
+        frameStart += std::chrono::microseconds(16667);
+        std::this_thread::sleep_until(frameStart);
+    }
+    stats.meanMs /= stats.frames;
+    return stats;
+}
+
+void benchmarkChunkStreaming() {
+    std::cout << "== Chunk streaming: synchronous against background with prefetch ==" << std::endl;
+    const glm::vec3 start(0.0f, 30.0f, 0.0f);
+    const glm::vec3 direction(1.0f, 0.0f, 0.0f);
+    const float speed = 1500.0f;
+    const int budget = 4; // chunks a frame
+    const float seconds = 4.0f;
+    auto report = [](const char* name, const FlightStats& stats) {
+        std::cout << name << ": update mean " << stats.meanMs << " ms, worst " << stats.worstMs << " ms, "
+                  << stats.holeFrames << "/" << stats.frames << " frames with holes, " << stats.holes << " holes";
+    };
+
+    {
+        ChunkedWorld world(128, 5, 4);
+        world.Update(start);
+        FlightStats stats = flyChunks(world, start, direction, speed, seconds,
+                                      [&](glm::vec3 cameraPos, glm::vec3, float) { return world.Update(cameraPos, budget); });
+        report("synchronous", stats);
+        std::cout << std::endl;
+    }
+
+    const char* cacheDirectory = "bench_chunk_cache";
+    for (float prefetchSeconds : {0.0f, 0.5f}) {
+        ChunkedWorld world(128, 5, 4);
+        ChunkStreamer streamer(world, defaultThreadCount(), cacheDirectory);
+        streamer.prefetchSeconds = prefetchSeconds;
+        streamer.integrateBudget = 1000;
+        streamer.Update(start, direction, 0.0f);
+        streamer.WaitIdle();
+        streamer.Update(start, direction, 0.0f);
+        streamer.integrateBudget = budget;
+        auto update = [&](glm::vec3 cameraPos, glm::vec3 front, float deltaTime) {
+            return streamer.Update(cameraPos, front, deltaTime);
+        };
+        FlightStats out = flyChunks(world, start, direction, speed, seconds, update);
+        StreamingMetrics metrics = streamer.Metrics();
+        report(prefetchSeconds > 0.0f ? "streamed, prefetch 0.5 s" : "streamed, no prefetch", out);
+        std::cout << " | " << metrics.generated << " generated, " << metrics.cancelled << " cancelled, latency mean "
+                  << metrics.meanLatencyMs << " ms, max " << metrics.maxLatencyMs << " ms" << std::endl;
+
+        // Fly back: chunks evicted on the way out come back from the cache.
+        glm::vec3 end = start + direction * (speed * seconds);
+        FlightStats back = flyChunks(world, end, -direction, speed, seconds, update);
+        streamer.WaitIdle();
+        streamer.integrateBudget = 1000;
+        streamer.Update(start, -direction, 1.0f);
+        metrics = streamer.Metrics();
+        ChunkedWorld reference(128, 5, 4);
+        reference.Update(start);
+        int mismatches = 0;
+        for (const glm::ivec3& coord : reference.ChunksAround(reference.ChunkCoord(start), 4)) {
+            const SparseVoxelOctree* expected = reference.Chunk(coord);
+            const SparseVoxelOctree* chunk = world.Chunk(coord);
+            if ((expected == nullptr) != (chunk == nullptr)) {
+                mismatches++;
+                continue;
+            }
+            for (int i = 0; expected && i < 4096; i++) {
+                glm::ivec3 point = coord * 128 + glm::ivec3(i % 16, i / 16 % 16, i / 256) * 8;
+                glm::vec4 a, b;
+                bool found = expected->Get(point - coord * 128, a);
+                if (chunk->Get(point - coord * 128, b) != found || (found && a != b)) {
+                    mismatches++;
+                }
+            }
+        }
+        std::cout << "  and back: update worst " << back.worstMs << " ms, " << back.holeFrames << "/" << back.frames
+                  << " frames with holes, " << back.holes << " holes | " << metrics.unloaded << " unloaded, " << metrics.loaded
+                  << " loaded from the cache, against generated: " << check(mismatches == 0, "match")
+                  << std::endl;
+    }
+    std::error_code error;
+    std::filesystem::remove_all(cacheDirectory, error);
+}
+
+void benchmarkPagedOctree() {
+    std::cout << "== Paged octree: subtrees faulted in from disk through an LRU cache ==" << std::endl;
+    const std::string path = "benchmark_paged.octree";
+    const int octreeSize = 1000;
+    const int maxDepth = 10;
+    SparseVoxelOctree octree(octreeSize, maxDepth);
+    std::vector<VoxelSample> voxels = generateTerrainVoxels(octreeSize, maxDepth);
+    octree.BuildFromVoxels(voxels);
+    octree.FilterColors();
+    std::vector<FlattenedNode> nodes = octree.ExportNodes();
+
+    // Random voxels and cells above them, shuffled so consecutive queries share no pages.
+    std::vector<glm::ivec3> points;
+    uint32_t seed = 12345;
+    for (int i = 0; i < 200000; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        const VoxelSample& voxel = voxels[seed % voxels.size()];
+        points.push_back((i % 2) ? voxel.position : voxel.position + glm::ivec3(0, octreeSize / 3, 0));
+    }
+    glm::vec3 cameraPos(50.0f, 30.0f, 120.0f);
+    std::vector<glm::vec3> rays = cameraRays(200, 150, cameraPos, glm::vec3(0.0f, -0.3f, -1.0f));
+    std::vector<glm::vec4> flatImage;
+    double flatMs = renderRays(FlattenedView{nodes}, rays, cameraPos, static_cast<float>(octreeSize), flatImage);
+    size_t hits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const glm::ivec3& point : points) {
+        glm::vec4 color;
+        hits += octree.Get(point, color) ? 1 : 0;
+    }
+    double octreeMs = elapsedMs(start);
+    std::cout << nodes.size() << " nodes, " << nodes.size() * sizeof(FlattenedNode) / 1024 << " KiB in memory | "
+              << points.size() << " random Get " << octreeMs << " ms, raycast " << rays.size() << " rays " << flatMs
+              << " ms" << std::endl;
+
+    for (int cutDepth : {4, 6}) {
+        start = std::chrono::steady_clock::now();
+        bool saved = savePagedOctreeFile(path, octree, cutDepth);
+        double saveMs = elapsedMs(start);
+        PagedOctree paged;
+        if (!saved || !paged.Open(path, 0)) {
+            std::cout << "cut depth " << cutDepth << ": " << check(false, "", "FAILED to save or open") << std::endl;
+            continue;
+        }
+        size_t pagedBytes = paged.PageCount() * paged.PageBytes();
+        size_t residentBytes = paged.ResidentBytes() - paged.CachedPages() * paged.PageBytes();
+        std::cout << "cut depth " << cutDepth << ": save " << saveMs << " ms, " << residentBytes / 1024
+                  << " KiB resident + " << paged.PageCount() << " pages of " << paged.PageBytes() / 1024 << " KiB"
+                  << std::endl;
+        for (double fraction : {1.0, 0.25, 0.05, 0.01}) {
+            paged.SetMemoryBudget(residentBytes + static_cast<size_t>(pagedBytes * fraction));
+            paged.ResetStats();
+            std::vector<glm::vec4> pagedImage;
+            double rayMs = renderRays(PagedView{paged}, rays, cameraPos, static_cast<float>(octreeSize), pagedImage);
+            PagingStats rayStats = paged.Stats();
+
+            paged.ResetStats();
+            int mismatches = 0;
+            start = std::chrono::steady_clock::now();
+            size_t pagedHits = 0;
+            for (const glm::ivec3& point : points) {
+                glm::vec4 color;
+                pagedHits += paged.Get(point, color) ? 1 : 0;
+            }
+            double getMs = elapsedMs(start);
+            mismatches += (pagedHits == hits) ? 0 : 1;
+            PagingStats getStats = paged.Stats();
+            for (size_t i = 0; i < points.size(); i += 10) {
+                glm::vec4 expected, color;
+                bool found = octree.Get(points[i], expected);
+                if (paged.Get(points[i], color) != found || (found && color != expected)) {
+                    mismatches++;
+                }
+            }
+            std::cout << "  budget " << fraction * 100.0 << "% (" << paged.ResidentBytes() / 1024 << " KiB held): raycast "
+                      << rayMs << " ms, hit ratio " << rayStats.HitRatio() << ", " << rayStats.faults << " faults, "
+                      << rayStats.bytesRead / 1024 << " KiB read | random Get " << getMs << " ms, hit ratio "
+                      << getStats.HitRatio() << ", fault rate " << getStats.FaultRate() << " | "
+                      << check(mismatches == 0, "queries match") << ", image "
+                      << check(pagedImage == flatImage, "identical", "DIFFERS") << std::endl;
+        }
+    }
+    std::remove(path.c_str());
+}
+
+void benchmarkHeightfield() {
+    std::cout << "== Heightfield build: per-voxel Insert vs BuildFromVoxels vs BuildFromHeightfield ==" << std::endl;
+    for (int maxDepth = 7; maxDepth <= 11; maxDepth++) {
+        int octreeSize = std::max(1000, 1 << maxDepth);
+
+        // Input generation is timed apart; both builders sample the same noise.
+        auto start = std::chrono::steady_clock::now();
+        std::vector<VoxelSample> voxels = generateTerrainVoxels(octreeSize, maxDepth);
+        double voxelGenMs = elapsedMs(start);
+        start = std::chrono::steady_clock::now();
+        Heightfield field = generateTerrainHeightfield(octreeSize, maxDepth);
+        double fieldGenMs = elapsedMs(start);
+
+        double insertMs = 0.0;
+        if (maxDepth <= 9) {
+            start = std::chrono::steady_clock::now();
+            SparseVoxelOctree insertTree(octreeSize, maxDepth);
+            for (const VoxelSample& voxel : voxels) {
+                insertTree.Insert(glm::vec3(voxel.position), voxel.color);
+            }
+            insertMs = elapsedMs(start);
+        }
+
+        start = std::chrono::steady_clock::now();
+        SparseVoxelOctree bulkTree(octreeSize, maxDepth);
+        bulkTree.BuildFromVoxels(voxels);
+        double bulkMs = elapsedMs(start);
+        start = std::chrono::steady_clock::now();
+        bulkTree.CollapseUniform();
+        double collapseMs = elapsedMs(start);
+        std::vector<FlattenedNode> expected = bulkTree.ExportNodes();
+
+        start = std::chrono::steady_clock::now();
+        SparseVoxelOctree fieldTree(octreeSize, maxDepth);
+        fieldTree.BuildFromHeightfield(field);
+        double fieldMs = elapsedMs(start);
+        std::vector<FlattenedNode> built = fieldTree.ExportNodes();
+        bool same = built.size() == expected.size() &&
+                    std::memcmp(built.data(), expected.data(), built.size() * sizeof(FlattenedNode)) == 0;
+
+        std::cout << "maxDepth " << maxDepth << ": " << voxels.size() << " voxels, " << built.size()
+                  << " nodes | generate voxels " << voxelGenMs << " ms, heightfield " << fieldGenMs << " ms | ";
+        if (maxDepth <= 9) {
+            std::cout << "Insert " << insertMs << " ms, ";
+        }
+        std::cout << "BuildFromVoxels + CollapseUniform " << bulkMs + collapseMs << " ms, BuildFromHeightfield "
+                  << fieldMs << " ms | end to end " << (voxelGenMs + bulkMs + collapseMs) / (fieldGenMs + fieldMs)
+                  << "x faster";
+        if (maxDepth <= 9) {
+            std::cout << " (" << (voxelGenMs + insertMs) / (fieldGenMs + fieldMs) << "x against Insert)";
+        }
+        std::cout << " | " << check(same, "identical") << std::endl;
+    }
+
+    // Per-column colors, with heights that leave whole columns empty and reach past the top.
+    Heightfield field;
+    field.columns = 64;
+    field.cellSize = 3;
+    std::vector<VoxelSample> voxels;
+    for (int x = 0; x < field.columns; x++) {
+        for (int z = 0; z < field.columns; z++) {
+            int height = ((x / 8 + z / 8) % 3 == 0) ? 0 : (x * 7 + z * 3) % 90;
+            glm::vec4 color = ((x / 16 + z / 16) % 2) ? glm::vec4(0.2f, 0.6f, 0.2f, 1.0f) : glm::vec4(0.5f, 0.4f, 0.3f, 1.0f);
+            field.heights.push_back(height);
+            field.colors.push_back(color);
+            for (int y = 0; y < height && y * field.cellSize < 200; y++) {
+                voxels.push_back({glm::ivec3(x, y, z) * field.cellSize, color});
+            }
+        }
+    }
+    SparseVoxelOctree expectedTree(200, 6);
+    expectedTree.BuildFromVoxels(voxels);
+    expectedTree.CollapseUniform();
+    SparseVoxelOctree fieldTree(200, 6);
+    fieldTree.BuildFromHeightfield(field);
+    std::vector<FlattenedNode> expected = expectedTree.ExportNodes();
+    std::vector<FlattenedNode> built = fieldTree.ExportNodes();
+    bool same = built.size() == expected.size() &&
+                std::memcmp(built.data(), expected.data(), built.size() * sizeof(FlattenedNode)) == 0;
+    std::cout << "column colors, size 200: " << built.size() << " nodes | " << check(same, "identical") << std::endl;
+}
+
+void benchmarkSurfaceShell() {
+    std::cout << "== Surface shell: buried voxels collapsed into coarse solid leaves ==" << std::endl;
+    // The cameras sit off the cell planes: a ray lying in the face between two columns
+    // touches the buried cells on either side of it.
+    int width = 200, height = 150;
+    glm::vec3 nearPos(50.5f, 30.5f, 120.5f);
+    glm::vec3 farPos(500.5f, 60.5f, 990.5f);
+    std::vector<glm::vec3> nearRays = cameraRays(width, height, nearPos, glm::vec3(0.0f, -0.3f, -1.0f));
+    std::vector<glm::vec3> farRays = cameraRays(width, height, farPos, glm::vec3(0.0f, -0.1f, -1.0f));
+    float lodScale = 2.0f * 2.0f * std::tan(glm::radians(45.0f / 2.0f)) / height;
+    struct Case {
+        int size;
+        int maxDepth;
+    };
+    for (Case c : {Case{1000, 8}, Case{1000, 9}, Case{1024, 10}}) {
+        Heightfield field = generateTerrainHeightfield(c.size, c.maxDepth);
+        SparseVoxelOctree octree(c.size, c.maxDepth);
+        octree.BuildFromHeightfield(field);
+        octree.FilterColors();
+        std::vector<FlattenedNode> solid = octree.ExportNodes();
+        auto start = std::chrono::steady_clock::now();
+        size_t saved = octree.CollapseInterior();
+        double shellMs = elapsedMs(start);
+        std::vector<FlattenedNode> shell = octree.ExportNodes();
+
+        SparseVoxelOctree built(c.size, c.maxDepth);
+        built.SetBuildShell(true);
+        built.FilterColors();
+        start = std::chrono::steady_clock::now();
+        built.BuildFromHeightfield(field);
+        double buildMs = elapsedMs(start);
+
+        // Every voxel stays filled, buried or not.
+        SparseVoxelOctree solidTree(c.size, c.maxDepth);
+        solidTree.LoadNodes(solid.data(), solid.size());
+        std::vector<VoxelSample> voxels = generateTerrainVoxels(c.size, c.maxDepth);
+        size_t lost = 0;
+        for (const VoxelSample& voxel : voxels) {
+            glm::vec4 color;
+            lost += (solidTree.Get(voxel.position, color) && !octree.Get(voxel.position, color)) ? 1 : 0;
+        }
+
+        std::cout << "size " << c.size << ", maxDepth " << c.maxDepth << ": " << solid.size() << " -> " << shell.size()
+                  << " nodes (" << 100.0 * saved / solid.size() << "% saved), " << solid.size() * sizeof(FlattenedNode) / 1024
+                  << " -> " << shell.size() * sizeof(FlattenedNode) / 1024 << " KiB | CollapseInterior " << shellMs
+                  << " ms, shell build " << buildMs << " ms, " << check(sameNodes(shell, built.ExportNodes()), "same tree")
+                  << " | " << lost << " voxels lost" << std::endl;
+
+        // From the voxel-per-leaf tree the bulk builder makes, with nothing collapsed yet.
+        SparseVoxelOctree voxelTree(c.size, c.maxDepth);
+        voxelTree.BuildFromVoxels(voxels);
+        size_t voxelNodes = voxelTree.Nodes().Size();
+        size_t voxelSaved = voxelTree.CollapseInterior();
+        std::cout << "  from BuildFromVoxels: " << voxelNodes << " -> " << voxelNodes - voxelSaved << " nodes ("
+                  << 100.0 * voxelSaved / voxelNodes << "% saved)";
+        voxelTree.CollapseUniform();
+        std::cout << ", then CollapseUniform " << voxelTree.Nodes().Size() << std::endl;
+
+        std::vector<glm::vec4> reference, image;
+        renderRays(FlattenedView{solid}, nearRays, nearPos, static_cast<float>(c.size), reference);
+        renderRays(FlattenedView{shell}, nearRays, nearPos, static_cast<float>(c.size), image);
+        std::cout << "  near camera: " << crackPixels(reference, image);
+        renderRays(FlattenedView{solid}, farRays, farPos, static_cast<float>(c.size), reference);
+        renderRays(FlattenedView{shell}, farRays, farPos, static_cast<float>(c.size), image);
+        std::cout << " | far camera: " << crackPixels(reference, image);
+        renderRays(FlattenedView{solid}, farRays, farPos, static_cast<float>(c.size), reference, lodScale);
+        renderRays(FlattenedView{shell}, farRays, farPos, static_cast<float>(c.size), image, lodScale);
+        std::cout << " | 2 px cutoff: mean error " << meanImageError(image, reference) << std::endl;
+    }
+}
+
+void benchmarkTerrainNoise() {
+    std::cout << "== Terrain noise: scalar against SIMD batches ==" << std::endl;
+    std::cout << "best instruction set: " << simdLevelName(bestSimdLevel()) << std::endl;
+    // main()'s grid at depth 11, then a tile far out where chunked worlds go.
+    struct Tile {
+        float x0;
+        float step;
+        int count;
+    };
+    for (Tile tile : {Tile{0.0f, 1.0f, 2048}, Tile{100000.0f, 4.0f, 1024}}) {
+        size_t samples = static_cast<size_t>(tile.count) * tile.count;
+        std::vector<float> reference(samples), heights(samples);
+        double scalarMs = 0.0;
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2}) {
+            if (level > bestSimdLevel()) {
+                continue;
+            }
+            std::vector<float>& out = (level == SimdLevel::Scalar) ? reference : heights;
+            auto start = std::chrono::steady_clock::now();
+            generateTerrainNoiseTile(tile.x0, tile.x0, tile.step, tile.count, tile.count, out.data(), level);
+            double ms = elapsedMs(start);
+            std::cout << tile.count << "^2 samples from " << tile.x0 << ", " << simdLevelName(level) << ": " << ms << " ms";
+            if (level == SimdLevel::Scalar) {
+                scalarMs = ms;
+                std::cout << std::endl;
+                continue;
+            }
+            // Heights as generateTerrainVoxels rounds them up to cells of tile.step.
+            float maxError = 0.0f;
+            size_t cells = 0;
+            for (size_t i = 0; i < samples; i++) {
+                maxError = std::max(maxError, std::abs(heights[i] - reference[i]));
+                cells += (std::ceil(heights[i] / tile.step) != std::ceil(reference[i] / tile.step)) ? 1 : 0;
+            }
+            std::cout << " (" << scalarMs / ms << "x) | max error " << maxError << ", " << cells
+                      << " columns a cell off" << std::endl;
+        }
+    }
+}
+
+void benchmarkFastNoiseFill() {
+    std::cout << "== FastNoise: GetNoise loop against FillNoiseSet ==" << std::endl;
+    const char* levelNames[] = {"scalar", "SSE4.1", "AVX2"};
+    std::cout << "supported instruction set: " << levelNames[FastNoise::GetSupportedSIMDLevel()] << std::endl;
+    struct Case {
+        const char* name;
+        FastNoise::NoiseType type;
+        FastNoise::FractalType fractal;
+        FastNoise::Interp interp;
+        int dimensions;
+    };
+    const Case cases[] = {
+        {"Perlin 3D", FastNoise::Perlin, FastNoise::FBM, FastNoise::Quintic, 3},
+        {"Perlin FBM 3D, hermite", FastNoise::PerlinFractal, FastNoise::FBM, FastNoise::Hermite, 3},
+        {"Perlin rigid 2D, linear", FastNoise::PerlinFractal, FastNoise::RigidMulti, FastNoise::Linear, 2},
+        {"Simplex 3D", FastNoise::Simplex, FastNoise::FBM, FastNoise::Quintic, 3},
+        {"Simplex FBM 3D", FastNoise::SimplexFractal, FastNoise::FBM, FastNoise::Quintic, 3},
+        {"Simplex billow 2D", FastNoise::SimplexFractal, FastNoise::Billow, FastNoise::Quintic, 2},
+        {"Cellular 3D", FastNoise::Cellular, FastNoise::FBM, FastNoise::Quintic, 3},
+    };
+    // Starts off the lattice and on both sides of zero, where FastFloor steps down.
+    const float start[3] = {-60.25f, 13.5f, -1000.75f};
+    const float step = 0.75f;
+    const int size3D = 96;
+    const int size2D = 1024;
+    // At least 4 threads so the x split is exercised on small machines too.
+    int threads = static_cast<int>(std::max(4u, std::thread::hardware_concurrency()));
+
+    for (const Case& c : cases) {
+        FastNoise noise(4242);
+        noise.SetNoiseType(c.type);
+        noise.SetFractalType(c.fractal);
+        noise.SetInterp(c.interp);
+        noise.SetFractalOctaves(4);
+        int sizeX = c.dimensions == 3 ? size3D : size2D;
+        int sizeY = sizeX;
+        int sizeZ = c.dimensions == 3 ? size3D : 1;
+        size_t points = static_cast<size_t>(sizeX) * sizeY * sizeZ;
+
+        std::vector<float> reference(points), filled(points);
+        auto start0 = std::chrono::steady_clock::now();
+        for (int x = 0; x < sizeX; x++) {
+            for (int y = 0; y < sizeY; y++) {
+                for (int z = 0; z < sizeZ; z++) {
+                    float px = start[0] + x * step;
+                    float py = start[1] + y * step;
+                    float pz = start[2] + z * step;
+                    reference[(static_cast<size_t>(x) * sizeY + y) * sizeZ + z] =
+                        c.dimensions == 3 ? noise.GetNoise(px, py, pz) : noise.GetNoise(px, py);
+                }
+            }
+        }
+        double scalarMs = elapsedMs(start0);
+        std::cout << c.name << ", " << points << " points, GetNoise: " << scalarMs << " ms" << std::endl;
+
+        struct Run {
+            FastNoise::SIMDLevel level;
+            int threads;
+        };
+        for (Run run : {Run{FastNoise::SIMD_None, 1}, Run{FastNoise::SIMD_SSE41, 1}, Run{FastNoise::SIMD_AVX2, 1},
+                        Run{FastNoise::SIMD_AVX2, threads}}) {
+            if (run.level > FastNoise::GetSupportedSIMDLevel()) {
+                continue;
+            }
+            noise.SetSIMDLevel(run.level);
+            std::fill(filled.begin(), filled.end(), 0.0f);
+            auto start1 = std::chrono::steady_clock::now();
+            if (c.dimensions == 3) {
+                noise.FillNoiseSet(filled.data(), start[0], start[1], start[2], sizeX, sizeY, sizeZ, step, run.threads);
+            } else {
+                noise.FillNoiseSet2D(filled.data(), start[0], start[1], sizeX, sizeY, step, run.threads);
+            }
+            double ms = elapsedMs(start1);
+            float maxError = 0.0f;
+            for (size_t i = 0; i < points; i++) {
+                maxError = std::max(maxError, std::abs(filled[i] - reference[i]));
+            }
+            std::cout << "  FillNoiseSet, " << levelNames[noise.GetSIMDLevel()] << ", " << run.threads << " thread(s): " << ms
+                      << " ms (" << scalarMs / ms << "x) | max error " << maxError
+                      << check(maxError <= 1e-4f, "", " MISMATCH") << std::endl;
+        }
+    }
+}
+
+void benchmarkNoiseKernels() {
+    std::cout << "== FastNoise: runtime dispatch against NoiseKernel ==" << std::endl;
+    // A column of 3D points the way terrain generation walks them, off the lattice and across zero.
+    const int count = 1 << 19;
+    std::vector<float> xs(count), ys(count), zs(count);
+    for (int i = 0; i < count; i++) {
+        xs[i] = -200.25f + static_cast<float>(i % 97) * 3.5f;
+        ys[i] = static_cast<float>((i / 97) % 61) * 1.75f - 40.5f;
+        zs[i] = 11.75f + static_cast<float>(i / (97 * 61)) * 2.25f;
+    }
+    struct Case {
+        const char* name;
+        FastNoise::NoiseType type;
+        FastNoise::FractalType fractal;
+        FastNoise::Interp interp;
+        bool threeD;
+    };
+    const Case cases[] = {
+        {"Simplex FBM 3D", FastNoise::SimplexFractal, FastNoise::FBM, FastNoise::Quintic, true},
+        {"Perlin billow 3D, hermite", FastNoise::PerlinFractal, FastNoise::Billow, FastNoise::Hermite, true},
+        {"Value rigid 3D, linear", FastNoise::ValueFractal, FastNoise::RigidMulti, FastNoise::Linear, true},
+        {"Value 2D, quintic", FastNoise::Value, FastNoise::FBM, FastNoise::Quintic, false},
+        {"Cubic FBM 2D", FastNoise::CubicFractal, FastNoise::FBM, FastNoise::Quintic, false},
+        {"Cellular 3D", FastNoise::Cellular, FastNoise::FBM, FastNoise::Quintic, true},
+    };
+    std::vector<float> reference(count), out(count);
+    auto maxError = [&]() {
+        float error = 0.0f;
+        for (int i = 0; i < count; i++) {
+            error = std::max(error, std::abs(out[i] - reference[i]));
+        }
+        return error;
+    };
+    for (const Case& c : cases) {
+        FastNoise noise(77);
+        noise.SetNoiseType(c.type);
+        noise.SetFractalType(c.fractal);
+        noise.SetInterp(c.interp);
+        noise.SetFractalOctaves(5);
+        std::unique_ptr<FastNoiseKernel> kernel = noise.CreateKernel();
+        const float* z = c.threeD ? zs.data() : nullptr;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            reference[i] = c.threeD ? noise.GetNoise(xs[i], ys[i], zs[i]) : noise.GetNoise(xs[i], ys[i]);
+        }
+        double dynamicMs = elapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            out[i] = c.threeD ? kernel->GetNoise(xs[i], ys[i], zs[i]) : kernel->GetNoise(xs[i], ys[i]);
+        }
+        double kernelMs = elapsedMs(start);
+        float kernelError = maxError();
+
+        start = std::chrono::steady_clock::now();
+        kernel->GetNoiseSet(out.data(), xs.data(), ys.data(), z, count);
+        double batchMs = elapsedMs(start);
+        float batchError = maxError();
+
+        std::cout << c.name << ", " << count << " points: GetNoise " << dynamicMs << " ms, kernel GetNoise " << kernelMs
+                  << " ms (" << dynamicMs / kernelMs << "x), GetNoiseSet " << batchMs << " ms (" << dynamicMs / batchMs
+                  << "x) | max error " << kernelError << " / " << batchError
+                  << check(kernelError <= 1e-4f && batchError <= 1e-4f, "", " MISMATCH") << std::endl;
+    }
+
+    // The factory folds settings a noise type ignores into one instantiation.
+    FastNoise simplex;
+    simplex.SetNoiseType(FastNoise::Simplex);
+    simplex.SetFractalType(FastNoise::RigidMulti);
+    simplex.SetInterp(FastNoise::Linear);
+    std::unique_ptr<FastNoiseKernel> folded = simplex.CreateKernel();
+    bool foldedMatch = dynamic_cast<NoiseKernel<FastNoise::Simplex, FastNoise::FBM, FastNoise::Quintic>*>(folded.get()) != nullptr;
+
+    // A kernel named at compile time: no virtual call and no switch on the settings.
+    simplex.SetNoiseType(FastNoise::SimplexFractal);
+    simplex.SetFractalType(FastNoise::FBM);
+    NoiseKernel<FastNoise::SimplexFractal, FastNoise::FBM, FastNoise::Quintic> direct(simplex);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        reference[i] = simplex.GetNoise(xs[i], ys[i], zs[i]);
+    }
+    double dynamicMs = elapsedMs(start);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        out[i] = direct.GetNoise(xs[i], ys[i], zs[i]);
+    }
+    double directMs = elapsedMs(start);
+    float directError = maxError();
+    std::cout << "NoiseKernel<SimplexFractal, FBM, Quintic> named directly: " << directMs << " ms against " << dynamicMs
+              << " ms | max error " << directError << check(directError <= 1e-4f, "", " MISMATCH") << ", factory folds unused settings: "
+              << check(foldedMatch, "yes", "no MISMATCH") << std::endl;
+}
+
+void benchmarkNoiseGraph() {
+    std::cout << "== Noise graph: chained FastNoise calls against a compiled graph ==" << std::endl;
+    // Warped continents and ridges make a height, cellular caves and 3D detail carve the
+    // density below it; positive is solid.
+    FastNoise warp(3);
+    warp.SetFrequency(0.004f);
+    warp.SetGradientPerturbAmp(30.0f);
+    warp.SetFractalOctaves(3);
+    FastNoise continents(1);
+    continents.SetNoiseType(FastNoise::SimplexFractal);
+    continents.SetFrequency(0.002f);
+    continents.SetFractalOctaves(5);
+    FastNoise ridges(2);
+    ridges.SetNoiseType(FastNoise::PerlinFractal);
+    ridges.SetFractalType(FastNoise::RigidMulti);
+    ridges.SetFrequency(0.006f);
+    ridges.SetFractalOctaves(4);
+    FastNoise caves(4);
+    caves.SetNoiseType(FastNoise::Cellular);
+    caves.SetCellularReturnType(FastNoise::Distance2Sub);
+    caves.SetFrequency(0.02f);
+    FastNoise detail(5);
+    detail.SetNoiseType(FastNoise::Simplex);
+    detail.SetFrequency(0.05f);
+    std::vector<glm::vec2> landCurve = {{-1.0f, -40.0f}, {0.0f, 10.0f}, {0.4f, 60.0f}, {1.0f, 120.0f}};
+
+    NoiseGraph graph;
+    NoiseDomain warped = graph.Warp(warp, graph.DomainXZ(), true);
+    NoiseNode continent = graph.Noise(continents, warped);
+    NoiseNode land = graph.Curve(continent, landCurve);
+    NoiseNode mountains = graph.ScaleBias(graph.Mul(graph.Noise(ridges, warped), graph.Clamp(continent, 0.0f, 1.0f)), 80.0f, 0.0f);
+    NoiseNode density = graph.Sub(graph.Add(land, mountains), graph.Y());
+    NoiseNode cave = graph.ScaleBias(graph.Noise(caves, graph.Domain3D()), 200.0f, -5.0f);
+    density = graph.Min(density, cave);
+    density = graph.Add(density, graph.Mul(graph.Noise(detail, graph.Domain3D()), graph.Constant(4.0f)));
+    graph.Clamp(graph.Constant(2.0f), 0.0f, 1.0f);   // unused, dropped by Compile
+    graph.SetOutput(density);
+    bool compiled = graph.Compile();
+
+    auto reference = [&](float x, float y, float z) {
+        float wx = x;
+        float wz = z;
+        warp.GradientPerturbFractal(wx, wz);
+        float c = continents.GetNoise(wx, wz);
+        float height = evaluateCurve(landCurve, c) + ridges.GetNoise(wx, wz) * std::min(std::max(c, 0.0f), 1.0f) * 80.0f + 0.0f;
+        float value = std::min(height - y, caves.GetNoise(x, y, z) * 200.0f + -5.0f);
+        return value + detail.GetNoise(x, y, z) * 4.0f;
+    };
+
+    const glm::ivec3 size(64, 64, 64);
+    const glm::vec3 origin(-100.5f, -20.0f, 300.25f);
+    const float step = 2.0f;
+    size_t points = static_cast<size_t>(size.x) * size.y * size.z;
+    std::vector<float> expected(points), grid(points), listed(points);
+    auto start = std::chrono::steady_clock::now();
+    for (int x = 0; x < size.x; x++) {
+        for (int y = 0; y < size.y; y++) {
+            for (int z = 0; z < size.z; z++) {
+                expected[(static_cast<size_t>(x) * size.y + y) * size.z + z] =
+                    reference(origin.x + x * step, origin.y + y * step, origin.z + z * step);
+            }
+        }
+    }
+    double chainedMs = elapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    graph.EvaluateGrid(grid.data(), origin, size, step);
+    double graphMs = elapsedMs(start);
+
+    std::vector<float> xs(points), ys(points), zs(points);
+    for (size_t i = 0; i < points; i++) {
+        xs[i] = origin.x + static_cast<int>(i / (size.y * size.z)) * step;
+        ys[i] = origin.y + static_cast<int>((i / size.z) % size.y) * step;
+        zs[i] = origin.z + static_cast<int>(i % size.z) * step;
+    }
+    graph.Evaluate(listed.data(), xs.data(), ys.data(), zs.data(), static_cast<int>(points));
+
+    float maxError = 0.0f;
+    size_t solidFlips = 0;
+    for (size_t i = 0; i < points; i++) {
+        maxError = std::max(maxError, std::max(std::abs(grid[i] - expected[i]), std::abs(listed[i] - expected[i])));
+        solidFlips += ((grid[i] > 0.0f) != (expected[i] > 0.0f)) ? 1 : 0;
+    }
+    std::cout << size.x << "^3 chunk: chained " << chainedMs << " ms, graph " << graphMs << " ms (" << chainedMs / graphMs
+              << "x), " << graph.InstructionCount() << " instructions in " << graph.RegisterCount() << " registers | max error "
+              << maxError << ", " << solidFlips << " voxels flipped"
+              << check(compiled && maxError <= 1e-3f && solidFlips == 0, "", " MISMATCH") << std::endl;
+}
+
+// Every cell of field sampled, filled cells handed to BuildFromVoxels in x, then y, then z
+// order and collapsed.
+std::vector<FlattenedNode> buildDensityPerCell(const DensityField& field, int octreeSize, int maxDepth) {
+    int cells = (octreeSize + field.cellSize - 1) / field.cellSize;
+    std::vector<VoxelSample> voxels;
+    std::vector<float> slab(static_cast<size_t>(cells) * cells);
+    for (int x = 0; x < cells; x++) {
+        field.sample(glm::ivec3(x, 0, 0), glm::ivec3(1, cells, cells), slab.data());
+        for (int y = 0; y < cells; y++) {
+            glm::vec4 color = field.layerColors[std::min(y, static_cast<int>(field.layerColors.size()) - 1)];
+            for (int z = 0; z < cells; z++) {
+                if (slab[static_cast<size_t>(y) * cells + z] > 0.0f) {
+                    voxels.push_back({glm::ivec3(x, y, z) * field.cellSize, color});
+                }
+            }
+        }
+    }
+    SparseVoxelOctree tree(octreeSize, maxDepth);
+    tree.BuildFromVoxels(voxels);
+    tree.CollapseUniform();
+    return tree.ExportNodes();
+}
+
+void benchmarkDensityTerrain() {
+    std::cout << "== Density terrain: every cell sampled vs BuildFromDensity with noise bounds ==" << std::endl;
+    struct Case {
+        const char* name;
+        FastNoise::NoiseType type;
+        FastNoise::FractalType fractal;
+        FastNoise::Interp interp;
+        int octreeSize;
+        int maxDepth;
+    };
+    const Case cases[] = {
+        {"Perlin FBM", FastNoise::PerlinFractal, FastNoise::FBM, FastNoise::Quintic, 128, 7},
+        {"Perlin", FastNoise::Perlin, FastNoise::FBM, FastNoise::Hermite, 128, 7},
+        {"Value billow", FastNoise::ValueFractal, FastNoise::Billow, FastNoise::Linear, 128, 7},
+        {"Simplex FBM", FastNoise::SimplexFractal, FastNoise::FBM, FastNoise::Quintic, 128, 7},
+        {"Simplex rigid", FastNoise::SimplexFractal, FastNoise::RigidMulti, FastNoise::Quintic, 128, 7},
+        {"Cellular (no bounds)", FastNoise::Cellular, FastNoise::FBM, FastNoise::Quintic, 128, 7},
+        {"Perlin FBM, 3 unit cells", FastNoise::PerlinFractal, FastNoise::FBM, FastNoise::Quintic, 200, 6},
+    };
+    for (const Case& c : cases) {
+        FastNoise noise(1337);
+        noise.SetNoiseType(c.type);
+        noise.SetFractalType(c.fractal);
+        noise.SetInterp(c.interp);
+        noise.SetFractalOctaves(4);
+        noise.SetFrequency(3.0f / c.octreeSize);
+        DensityTerrain terrain(noise, c.octreeSize * 0.5f, c.octreeSize * 0.3f);
+        DensityField field = terrain.Field(c.octreeSize, c.maxDepth);
+        std::vector<FlattenedNode> expected = buildDensityPerCell(field, c.octreeSize, c.maxDepth);
+
+        size_t sampled = 0;
+        DensityField counted = field;
+        counted.sample = [&](glm::ivec3 lo, glm::ivec3 size, float* densities) {
+            sampled += static_cast<size_t>(size.x) * size.y * size.z;
+            field.sample(lo, size, densities);
+        };
+        SparseVoxelOctree tree(c.octreeSize, c.maxDepth);
+        tree.BuildFromDensity(counted);
+        std::vector<FlattenedNode> built = tree.ExportNodes();
+        bool same = built.size() == expected.size() &&
+                    std::memcmp(built.data(), expected.data(), built.size() * sizeof(FlattenedNode)) == 0;
+        double cells = (c.octreeSize + field.cellSize - 1) / field.cellSize;
+        std::cout << c.name << ", size " << c.octreeSize << ": " << built.size() << " nodes, "
+                  << 100.0 * sampled / (cells * cells * cells) << "% of cells sampled | "
+                  << check(same, "identical") << std::endl;
+    }
+
+    // Ever larger worlds of the same landscape: the surface grows as size^2, and so should
+    // the samples.
+    for (int depth = 7; depth <= 10; depth++) {
+        int size = 1 << depth;
+        FastNoise noise(1337);
+        noise.SetNoiseType(FastNoise::PerlinFractal);
+        noise.SetFractalOctaves(4);
+        noise.SetFrequency(1.0f / 64.0f);
+        DensityTerrain terrain(noise, size * 0.5f, 40.0f);
+        DensityField field = terrain.Field(size, depth);
+
+        size_t sampled = 0, bounded = 0;
+        DensityField counted = field;
+        counted.sample = [&](glm::ivec3 lo, glm::ivec3 cells, float* densities) {
+            sampled += static_cast<size_t>(cells.x) * cells.y * cells.z;
+            field.sample(lo, cells, densities);
+        };
+        counted.bounds = [&](glm::ivec3 lo, glm::ivec3 hi, float& minDensity, float& maxDensity) {
+            bounded++;
+            field.bounds(lo, hi, minDensity, maxDensity);
+        };
+        auto start = std::chrono::steady_clock::now();
+        SparseVoxelOctree tree(size, depth);
+        tree.BuildFromDensity(counted);
+        double buildMs = elapsedMs(start);
+
+        // Sampling alone, every cell, a slab at a time.
+        double volume = static_cast<double>(size) * size * size;
+        double perCellMs = 0.0;
+        if (depth <= 9) {
+            std::vector<float> slab(static_cast<size_t>(size) * size);
+            start = std::chrono::steady_clock::now();
+            for (int x = 0; x < size; x++) {
+                field.sample(glm::ivec3(x, 0, 0), glm::ivec3(1, size, size), slab.data());
+            }
+            perCellMs = elapsedMs(start);
+        }
+        std::cout << "size " << size << ": " << sampled << " cells sampled (" << 100.0 * sampled / volume
+                  << "% of the volume, " << static_cast<double>(sampled) / (static_cast<double>(size) * size)
+                  << " per size^2), " << bounded << " bounds, " << tree.Nodes().Size() << " nodes | BuildFromDensity "
+                  << buildMs << " ms";
+        if (depth <= 9) {
+            std::cout << ", sampling every cell alone " << perCellMs << " ms (" << perCellMs / buildMs << "x)";
+        }
+        std::cout << std::endl;
+    }
+}
+
+void benchmarkCellular() {
+    std::cout << "== FastNoise: 3D cellular per sample, GetNoise against FillNoiseSet ==" << std::endl;
+    const char* levelNames[] = {"scalar", "SSE4.1", "AVX2"};
+    const char* distanceNames[] = {"euclidean", "manhattan", "natural"};
+    const char* returnNames[] = {"cell value", "noise lookup", "distance", "distance2",
+                                 "distance2 add", "distance2 sub", "distance2 mul", "distance2 div"};
+    struct Case {
+        FastNoise::CellularDistanceFunction distance;
+        FastNoise::CellularReturnType returnType;
+        float frequency;
+        float step;
+        int index0, index1;
+    };
+    std::vector<Case> cases;
+    // Every mode at cave scale, a few cells across a 64^3 chunk.
+    for (int d = 0; d < 3; d++) {
+        for (int r = 0; r < 8; r++) {
+            cases.push_back({static_cast<FastNoise::CellularDistanceFunction>(d),
+                             static_cast<FastNoise::CellularReturnType>(r), 0.05f, 1.0f, 0, 1});
+        }
+    }
+    // Ore-sized cells, other distance indices, a step running backwards, and steps wider than a cell.
+    cases.push_back({FastNoise::Euclidean, FastNoise::CellValue, 0.25f, 1.0f, 0, 1});
+    cases.push_back({FastNoise::Euclidean, FastNoise::Distance2Sub, 0.25f, 1.0f, 1, 3});
+    cases.push_back({FastNoise::Natural, FastNoise::Distance2Div, 0.05f, -0.5f, 0, 2});
+    cases.push_back({FastNoise::Manhattan, FastNoise::Distance, 1.5f, 1.0f, 0, 1});
+    const float start[3] = {-20.5f, 7.25f, -3000.0f};
+    const int size = 64;
+    const size_t points = static_cast<size_t>(size) * size * size;
+
+    FastNoise lookup(99);
+    lookup.SetNoiseType(FastNoise::Simplex);
+    std::vector<float> reference(points), filled(points);
+    for (const Case& c : cases) {
+        FastNoise noise(4242);
+        noise.SetNoiseType(FastNoise::Cellular);
+        noise.SetFrequency(c.frequency);
+        noise.SetCellularDistanceFunction(c.distance);
+        noise.SetCellularReturnType(c.returnType);
+        noise.SetCellularDistance2Indices(c.index0, c.index1);
+        noise.SetCellularNoiseLookup(&lookup);
+
+        auto start0 = std::chrono::steady_clock::now();
+        for (int x = 0; x < size; x++) {
+            for (int y = 0; y < size; y++) {
+                for (int z = 0; z < size; z++) {
+                    reference[(static_cast<size_t>(x) * size + y) * size + z] =
+                        noise.GetNoise(start[0] + x * c.step, start[1] + y * c.step, start[2] + z * c.step);
+                }
+            }
+        }
+        double scalarNs = elapsedMs(start0) * 1e6 / points;
+        std::cout << distanceNames[c.distance] << ", " << returnNames[c.returnType] << ", frequency " << c.frequency
+                  << ", step " << c.step << ": GetNoise " << scalarNs << " ns/sample";
+
+        for (FastNoise::SIMDLevel level : {FastNoise::SIMD_None, FastNoise::SIMD_SSE41, FastNoise::SIMD_AVX2}) {
+            if (level > FastNoise::GetSupportedSIMDLevel()) {
+                continue;
+            }
+            noise.SetSIMDLevel(level);
+            std::fill(filled.begin(), filled.end(), 0.0f);
+            auto start1 = std::chrono::steady_clock::now();
+            noise.FillNoiseSet(filled.data(), start[0], start[1], start[2], size, size, size, c.step);
+            double ns = elapsedMs(start1) * 1e6 / points;
+            size_t different = 0;
+            for (size_t i = 0; i < points; i++) {
+                different += std::memcmp(&filled[i], &reference[i], sizeof(float)) != 0;
+            }
+            std::cout << " | " << levelNames[level] << " " << ns << " (" << scalarNs / ns << "x)";
+            if (different) {
+                std::cout << check(false, "", " MISMATCH ") << different << " samples";
+            }
+        }
+        std::cout << std::endl;
+    }
+}
+
+int main() {
+    benchmarkNodePool();
+    benchmarkBuild();
+    benchmarkParallelBuild();
+    benchmarkCompactLayout();
+    benchmarkLeafBricks();
+    benchmarkAttributeEncodings();
+    benchmarkDAG();
+    benchmarkEditedDAG();
+    benchmarkFilteredColors();
+    benchmarkEdits();
+    benchmarkBrushes();
+    benchmarkCollapse();
+    benchmarkFileFormat();
+    benchmarkBitstream();
+    benchmarkSuccinct();
+    benchmarkChunkedWorld();
+    benchmarkChunkStreaming();
+    benchmarkPagedOctree();
+    benchmarkHeightfield();
+    benchmarkSurfaceShell();
+    benchmarkTerrainNoise();
+    benchmarkFastNoiseFill();
+    benchmarkNoiseKernels();
+    benchmarkNoiseGraph();
+    benchmarkDensityTerrain();
+    benchmarkCellular();
+    if (failedChecks > 0) {
+        std::cout << failedChecks << " checks FAILED" << std::endl;
+        return 1;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}
@@ -7,33 +7,23 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <camera.h>
+#include <octree/octree.h>
+#include <octree/octree_file.h>
+#include <terrain/terrain.h>
+#include <world/chunked_world.h>
+#include <world/chunk_streamer.h>
 #include <vector>
+#include <memory>
 #include <cmath>
 
-float generateTerrainNoise(float x, float z) {
-    float height = 0.0f;
-    float freq = 0.02f;  // Lower base frequency for larger mountains
-    float amp = 50.0f;   // Increased amplitude for taller peaks
-    float persistence = 0.2f; // Controls how quickly amplitudes decrease
-    int octaves = 9; // More octaves for extra detail
-
-    for (int i = 0; i < octaves; ++i) {
-        height += std::sin(x * freq) * std::cos(z * freq) * amp;
-        freq *= 2.0f;  // Increase frequency each octave
-        amp *= persistence;  // Decrease amplitude each octave
-    }
-    
-    // Exaggerate mountains with power-based scaling
-    height = std::pow(height * 0.03f, 3.0f);  // Cubic transformation for sharper peaks
-
-    return height * 10.0f;  // Scale final height appropriately
-}
-
-
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow *window);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scrool_callback(GLFWwindow* window, double xoffset, double yoffset);
+void uploadNodes(SparseVoxelOctree& octree, GLuint ssbo, size_t& capacity);
+void uploadChunkGrid(ChunkedWorld& world, GLuint nodeSSBO, GLuint gridSSBO, size_t& capacity);
+bool openWorldFile(MappedOctreeFile& file, const std::string& path, int size, int maxDepth, NodeLayout layout,
+                   int brickSize, AttributeEncoding encoding);
 
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
@@ -53,62 +43,6 @@ float fov   = 45.0f;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-struct FlattenedNode {
-    bool IsLeaf = false;
-    char padding1[3];       // Pad bool to 4 bytes
-    int childIndices[8] = {-1, -1, -1, -1, -1, -1, -1, -1};
-    char padding2[12];      // Pad to align vec4 to 16 bytes after the array
-    glm::vec4 color = glm::vec4(1.0f); // default white
-};
-
-std::vector<FlattenedNode> m_nodes;
-
-class SparseVoxelOctree {
-public:
-    SparseVoxelOctree(int size, int maxDepth);
-    void Insert(glm::vec3 point, glm::vec4 color);
-private:
-    void InsertImpl(int nodeIndex, glm::ivec3 point, glm::vec4 color, glm::ivec3 position, int depth);
-    int m_size;
-    int m_maxDepth;
-};
-
-SparseVoxelOctree::SparseVoxelOctree(int size, int maxDepth)
-    : m_size(size), m_maxDepth(maxDepth) {
-    m_nodes.push_back(FlattenedNode()); // root node
-}
-
-void SparseVoxelOctree::Insert(glm::vec3 point, glm::vec4 color) {
-    InsertImpl(0, glm::ivec3(point), color, glm::ivec3(0), 0);
-}
-
-void SparseVoxelOctree::InsertImpl(int nodeIndex, glm::ivec3 point, glm::vec4 color, glm::ivec3 position, int depth) {
-    if (nodeIndex >= m_nodes.size()) {
-        std::cout << "Index out of bounds" << std::endl;
-        return;
-    }
-    FlattenedNode &node = m_nodes[nodeIndex];
-    node.color = color;
-    if (depth == m_maxDepth) {
-        node.IsLeaf = true;
-        return;
-    }
-    float size = m_size / std::exp2(depth);
-    glm::ivec3 center = position + glm::ivec3(size / 2.0f);
-    glm::ivec3 childPos = {
-        (point.x >= center.x) ? 1 : 0,
-        (point.y >= center.y) ? 1 : 0,
-        (point.z >= center.z) ? 1 : 0
-    };
-    int childIndex = (childPos.x << 2) | (childPos.y << 1) | (childPos.z);
-    if (node.childIndices[childIndex] == -1) {
-        node.childIndices[childIndex] = m_nodes.size();
-        m_nodes.push_back(FlattenedNode());
-    }
-    glm::ivec3 newPosition = position + childPos * glm::ivec3(size / 2);
-    InsertImpl(node.childIndices[childIndex], point, color, newPosition, depth + 1);
-}
-
 int main() {
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
@@ -143,47 +77,44 @@ int main() {
 
     int octreeSize = 1000;     // Corrected to match 0-100 world range
     int maxDepth = 7;
-    SparseVoxelOctree octree(octreeSize, maxDepth);
-    m_nodes.reserve(500000);
-    
-    int numSteps = 1 << maxDepth;
- int voxelSize = octreeSize / numSteps;
-
- float rockHeight = octreeSize * 0.01f; // Below 30% height → Rock
- float snowHeight = octreeSize * 0.013f; // Above 80% height → Snow
-
- for (int xi = 0; xi < numSteps; xi++) {
-    int x = xi * voxelSize;
-    for (int zi = 0; zi < numSteps; zi++) {
-        int z = zi * voxelSize;
-        float noiseHeight = generateTerrainNoise(static_cast<float>(x), static_cast<float>(z));
-
-        int ySteps = std::max(1, static_cast<int>(std::ceil(noiseHeight / voxelSize)));
-
-        for (int yi = 0; yi < ySteps; yi++) {
-            int y = yi * voxelSize;
-
-            // Define base colors
-            glm::vec4 rockColor = glm::vec4(0.4f, 0.3f, 0.2f, 1.0f);  // Brownish rock
-            glm::vec4 midColor  = glm::vec4(0.7f, 0.7f, 0.7f, 1.0f);  // Icy gray (transition)
-            glm::vec4 snowColor = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);  // Pure white snow
-
-            // Calculate blend factor for smooth gradient
-            float t = glm::clamp((y - rockHeight) / (snowHeight - rockHeight), 0.0f, 1.0f);
-
-            // Blend from rock → ice → snow
-            glm::vec4 finalColor;
-            if (t < 0.5f) {
-                finalColor = glm::mix(rockColor, midColor, t * 2.0f); // Rock to ice
-            } else {
-                finalColor = glm::mix(midColor, snowColor, (t - 0.5f) * 2.0f); // Ice to snow
-            }
+    NodeLayout nodeLayout = NodeLayout::Compact; // 8 byte nodes, colors uploaded as their own stream
+    int brickSize = 8;                           // bottom 3 levels as 8^3 bricks, 0 for none
+    float lodPixels = 1.0f;                      // stop at nodes smaller than this many pixels, 0 for full detail
+    AttributeEncoding attributeEncoding = AttributeEncoding::Palette8; // 1 byte per color, compact layout only
+    bool useChunkedWorld = false;                // endless terrain in chunks around the camera, flattened layout only
+    // The chunked world, its streaming threads and chunk_cache exist only when it is used.
+    std::unique_ptr<ChunkedWorld> chunkedWorld;
+    std::unique_ptr<ChunkStreamer> chunkStreamer;
+    if (useChunkedWorld) {
+        chunkedWorld = std::make_unique<ChunkedWorld>(128, 5, 4); // 128 unit chunks of 32^3 voxels, 4 chunks each way
+        chunkStreamer = std::make_unique<ChunkStreamer>(*chunkedWorld, std::max(1, defaultThreadCount() - 1), "chunk_cache");
+        chunkStreamer->integrateBudget = 2;      // new chunks a frame, each one uploads its own nodes
+        nodeLayout = NodeLayout::Flattened;
+    }
+    if (nodeLayout == NodeLayout::Flattened) {
+        brickSize = 0;
+        attributeEncoding = AttributeEncoding::Float;
+    }
 
-            glm::vec3 pos(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
-            octree.Insert(pos, finalColor);
+    // The generated world is cached in worldFile and mapped on later launches. It is
+    // regenerated when the settings or TERRAIN_GENERATOR_VERSION no longer match, or when
+    // the file is deleted.
+    const std::string worldFile = "world.octree";
+    SparseVoxelOctree octree(octreeSize, maxDepth);
+    MappedOctreeFile world;
+    if (!useChunkedWorld && !openWorldFile(world, worldFile, octreeSize, maxDepth, nodeLayout, brickSize, attributeEncoding)) {
+        octree.SetBuildShell(true); // buried voxels are never seen, keep them as coarse solid leaves
+        octree.BuildFromHeightfield(generateTerrainHeightfield(octreeSize, maxDepth));
+        octree.FilterColors(); // averaged interior colors for the level of detail cutoff
+        bool saved = (nodeLayout == NodeLayout::Compact)
+            ? saveOctreeFile(worldFile, octree.ToCompact(brickSize, attributeEncoding), octreeSize, maxDepth,
+                             TERRAIN_GENERATOR_VERSION)
+            : saveOctreeFile(worldFile, octree, TERRAIN_GENERATOR_VERSION);
+        if (!saved || !world.Open(worldFile)) {
+            std::cout << "Failed to cache the world in " << worldFile << std::endl;
+            return -1;
         }
     }
-}
    
     glm::vec3 minBound = glm::vec3(0, 0, 0);
     glm::vec3 maxBound = glm::vec3(octreeSize, octreeSize, octreeSize);
@@ -203,11 +134,34 @@ int main() {
     glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, SCR_WIDTH, SCR_HEIGHT);
     glBindImageTexture(0, texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
 
-    GLuint ssbo;
-    glGenBuffers(1, &ssbo);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, m_nodes.size() * sizeof(FlattenedNode), m_nodes.data(), GL_STATIC_DRAW);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, ssbo);
+    GLuint ssbo = 0, attributeSSBO = 0, brickSSBO = 0, brickColorSSBO = 0, paletteSSBO = 0, chunkGridSSBO = 0;
+    GLuint nodeBinding = (nodeLayout == NodeLayout::Compact) ? 2 : 1;
+    size_t nodeCapacity = 0; // nodes the flattened or chunk pool buffer has room for
+    // Buffers are filled straight from the mapped file. The chunked world fills its own
+    // once the first chunks exist.
+    if (useChunkedWorld) {
+        glGenBuffers(1, &ssbo);
+        glGenBuffers(1, &chunkGridSSBO);
+    } else if (nodeLayout == NodeLayout::Compact) {
+        brickSize = world.Header().brickSize;
+        GLuint* buffers[] = {&ssbo, &attributeSSBO, &paletteSSBO, &brickSSBO, &brickColorSSBO};
+        GLuint bindings[] = {2, 3, 6, 4, 5};
+        for (int i = 0; i < static_cast<int>(OctreeSection::Count); i++) {
+            OctreeSection section = static_cast<OctreeSection>(i);
+            computeShader.createSSBO(*buffers[i], bindings[i], world.SectionBytes(section), world.Section(section), GL_STATIC_DRAW);
+        }
+    } else {
+        // The octree keeps its own copy of the nodes so edits can be uploaded by uploadNodes.
+        nodeCapacity = world.NodeCount() + world.NodeCount() / 4;
+        glGenBuffers(1, &ssbo);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, nodeCapacity * sizeof(FlattenedNode), nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, world.SectionBytes(OctreeSection::Nodes), world.FlattenedNodes());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, ssbo);
+        octree.LoadNodes(world.FlattenedNodes(), world.NodeCount());
+        octree.TakeDirtyRanges(); // already on the GPU
+    }
+    world.Close();
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
@@ -227,8 +181,31 @@ int main() {
         computeShader.setVec2("iResolution", SCR_WIDTH, SCR_HEIGHT);
         computeShader.setVec3("minBound", minBound);
         computeShader.setVec3("maxBound", maxBound);
+        computeShader.setBool("useCompactNodes", nodeLayout == NodeLayout::Compact);
 
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, ssbo);
+        if (useChunkedWorld) {
+            if (chunkStreamer->Update(cameraPos, cameraFront, deltaTime)) {
+                uploadChunkGrid(*chunkedWorld, ssbo, chunkGridSSBO, nodeCapacity);
+            }
+            const ChunkGrid& chunkGrid = chunkedWorld->Grid();
+            computeShader.setVec3("minBound", chunkGrid.minBound());
+            computeShader.setIVec3("chunkGridDims", chunkGrid.dims);
+            computeShader.setFloat("chunkSize", static_cast<float>(chunkGrid.chunkSize));
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, chunkGridSSBO);
+        } else if (nodeLayout == NodeLayout::Flattened) {
+            uploadNodes(octree, ssbo, nodeCapacity); // only what Set/Remove changed since last frame
+        }
+        computeShader.setBool("useChunkGrid", useChunkedWorld);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, nodeBinding, ssbo);
+        computeShader.setInt("brickSize", brickSize);
+        computeShader.setInt("attributeEncoding", static_cast<int>(attributeEncoding));
+        computeShader.setFloat("lodScale", lodPixels * 2.0f * std::tan(glm::radians(fov / 2.0f)) / SCR_HEIGHT);
+        if (attributeSSBO != 0) {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, attributeSSBO);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, brickSSBO);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, brickColorSSBO);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, paletteSSBO);
+        }
         computeShader.dispatch((SCR_WIDTH + 15) / 16, (SCR_HEIGHT + 15) / 16, 1);
         glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
@@ -237,6 +214,11 @@ int main() {
 
         float fps = 1.0f / deltaTime;
         std::string title = "Terrain Generation | FPS: " + std::to_string(fps);
+        if (useChunkedWorld) {
+            StreamingMetrics metrics = chunkStreamer->Metrics();
+            title += " | chunks queued " + std::to_string(metrics.queued + metrics.running) + ", latency " +
+                     std::to_string(static_cast<int>(metrics.lastLatencyMs)) + " ms";
+        }
         glfwSetWindowTitle(window, title.c_str());
 
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
@@ -316,3 +298,71 @@ void scrool_callback(GLFWwindow* window, double xoffset, double yoffset) {
     if (fov >= 45.0f)
         fov = 45.0f;
 }
+
+// Brings the flattened node buffer up to date. Only the dirty ranges are written unless the
+// pool outgrew the buffer, which is then reallocated with room to spare and filled whole.
+void uploadNodes(SparseVoxelOctree& octree, GLuint ssbo, size_t& capacity) {
+    const NodePool<FlattenedNode>& nodes = octree.Nodes();
+    std::vector<NodeRange> dirty = octree.TakeDirtyRanges();
+    if (dirty.empty()) {
+        return;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    if (nodes.Size() > capacity) {
+        capacity = nodes.Size() + nodes.Size() / 4;
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(FlattenedNode), nullptr, GL_DYNAMIC_DRAW);
+        dirty.assign(1, {0, nodes.Size()});
+    }
+    // Ranges are split where pool chunks end, since each chunk is its own allocation.
+    for (const NodeRange& range : dirty) {
+        for (size_t begin = range.begin; begin < range.end;) {
+            size_t chunk = begin / nodes.CHUNK_NODES;
+            size_t end = std::min(range.end, (chunk + 1) * nodes.CHUNK_NODES);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, begin * sizeof(FlattenedNode), (end - begin) * sizeof(FlattenedNode),
+                            nodes.Chunk(chunk) + (begin - chunk * nodes.CHUNK_NODES));
+            begin = end;
+        }
+    }
+}
+
+// Uploads the pool ranges of chunks that arrived since the last call and the root grid.
+// Evicted chunks need no upload. The node buffer is only reallocated and filled whole when
+// the pool outgrew it, like uploadNodes.
+void uploadChunkGrid(ChunkedWorld& world, GLuint nodeSSBO, GLuint gridSSBO, size_t& capacity) {
+    const ChunkGrid& grid = world.Grid();
+    std::vector<NodeRange> dirty = world.TakeDirtyRanges();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, nodeSSBO);
+    if (grid.nodes.size() > capacity) {
+        capacity = grid.nodes.size() + grid.nodes.size() / 4;
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(FlattenedNode), nullptr, GL_DYNAMIC_DRAW);
+        dirty.assign(1, {0, grid.nodes.size()});
+    }
+    for (const NodeRange& range : dirty) {
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, range.begin * sizeof(FlattenedNode),
+                        (range.end - range.begin) * sizeof(FlattenedNode), grid.nodes.data() + range.begin);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, gridSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, grid.roots.size() * sizeof(int), grid.roots.data(), GL_DYNAMIC_DRAW);
+}
+
+// Maps the cached world at path if there is one that was saved with the same settings by
+// the current terrain generator.
+bool openWorldFile(MappedOctreeFile& file, const std::string& path, int size, int maxDepth, NodeLayout layout,
+                   int brickSize, AttributeEncoding encoding) {
+    if (!file.Open(path)) {
+        return false;
+    }
+    const OctreeFileHeader& header = file.Header();
+    if (header.generator != TERRAIN_GENERATOR_VERSION) {
+        std::cout << path << " was generated by terrain generator " << header.generator << ", regenerating it with "
+                  << TERRAIN_GENERATOR_VERSION << std::endl;
+        file.Close();
+        return false;
+    }
+    if (header.size != size || header.maxDepth != maxDepth || file.Layout() != layout || file.Encoding() != encoding ||
+        header.brickSize != brickSize) {
+        file.Close();
+        return false;
+    }
+    return true;
+}